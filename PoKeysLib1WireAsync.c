@@ -20,12 +20,12 @@ typedef struct {
     uint8_t used;
 } OneWireAsyncContext;
 
-static OneWireAsyncContext ow_ctx[256];
+PK_PARSER_CTX_CHECK(OneWireAsyncContext);
 
 static int PK_1Wire_StatusParse(sPoKeysDevice *dev, const uint8_t *resp)
 {
-    uint8_t id = resp[6];
-    OneWireAsyncContext *c = &ow_ctx[id];
+    OneWireAsyncContext *c = PK_TransactionContext(dev, resp[6]);
+    if (!c) return PK_ERR_GENERIC;
     if (c->status_ptr)
         *(c->status_ptr) = resp[3];
     c->used = 0;
@@ -34,8 +34,8 @@ static int PK_1Wire_StatusParse(sPoKeysDevice *dev, const uint8_t *resp)
 
 static int PK_1Wire_ReadStatusParse(sPoKeysDevice *dev, const uint8_t *resp)
 {
-    uint8_t id = resp[6];
-    OneWireAsyncContext *c = &ow_ctx[id];
+    OneWireAsyncContext *c = PK_TransactionContext(dev, resp[6]);
+    if (!c) return PK_ERR_GENERIC;
     if (c->status_ptr)
         *(c->status_ptr) = resp[8];
     if (c->count_ptr)
@@ -55,8 +55,8 @@ static int PK_1Wire_ReadStatusParse(sPoKeysDevice *dev, const uint8_t *resp)
 
 static int PK_1Wire_BusScanParse(sPoKeysDevice *dev, const uint8_t *resp)
 {
-    uint8_t id = resp[6];
-    OneWireAsyncContext *c = &ow_ctx[id];
+    OneWireAsyncContext *c = PK_TransactionContext(dev, resp[6]);
+    if (!c) return PK_ERR_GENERIC;
     if (c->status_ptr)
         *(c->status_ptr) = resp[8];
     if (c->count_ptr)
@@ -84,8 +84,10 @@ int PK_1WireStatusGetAsync(sPoKeysDevice* device, uint8_t* activated)
     int req = CreateRequestAsync(device, PK_CMD_ONEWIRE_COMMUNICATION,
                                  params, 1, NULL, 0, PK_1Wire_StatusParse);
     if (req < 0) return req;
-    ow_ctx[req].status_ptr = activated;
-    ow_ctx[req].used = 1;
+    OneWireAsyncContext *c = PK_TransactionContext(device, (uint8_t)req);
+    if (!c) return PK_ERR_GENERIC;
+    c->status_ptr = activated;
+    c->used = 1;
     return SendRequestAsync(device, req);
 }
 
@@ -124,11 +126,13 @@ int PK_1WireReadStatusGetAsync(sPoKeysDevice* device, uint8_t *readStatus,
     int req = CreateRequestAsync(device, PK_CMD_ONEWIRE_COMMUNICATION,
                                  params, 1, NULL, 0, PK_1Wire_ReadStatusParse);
     if (req < 0) return req;
-    ow_ctx[req].status_ptr = readStatus;
-    ow_ctx[req].count_ptr = ReadCount;
-    ow_ctx[req].buffer_ptr = data;
-    ow_ctx[req].max_len = 16;
-    ow_ctx[req].used = 1;
+    OneWireAsyncContext *c = PK_TransactionContext(device, (uint8_t)req);
+    if (!c) return PK_ERR_GENERIC;
+    c->status_ptr = readStatus;
+    c->count_ptr = ReadCount;
+    c->buffer_ptr = data;
+    c->max_len = 16;
+    c->used = 1;
     return SendRequestAsync(device, req);
 }
 
@@ -150,11 +154,13 @@ int PK_1WireBusScanGetResultsAsync(sPoKeysDevice* device, uint8_t *operationStat
     int req = CreateRequestAsync(device, PK_CMD_ONEWIRE_COMMUNICATION,
                                  params, 1, NULL, 0, PK_1Wire_BusScanParse);
     if (req < 0) return req;
-    ow_ctx[req].status_ptr = operationStatus;
-    ow_ctx[req].count_ptr = scanResult;
-    ow_ctx[req].buffer_ptr = deviceROM;
-    ow_ctx[req].max_len = 8;
-    ow_ctx[req].used = 1;
+    OneWireAsyncContext *c = PK_TransactionContext(device, (uint8_t)req);
+    if (!c) return PK_ERR_GENERIC;
+    c->status_ptr = operationStatus;
+    c->count_ptr = scanResult;
+    c->buffer_ptr = deviceROM;
+    c->max_len = 8;
+    c->used = 1;
     return SendRequestAsync(device, req);
 }
 
@@ -227,8 +227,7 @@ int PK_EmergencyStopAllAsync(sPoKeysDevice* device) {
     
     // 1. Stop PulseEngine v2 if available
     if (device->info.iPulseEnginev2) {
-        device->PEv2.PulseEngineState = 0;  // Stop engine
-        ret = PK_PEv2_StatusGetAsync(device);  // This will apply the state change
+        ret = PK_PEv2_EmergencyStopPriorityAsync(device);  // Reserved slot, never starved
         if (ret != PK_OK) return ret;
     }
     
@@ -0,0 +1,208 @@
+#include "PoKeysLibHal.h"
+#include "PoKeysLibAsync.h"
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <netinet/in.h>
+
+/*
+ * Device memory arena.
+ *
+ * hal_malloc hands out HAL shared memory that nobody touches until the
+ * first servo cycle writes it, so the first access of every page happens
+ * in the RT thread.  The arena is allocated once per device, right after
+ * the device info is known, and is locked and written before hal_ready().
+ * It holds the per-device arrays only; everything else is prefaulted in
+ * place.  Sealing does not stop allocation, it makes late allocations
+ * visible in arena.late-allocs.
+ */
+
+#define PK_ARENA_ALIGN(n) (((n) + PK_CACHELINE - 1) & ~(size_t)(PK_CACHELINE - 1))
+
+static sPoKeysArena arenas[PK_ARENA_MAX];
+static int arena_count = 0;
+
+sPoKeysArena *PK_ArenaGet(const sPoKeysDevice *dev)
+{
+    for (int a = 0; a < arena_count; a++) {
+        if (arenas[a].dev == dev)
+            return &arenas[a];
+    }
+    return NULL;
+}
+
+int PK_ArenaPrefault(void *p, size_t size)
+{
+    if (!p || size == 0) return PK_OK;
+
+    long page = sysconf(_SC_PAGESIZE);
+    if (page <= 0) page = 4096;
+
+    int r = mlock(p, size);
+    // Write every page back to itself: allocates it without changing contents
+    volatile uint8_t *b = (volatile uint8_t *)p;
+    for (size_t i = 0; i < size; i += (size_t)page)
+        b[i] = b[i];
+    b[size - 1] = b[size - 1];
+    return (r == 0) ? PK_OK : PK_ERR_GENERIC;
+}
+
+// Bytes PK_ArenaAlloc() takes for a request of n bytes
+static inline size_t pk_arena_chunk(size_t n)
+{
+    return PK_ARENA_ALIGN(n ? n : 1);
+}
+
+// Keep in step with the allocations in InitializeNewDevice()
+size_t PK_ArenaSizeFor(const sPoKeysDevice_Info *info)
+{
+    size_t size = 0;
+
+    size += pk_arena_chunk(sizeof(sPoKeysPinData) * info->iPinCount);
+    size += pk_arena_chunk(sizeof(sPoKeysAnalogData) * 7);
+    size += pk_arena_chunk(sizeof(sPoKeysEncoder) * info->iEncodersCount);
+    if (info->iEasySensors)
+        size += pk_arena_chunk(sizeof(sPoKeysEasySensor) * info->iEasySensors);
+    if (info->iPWMCount > 0) {
+        size += pk_arena_chunk(sizeof(hal_float_t) * info->iPWMCount);
+        size += pk_arena_chunk(sizeof(hal_adcout_t) * info->iPWMCount);
+        size += pk_arena_chunk(sizeof(unsigned char) * info->iPWMCount);
+    }
+    size += pk_arena_chunk(sizeof(unsigned char) * info->iPWMCount);
+    size += pk_arena_chunk(sizeof(unsigned char) * info->iPoExtBus);
+    size += pk_arena_chunk(sizeof(sPoKeysMatrixLED) * info->iMatrixLED);
+    size += pk_arena_chunk(512);                 // multiPartBuffer
+
+    return size + PK_ARENA_SLACK;
+}
+
+// Memory the device got before its info (and so its arena) existed
+static void PK_ArenaPrefaultDevice(sPoKeysDevice *dev)
+{
+    PK_ArenaPrefault(dev, sizeof(*dev));
+    if (dev->connectionType == PK_DeviceType_NetworkDevice) {
+        PK_ArenaPrefault(dev->devHandle2, sizeof(struct sockaddr_in));
+        PK_ArenaPrefault(dev->devHandle, sizeof(int));
+    }
+    PK_ArenaPrefault(dev->netDeviceData, sizeof(sPoKeysNetworkDeviceInfo));
+    PK_AsyncPrefault();
+}
+
+int PK_ArenaCreate(sPoKeysDevice *dev)
+{
+    if (!dev) return PK_ERR_NOT_CONNECTED;
+
+    size_t size = PK_ArenaSizeFor(&dev->info);
+    sPoKeysArena *arena = PK_ArenaGet(dev);
+
+    if (arena) {
+        // Reconnect after hal_ready: leave it sealed so the allocations show up
+        if (arena->sealed) return PK_ERR_GENERIC;
+        if (size <= arena->size) {
+            memset(arena->base, 0, arena->used);
+            arena->used = 0;
+            PK_ArenaPrefaultDevice(dev);
+            return PK_OK;
+        }
+    } else {
+        if (arena_count >= PK_ARENA_MAX) {
+            rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: arena table full (PK_ARENA_MAX=%d)\n",
+                            __FILE__, __FUNCTION__, PK_ARENA_MAX);
+            return PK_ERR_GENERIC;
+        }
+        arena = &arenas[arena_count++];
+        memset(arena, 0, sizeof(*arena));
+        arena->dev = dev;
+    }
+
+    uint8_t *raw = hal_malloc(size + PK_CACHELINE);
+    if (!raw) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: hal_malloc(%lu) failed\n",
+                        __FILE__, __FUNCTION__, (unsigned long)(size + PK_CACHELINE));
+        arena->base = NULL;
+        arena->size = 0;
+        arena->used = 0;
+        return PK_ERR_GENERIC;
+    }
+
+    arena->base = (uint8_t *)PK_ARENA_ALIGN((uintptr_t)raw);
+    arena->size = size;
+    arena->used = 0;
+    memset(arena->base, 0, size);
+    arena->locked = (PK_ArenaPrefault(arena->base, size) == PK_OK);
+    if (!arena->locked)
+        rtapi_print_msg(RTAPI_MSG_INFO, "PoKeys: %s:%s: mlock of %lu bytes failed, arena prefaulted only\n",
+                        __FILE__, __FUNCTION__, (unsigned long)size);
+
+    PK_ArenaPrefaultDevice(dev);
+    return PK_OK;
+}
+
+void *PK_ArenaAlloc(sPoKeysDevice *dev, size_t size)
+{
+    sPoKeysArena *arena = PK_ArenaGet(dev);
+    size_t need = pk_arena_chunk(size);
+
+    if (arena && arena->sealed) {
+        // Still served below: a reconnect needs its arrays, the pin shows it
+        arena->lateAllocs++;
+        if (arena->pin_late_allocs) *arena->pin_late_allocs = arena->lateAllocs;
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: allocation of %lu bytes after hal_ready\n",
+                        __FILE__, __FUNCTION__, (unsigned long)size);
+    } else if (arena && arena->base && arena->used + need <= arena->size) {
+        void *p = arena->base + arena->used;
+        arena->used += need;
+        arena->allocs++;
+        if (arena->pin_used) *arena->pin_used = (hal_u32_t)arena->used;
+        return p;
+    }
+
+    if (arena) arena->fallbacks++;
+    void *p = hal_malloc(size);
+    if (p) {
+        memset(p, 0, size);
+        PK_ArenaPrefault(p, size);
+    }
+    return p;
+}
+
+void PK_ArenaSealAll(void)
+{
+    for (int a = 0; a < arena_count; a++) {
+        sPoKeysArena *arena = &arenas[a];
+        arena->sealed = 1;
+        rtapi_print_msg(RTAPI_MSG_INFO, "PoKeys: %s: arena %lu/%lu bytes, %u allocations, %u fallbacks%s\n",
+                        __FUNCTION__, (unsigned long)arena->used, (unsigned long)arena->size,
+                        (unsigned)arena->allocs, (unsigned)arena->fallbacks,
+                        arena->locked ? ", locked" : "");
+    }
+}
+
+int export_arena_pins(const char *prefix, long comp_id, sPoKeysDevice *dev)
+{
+    int r;
+    sPoKeysArena *arena = PK_ArenaGet(dev);
+
+    if (arena == NULL) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: no arena for device\n", __FILE__, __FUNCTION__);
+        return -1;
+    }
+
+    r = hal_pin_u32_newf(HAL_OUT, &(arena->pin_size), comp_id, "%s.arena.size", prefix);
+    if (r != 0) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: %s.arena.size failed\n", __FILE__, __FUNCTION__, prefix);
+        return r;
+    }
+
+    r = hal_pin_u32_newf(HAL_OUT, &(arena->pin_used), comp_id, "%s.arena.used", prefix);
+    if (r != 0) return r;
+
+    r = hal_pin_u32_newf(HAL_OUT, &(arena->pin_late_allocs), comp_id, "%s.arena.late-allocs", prefix);
+    if (r != 0) return r;
+
+    *(arena->pin_size) = (hal_u32_t)arena->size;
+    *(arena->pin_used) = (hal_u32_t)arena->used;
+    *(arena->pin_late_allocs) = arena->lateAllocs;
+
+    return 0;
+}
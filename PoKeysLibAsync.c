@@ -1,4 +1,5 @@
 #include "PoKeysLibAsync.h"
+#include "PoKeysLibXDP.h"
 #include <string.h>
 #ifndef RTAPI
 #include <time.h>
@@ -9,52 +10,271 @@
 #include <netinet/in.h>
 #include <unistd.h>
 #include <errno.h>
+#include <poll.h>
 
 extern uint64_t get_current_time_us(void); // Your system's high-res timer
-extern uint8_t next_request_id(void); // Request ID generator
-static async_transaction_t pk_transactions[MAX_TRANSACTIONS];
+
+// One engine per device; a context is owned by the device in ctx->dev
+static sPoKeysAsyncContext pk_async_contexts[PK_ASYNC_CONTEXT_MAX];
+
+sPoKeysAsyncContext *PK_AsyncContextGet(sPoKeysDevice *dev)
+{
+    if (!dev) return NULL;
+
+    sPoKeysAsyncContext *ctx = (sPoKeysAsyncContext *)dev->asyncContext;
+    if (ctx && __atomic_load_n(&ctx->dev, __ATOMIC_ACQUIRE) == dev)
+        return ctx;
+
+    // Another thread may already have bound one for this device
+    for (int i = 0; i < PK_ASYNC_CONTEXT_MAX; i++) {
+        ctx = &pk_async_contexts[i];
+        if (__atomic_load_n(&ctx->dev, __ATOMIC_ACQUIRE) == dev) {
+            dev->asyncContext = ctx;
+            return ctx;
+        }
+    }
+
+    // First request of this device: bind a free context.  A failed CAS
+    // leaves the current owner in 'owner'; if a concurrent first request
+    // from another thread just bound this slot to the same device, use it.
+    for (int i = 0; i < PK_ASYNC_CONTEXT_MAX; i++) {
+        sPoKeysDevice *owner = NULL;
+        ctx = &pk_async_contexts[i];
+        if (__atomic_compare_exchange_n(&ctx->dev, &owner, dev, false,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) ||
+            owner == dev) {
+            dev->asyncContext = ctx;
+            return ctx;
+        }
+    }
+
+    rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: async context table full (PK_ASYNC_CONTEXT_MAX=%d)\n",
+                    __FILE__, __FUNCTION__, PK_ASYNC_CONTEXT_MAX);
+    return NULL;
+}
+
+void PK_AsyncContextRelease(sPoKeysDevice *dev)
+{
+    if (!dev) return;
+    sPoKeysAsyncContext *ctx = (sPoKeysAsyncContext *)dev->asyncContext;
+    dev->asyncContext = NULL;
+    if (!ctx || ctx->dev != dev) return;
+
+    // Clear everything but the owner, then hand the context back
+    memset(ctx->transactions, 0, sizeof(ctx->transactions));
+    memset(ctx->idBusy, 0, sizeof(ctx->idBusy));
+    ctx->currentRequestID = 0;
+    ctx->systemLoad = 0;
+    ctx->consecutiveErrors = 0;
+    ctx->lastError_us = 0;
+    ctx->lastDispatch_us = 0;
+    __atomic_store_n(&ctx->dev, NULL, __ATOMIC_RELEASE);
+}
+
+// Request bytes to put on the wire for a transaction (64 or 512 bytes)
+static inline const uint8_t *pk_transaction_tx(sPoKeysAsyncContext *ctx, const async_transaction_t *t, size_t *len)
+{
+    if (t->multipart) {
+        *len = PK_MULTIPART_REQUEST_SIZE;
+        return ctx->multipart[t - ctx->transactions];
+    }
+    *len = sizeof(t->request_buffer);
+    return t->request_buffer;
+}
+
+void PK_AsyncPrefault(void)
+{
+    PK_ArenaPrefault(pk_async_contexts, sizeof(pk_async_contexts));
+}
+
+/*
+ * Transport hooks - every async send/receive goes through these so an
+ * attached AF_XDP transport (PoKeysLibXDP.c) can replace the kernel socket.
+ */
+static inline int pk_async_has_transport(const sPoKeysDevice *dev)
+{
+    return dev->devHandle != NULL || dev->xdpTransport != NULL;
+}
+
+static inline ssize_t pk_async_transport_send(sPoKeysDevice *dev, const uint8_t *buf, size_t len)
+{
+    if (dev->xdpTransport)
+        return PK_XDP_Send(dev, buf, len);
+    return sendto(*(int*)dev->devHandle, buf, len, 0,
+                  (struct sockaddr *)dev->devHandle2, sizeof(struct sockaddr_in));
+}
+
+static inline ssize_t pk_async_transport_recv(sPoKeysDevice *dev, uint8_t *buf, size_t len)
+{
+    if (dev->xdpTransport)
+        return PK_XDP_Recv(dev, buf, len);
+    return recvfrom(*(int*)dev->devHandle, buf, len, MSG_DONTWAIT, NULL, NULL);
+}
+
+/*
+ * Request IDs are 8 bit and RT traffic wraps them within tens of ms, while
+ * a blocking slot may wait much longer.  A slot therefore owns its ID
+ * (bit in ctx->idBusy) from its claim until it is claimed again, and no
+ * new request gets an ID that is still owned, so transaction_find() never
+ * matches a response to the wrong slot.  At most MAX_TRANSACTIONS of the
+ * 255 IDs are owned at any time.
+ */
+static inline bool pk_request_id_busy(const sPoKeysAsyncContext *ctx, uint8_t id)
+{
+    return (__atomic_load_n(&ctx->idBusy[id >> 5], __ATOMIC_RELAXED) >> (id & 31)) & 1u;
+}
+
+// Next unowned request ID, now owned by the caller's slot
+static uint8_t pk_request_id_reserve(sPoKeysAsyncContext *ctx)
+{
+    for (;;) {
+        uint8_t id = __atomic_add_fetch(&ctx->currentRequestID, 1, __ATOMIC_RELAXED);
+        if (id == 0) continue; // Skip 0 (marks an unused slot)
+        uint32_t bit = 1u << (id & 31);
+        if (!(__atomic_fetch_or(&ctx->idBusy[id >> 5], bit, __ATOMIC_ACQ_REL) & bit))
+            return id;
+    }
+}
+
+static inline void pk_request_id_release(sPoKeysAsyncContext *ctx, uint8_t id)
+{
+    if (id != 0)
+        __atomic_fetch_and(&ctx->idBusy[id >> 5], ~(1u << (id & 31)), __ATOMIC_RELEASE);
+}
+
+// Slots not sent this long after the retry check first saw them are failed
+#define PK_UNSENT_TIMEOUT_US    1000000
+
+// Slot settings applied under the claim, before the slot is published
+typedef struct {
+    bool     held;          // Blocking caller (PK_SubmitRequestAndWait)
+    bool     keep_request;  // Caller overwrites all of request_buffer: skip zeroing it
+    uint8_t  retries;       // Resends after the first attempt
+    uint32_t timeout_us;    // Per-attempt timeout, 0 = the retry check's
+} pk_claim_init_t;
+
+// The reset skips request_buffer by starting past it
+_Static_assert(offsetof(async_transaction_t, request_buffer) == 0,
+               "request_buffer must be the first field of async_transaction_t");
 
 /**
  * @brief Allocates a new free transaction.
  *
+ * Safe to call concurrently (RT thread plus a blocking caller from another
+ * thread): each slot is claimed with an atomic flag that stays set until the
+ * slot is PENDING with its request ID assigned, so no other caller can see
+ * it as free.  The reset therefore never touches the flag itself.
+ * PK_TimeoutAndRetryCheck() ignores a slot while the flag is set and until
+ * its first send, so the owner can fill it without racing the retry check.
+ *
+ * @param init Held flag, retries and timeout to set before publishing
+ *             (NULL: not held, one retry, the retry check's timeout), and
+ *             whether request_buffer may be left as it was.
  * @return Pointer to an empty async_transaction_t, or NULL if none available.
  */
-async_transaction_t* transaction_alloc(void)
+static async_transaction_t *transaction_claim(sPoKeysAsyncContext *ctx, int i, bool force,
+                                              const pk_claim_init_t *init)
 {
-    for (int i = 0; i < MAX_TRANSACTIONS; i++) {
-        if (pk_transactions[i].status == TRANSACTION_COMPLETED ||
-            pk_transactions[i].status == TRANSACTION_TIMEOUT ||
-            pk_transactions[i].status == TRANSACTION_FAILED ||
-            pk_transactions[i].request_id == 0) {
-            // Reset transaction
-            memset(&pk_transactions[i], 0, sizeof(async_transaction_t));
-            pk_transactions[i].status = TRANSACTION_PENDING;
-            return &pk_transactions[i];
-        }
+    async_transaction_t *t = &ctx->transactions[i];
+
+    if (__atomic_exchange_n(&t->claim, 1, __ATOMIC_ACQUIRE))
+        return NULL; // Another thread is claiming this slot right now
+
+    if (!t->held &&
+        (force ||
+         t->status == TRANSACTION_COMPLETED ||
+         t->status == TRANSACTION_TIMEOUT ||
+         t->status == TRANSACTION_FAILED ||
+         t->request_id == 0)) {
+        // Reset transaction, everything but the claim flag (and
+        // request_buffer when the caller overwrites it anyway)
+        uint8_t old_id = t->request_id;
+        const size_t claim_at = offsetof(async_transaction_t, claim);
+        const size_t from = (init && init->keep_request) ? sizeof(t->request_buffer) : 0;
+        memset((uint8_t *)t + from, 0, claim_at - from);
+        memset((uint8_t *)t + claim_at + sizeof(t->claim), 0,
+               sizeof(async_transaction_t) - claim_at - sizeof(t->claim));
+        pk_request_id_release(ctx, old_id);
+        t->request_id = pk_request_id_reserve(ctx);
+        t->retries_left = init ? init->retries : 1;
+        t->timeout_us = init ? init->timeout_us : 0;
+        t->held = init ? init->held : false;
+        __atomic_store_n(&t->status, TRANSACTION_PENDING, __ATOMIC_RELEASE);
+        __atomic_store_n(&t->claim, 0, __ATOMIC_RELEASE);
+        return t;
+    }
+    __atomic_store_n(&t->claim, 0, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static async_transaction_t* transaction_alloc_init(sPoKeysDevice *dev, const pk_claim_init_t *init)
+{
+    sPoKeysAsyncContext *ctx = PK_AsyncContextGet(dev);
+    if (!ctx) return NULL;
+
+    // The last PK_PRIORITY_TRANSACTIONS slots are reserved for the priority lane
+    for (int i = 0; i < MAX_TRANSACTIONS - PK_PRIORITY_TRANSACTIONS; i++) {
+        async_transaction_t *t = transaction_claim(ctx, i, false, init);
+        if (t) return t;
     }
     return NULL; // No available slot
 }
 
+static async_transaction_t* transaction_alloc(sPoKeysDevice *dev)
+{
+    return transaction_alloc_init(dev, NULL);
+}
+
+/**
+ * @brief Allocates one of the reserved priority slots.
+ *
+ * The last slot (PK_ESTOP_TRANSACTION) belongs to e-stop requests alone; a
+ * new e-stop takes it over even if the previous one is still unanswered.
+ * Other priority requests use the remaining reserved slots: if all of them
+ * are still pending, the one sent longest ago is taken over.  They can
+ * therefore never supersede a pending e-stop.
+ */
+static async_transaction_t* transaction_alloc_priority(sPoKeysDevice *dev, bool estop)
+{
+    sPoKeysAsyncContext *ctx = PK_AsyncContextGet(dev);
+    if (!ctx) return NULL;
+
+    if (estop)
+        return transaction_claim(ctx, PK_ESTOP_TRANSACTION, true, NULL);
+
+    int oldest = -1;
+    for (int i = MAX_TRANSACTIONS - PK_PRIORITY_TRANSACTIONS; i < PK_ESTOP_TRANSACTION; i++) {
+        async_transaction_t *t = transaction_claim(ctx, i, false, NULL);
+        if (t) return t;
+        if (oldest < 0 || ctx->transactions[i].timestamp_sent < ctx->transactions[oldest].timestamp_sent)
+            oldest = i;
+    }
+    return (oldest >= 0) ? transaction_claim(ctx, oldest, true, NULL) : NULL;
+}
+
 uint64_t get_current_time_us(void)
 {
     #ifndef RTAPI
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-     return ((uint64_t)tv.tv_sec * 1000000ULL) + tv.tv_usec;
+    // Monotonic: timeouts and deadlines must not jump with the wall clock
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000ULL) + (uint64_t)ts.tv_nsec / 1000;
     #else
     return rtapi_get_time() / 1000;  // convert ns → µs
    
    #endif
 }
 
-static uint8_t current_request_id = 0;
-
-uint8_t next_request_id(void)
+uint8_t next_request_id(sPoKeysDevice *dev)
 {
-    current_request_id = (current_request_id + 1) & 0xFF;
-    if (current_request_id == 0)
-        current_request_id = 1; // Optionally skip 0
-    return current_request_id;
+    // One ID space per device, shared by its async engine and the blocking API
+    sPoKeysAsyncContext *ctx = PK_AsyncContextGet(dev);
+    if (!ctx) return 0; // No context (table full): callers must not send
+    uint8_t id;
+    do {
+        id = __atomic_add_fetch(&ctx->currentRequestID, 1, __ATOMIC_RELAXED);
+    } while (id == 0 || pk_request_id_busy(ctx, id)); // Skip 0 and IDs a slot still owns
+    return id;
 }
 
 /**
@@ -63,23 +283,53 @@ uint8_t next_request_id(void)
  * @param request_id The Request ID to search for.
  * @return Pointer to matching async_transaction_t or NULL if not found.
  */
-async_transaction_t* transaction_find(uint8_t request_id)
+async_transaction_t* transaction_find(sPoKeysDevice *dev, uint8_t request_id)
 {
+    sPoKeysAsyncContext *ctx = PK_AsyncContextGet(dev);
+    if (!ctx) return NULL;
+
     for (int i = 0; i < MAX_TRANSACTIONS; i++) {
-        if (pk_transactions[i].request_id == request_id &&
-            pk_transactions[i].status == TRANSACTION_PENDING) {
-            return &pk_transactions[i];
+        async_transaction_t *t = &ctx->transactions[i];
+        if (t->request_id == request_id &&
+            t->status == TRANSACTION_PENDING) {
+            return t;
         }
-        else if(pk_transactions[i].request_id == request_id){
+        else if(t->request_id == request_id){
             // Transaction found but not pending (e.g., completed, failed, or timed out)
             rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: Transaction found but not pending (status: %d)\n",
-                __FILE__, __FUNCTION__, pk_transactions[i].status);
-            return &pk_transactions[i];
+                __FILE__, __FUNCTION__, t->status);
+            return t;
         }
     }
     return NULL; // Not found
 }
 
+async_transaction_t *PK_PriorityTransactionFind(sPoKeysDevice *dev, uint8_t request_id)
+{
+    sPoKeysAsyncContext *ctx = PK_AsyncContextGet(dev);
+    if (!ctx || request_id == 0) return NULL;
+
+    for (int i = MAX_TRANSACTIONS - PK_PRIORITY_TRANSACTIONS; i < MAX_TRANSACTIONS; i++) {
+        if (ctx->transactions[i].request_id == request_id)
+            return &ctx->transactions[i];
+    }
+    return NULL;
+}
+
+void *PK_TransactionContext(sPoKeysDevice *dev, uint8_t request_id)
+{
+    sPoKeysAsyncContext *ctx = PK_AsyncContextGet(dev);
+    if (!ctx || request_id == 0) return NULL;
+
+    // Parsers run before the slot is marked completed, so it is still PENDING
+    for (int i = 0; i < MAX_TRANSACTIONS; i++) {
+        async_transaction_t *t = &ctx->transactions[i];
+        if (t->request_id == request_id && t->status == TRANSACTION_PENDING)
+            return t->parser_ctx;
+    }
+    return NULL;
+}
+
 /**
  * @brief Prepares an asynchronous request (non-sending).
  *
@@ -96,11 +346,11 @@ int CreateRequestAsync(sPoKeysDevice *dev, pokeys_command_t cmd,
     void *target_ptr, size_t target_size,
     int (*parser_func)(sPoKeysDevice *, const uint8_t *))
 {
-async_transaction_t *t = transaction_alloc();
+async_transaction_t *t = transaction_alloc(dev);
 if (!t)
 return -1; // No free slot available
 
-uint8_t req_id = next_request_id();
+uint8_t req_id = t->request_id;               // Assigned by transaction_alloc()
 
 // Build basic request packet
 memset(t->request_buffer, 0, sizeof(t->request_buffer));
@@ -137,20 +387,9 @@ t->response_parser = parser_func; // <=== New! Optional parser function
 return req_id;
 }
 
-/**
- * @brief Prepares an asynchronous PoKeys request with optional payload data after header.
- *
- * @param device Pointer to PoKeys device
- * @param cmd PoKeys command ID (e.g., 0xC4, 0xC5, 0xCE, etc.)
- * @param params Optional pointer to up to 4 parameter bytes (NULL if none)
- * @param params_len Length of params (max 4 bytes)
- * @param payload Optional pointer to payload (e.g., encoder options) to copy starting at byte 8
- * @param payload_size Size of payload (must fit into remaining packet space)
- * @param parser_func Optional parser function for response (NULL for write-only operations)
- * @return Request ID on success, negative error code on failure
- */
- int CreateRequestAsyncWithPayload(
-    sPoKeysDevice *device,
+// Fills an allocated slot with header, parameters and payload
+static int pk_request_fill_with_payload(
+    async_transaction_t *t,
     pokeys_command_t cmd,
     const uint8_t *params,
     size_t params_len,
@@ -159,14 +398,7 @@ return req_id;
     pokeys_response_parser_t parser_func
 )
 {
-    if (device == NULL)
-        return -1; // Error: No device
-
-    async_transaction_t *t = transaction_alloc();
-    if (!t)
-        return -2; // No free slot available
-
-    uint8_t req_id = next_request_id();
+    uint8_t req_id = t->request_id;          // Assigned by transaction_alloc()
 
     // Initialize request buffer
     memset(t->request_buffer, 0, sizeof(t->request_buffer));
@@ -190,6 +422,7 @@ return req_id;
     // If payload is present, insert into request_buffer starting at byte 8
     if (payload && payload_size > 0) {
         if (payload_size > (sizeof(t->request_buffer) - 8)) {
+            t->status = TRANSACTION_FAILED; // Release the slot
             return -3; // Error: Payload too big
         }
         memcpy(&t->request_buffer[8], payload, payload_size);
@@ -209,6 +442,167 @@ return req_id;
     return req_id;
 }
 
+/**
+ * @brief Prepares an asynchronous PoKeys request with optional payload data after header.
+ *
+ * @param device Pointer to PoKeys device
+ * @param cmd PoKeys command ID (e.g., 0xC4, 0xC5, 0xCE, etc.)
+ * @param params Optional pointer to up to 4 parameter bytes (NULL if none)
+ * @param params_len Length of params (max 4 bytes)
+ * @param payload Optional pointer to payload (e.g., encoder options) to copy starting at byte 8
+ * @param payload_size Size of payload (must fit into remaining packet space)
+ * @param parser_func Optional parser function for response (NULL for write-only operations)
+ * @return Request ID on success, negative error code on failure
+ */
+ int CreateRequestAsyncWithPayload(
+    sPoKeysDevice *device,
+    pokeys_command_t cmd,
+    const uint8_t *params,
+    size_t params_len,
+    const void *payload,
+    size_t payload_size,
+    pokeys_response_parser_t parser_func
+)
+{
+    if (device == NULL)
+        return -1; // Error: No device
+
+    async_transaction_t *t = transaction_alloc(device);
+    if (!t)
+        return -2; // No free slot available
+
+    return pk_request_fill_with_payload(t, cmd, params, params_len, payload, payload_size, parser_func);
+}
+
+/**
+ * @brief Same as CreateRequestAsyncWithPayload(), but uses a reserved
+ * priority slot (see transaction_alloc_priority()), so it does not fail
+ * when ordinary traffic has exhausted the transaction table.
+ */
+int CreateRequestAsyncPriority(
+    sPoKeysDevice *device,
+    pokeys_command_t cmd,
+    const uint8_t *params,
+    size_t params_len,
+    const void *payload,
+    size_t payload_size,
+    pokeys_response_parser_t parser_func
+)
+{
+    if (device == NULL)
+        return -1; // Error: No device
+
+    async_transaction_t *t = transaction_alloc_priority(device, false);
+    if (!t)
+        return -2; // Every reserved slot is held by a blocking caller
+
+    return pk_request_fill_with_payload(t, cmd, params, params_len, payload, payload_size, parser_func);
+}
+
+/**
+ * @brief Same as CreateRequestAsyncPriority(), but uses the slot reserved
+ * for e-stop requests (PK_ESTOP_TRANSACTION), which no other request can
+ * take over.
+ */
+int CreateRequestAsyncEstop(
+    sPoKeysDevice *device,
+    pokeys_command_t cmd,
+    const uint8_t *params,
+    size_t params_len,
+    const void *payload,
+    size_t payload_size,
+    pokeys_response_parser_t parser_func
+)
+{
+    if (device == NULL)
+        return -1; // Error: No device
+
+    async_transaction_t *t = transaction_alloc_priority(device, true);
+    if (!t)
+        return -2; // No async context for this device
+
+    return pk_request_fill_with_payload(t, cmd, params, params_len, payload, payload_size, parser_func);
+}
+
+/**
+ * @brief Creates a multipart (8 x 64 byte) request tracked as one transaction.
+ *
+ * Same packet layout as SendEthRequestBig(): every part repeats the header,
+ * byte 2 carries the part index and first/last flags, and 56 data bytes
+ * follow.  The first seven parts get their own request IDs; the transaction
+ * owns the ID of the last part, which is the one the device answers with.
+ * Retries resend all 512 bytes.
+ *
+ * @param params     Header bytes 3..5 (e.g. subcommand, count, axes).
+ * @param data       Multipart data (up to PK_MULTIPART_DATA_SIZE bytes).
+ * @return Request ID (> 0) of the transaction, or negative error code.
+ */
+static int pk_create_multipart(sPoKeysDevice *device, const uint8_t *params, size_t params_len,
+                               const void *data, size_t data_len,
+                               pokeys_response_parser_t parser_func, const pk_claim_init_t *init,
+                               async_transaction_t **out)
+{
+    if (device == NULL) return -1;
+    if (params_len > 3 || data_len > PK_MULTIPART_DATA_SIZE) return -3;
+
+    // Reserve the IDs of the leading parts first so the transaction (last part) follows them
+    uint8_t part_id[7];
+    for (int i = 0; i < 7; i++) {
+        part_id[i] = next_request_id(device);
+        if (part_id[i] == 0) return -2; // No async context
+    }
+
+    async_transaction_t *t = transaction_alloc_init(device, init);
+    if (!t) return -2;
+    sPoKeysAsyncContext *ctx = (sPoKeysAsyncContext *)device->asyncContext;
+
+    uint8_t header[8] = {0xBB, PK_CMD_MULTIPART_PACKET, 0, 0, 0, 0, 0, 0};
+    if (params && params_len > 0)
+        memcpy(&header[3], params, params_len);
+
+    uint8_t *buf = ctx->multipart[t - ctx->transactions];
+    memset(buf, 0, PK_MULTIPART_REQUEST_SIZE);
+    if (data && data_len > 0) {
+        for (int i = 0; i < 8; i++) {
+            size_t off = (size_t)i * 56;
+            if (off >= data_len) break;
+            size_t n = (data_len - off < 56) ? data_len - off : 56;
+            memcpy(&buf[i * 64 + 8], (const uint8_t *)data + off, n);
+        }
+    }
+
+    for (int i = 0; i < 8; i++) {
+        uint8_t *part = &buf[i * 64];
+        memcpy(part, header, 8);
+        part[2] = (uint8_t)i;
+        if (i == 0) part[2] |= (1 << 3);
+        if (i == 7) part[2] |= (1 << 4);
+        part[6] = (i < 7) ? part_id[i] : t->request_id;
+
+        uint8_t checksum = 0;
+        for (int j = 0; j <= 6; j++) checksum += part[j];
+        part[7] = checksum;
+    }
+
+    // request_buffer mirrors the last part (used for logging and matching)
+    memcpy(t->request_buffer, &buf[7 * 64], sizeof(t->request_buffer));
+
+    // Status, retries and timestamp were set by the claim
+    t->command_sent = PK_CMD_MULTIPART_PACKET;
+    t->response_parser = parser_func;
+    t->multipart = true;
+
+    if (out) *out = t;
+    return t->request_id;
+}
+
+int CreateRequestAsyncMultipart(sPoKeysDevice *device, const uint8_t *params, size_t params_len,
+                                const void *data, size_t data_len,
+                                pokeys_response_parser_t parser_func)
+{
+    return pk_create_multipart(device, params, params_len, data, data_len, parser_func, NULL, NULL);
+}
+
 /**
  * @brief Sends an asynchronous request that was prepared earlier.
  *
@@ -219,27 +613,43 @@ return req_id;
 int SendRequestAsync(sPoKeysDevice *dev, uint8_t request_id)
 {
     if (!dev) return -1;
-    async_transaction_t *t = transaction_find(request_id);
+    async_transaction_t *t = transaction_find(dev, request_id);
     if (!t) {
         rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: No matching transaction found for request ID %d\n", __FILE__, __FUNCTION__, request_id);
         return -1; // No matching pending transaction found
     }
+    return PK_TransactionSendAsync(dev, t);
+}
+
+/**
+ * @brief Sends a prepared transaction slot without looking it up by ID.
+ *
+ * @return 0 on success, negative error code on failure.
+ */
+int PK_TransactionSendAsync(sPoKeysDevice *dev, async_transaction_t *t)
+{
+    if (!dev || !t) return -1;
+    uint8_t request_id = t->request_id;
 
     // Guard against NULL devHandle (e.g. USB-only device without UDP socket)
     rtapi_print_msg(RTAPI_MSG_DBG, "PoKeys: %s:%s: devHandle=%p for request ID %d\n", __FILE__, __FUNCTION__, dev->devHandle, request_id);
-    if (!dev->devHandle) {
+    if (!pk_async_has_transport(dev)) {
         rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: devHandle is NULL for request ID %d - skipping send\n", __FILE__, __FUNCTION__, request_id);
         return -1;
     }
 
     // Send the packet
  //   ssize_t sent = sendto(*(int*)dev->devHandle, t->request_buffer, sizeof(t->request_buffer), 0,(struct sockaddr *)&dev->devHandle2, sizeof(struct sockaddr_in));
- ssize_t sent = sendto(*(int*)dev->devHandle, t->request_buffer, sizeof(t->request_buffer), 0,(struct sockaddr *)dev->devHandle2, sizeof(struct sockaddr_in));
+    size_t tx_len;
+    const uint8_t *tx = pk_transaction_tx((sPoKeysAsyncContext *)dev->asyncContext, t, &tx_len);
+    ssize_t sent = pk_async_transport_send(dev, tx, tx_len);
     if (sent < 0) {
         rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: sendto failed for request ID %d, errno=%d (%s)\n", __FILE__, __FUNCTION__, request_id, errno, strerror(errno));
-        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: devHandle2=%d\n", __FILE__, __FUNCTION__,dev->devHandle2);
-        struct sockaddr_in *a = (struct sockaddr_in *)&dev->devHandle2;
-        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: → sendto: sin_family=%d, ip=%08x, port=%d\n", __FILE__, __FUNCTION__,a->sin_family, ntohl(a->sin_addr.s_addr), ntohs(a->sin_port));
+        if (!dev->xdpTransport) {
+            rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: devHandle2=%d\n", __FILE__, __FUNCTION__,dev->devHandle2);
+            struct sockaddr_in *a = (struct sockaddr_in *)&dev->devHandle2;
+            rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: → sendto: sin_family=%d, ip=%08x, port=%d\n", __FILE__, __FUNCTION__,a->sin_family, ntohl(a->sin_addr.s_addr), ntohs(a->sin_port));
+        }
 
         return -2; // Send error
     }
@@ -250,6 +660,56 @@ int SendRequestAsync(sPoKeysDevice *dev, uint8_t request_id)
     return 0; // Success
 }
 
+/**
+ * @brief Claims a transaction slot and fills it from a request template.
+ *
+ * The 64 template bytes are copied as they are; only the request ID, the
+ * checksum (the header sum is precomputed) and the template's variable
+ * payload range are written.  Callers may build further payload bytes in
+ * t->request_buffer[8..] before PK_TransactionSendAsync().
+ *
+ * @param var     Bytes for the variable range (NULL keeps the template bytes).
+ * @param var_len At most tpl->varLen bytes are copied.
+ * @return The filled slot, or NULL if the table is full.
+ */
+async_transaction_t *PK_RequestTemplateClaim(sPoKeysDevice *dev, const sPoKeysRequestTemplate *tpl,
+                                             const void *var, size_t var_len)
+{
+    if (!tpl) return NULL;
+    // All 64 request bytes come from the template, so the claim need not zero them
+    const pk_claim_init_t init = { .keep_request = true, .retries = 1 };
+    async_transaction_t *t = transaction_alloc_init(dev, &init);
+    if (!t) return NULL;
+
+    uint8_t req_id = t->request_id;
+    memcpy(t->request_buffer, tpl->packet, sizeof(t->request_buffer));
+    if (var && var_len > 0)
+        memcpy(&t->request_buffer[tpl->varOffset], var, var_len < tpl->varLen ? var_len : tpl->varLen);
+
+    uint8_t sum = tpl->headerSum;
+    if (tpl->flags & PK_TEMPLATE_PEV2_TEST_BYTE) {
+        // PEv2 status: param 2 is a test byte derived from the request ID
+        t->request_buffer[3] = (uint8_t)((0x10 + req_id) % 199);
+        sum += t->request_buffer[3];
+    }
+    t->request_buffer[6] = req_id;
+    t->request_buffer[7] = (uint8_t)(sum + req_id);
+
+    // The claim zeroed the rest (targets, timestamp, flags)
+    t->command_sent = tpl->cmd;
+    t->response_parser = tpl->parser;
+    return t;
+}
+
+int PK_RequestTemplateSendAsync(sPoKeysDevice *dev, const sPoKeysRequestTemplate *tpl,
+                                const void *var, size_t var_len)
+{
+    if (!dev) return PK_ERR_NOT_CONNECTED;
+    async_transaction_t *t = PK_RequestTemplateClaim(dev, tpl, var, var_len);
+    if (!t) return -1; // No free slot available
+    return PK_TransactionSendAsync(dev, t);
+}
+
 int CreateAndSendRequestAsync(sPoKeysDevice *dev, pokeys_command_t cmd,
     const uint8_t *params, size_t params_len,
     void *target_ptr, size_t target_size,
@@ -274,13 +734,11 @@ int CreateAndSendRequestAsyncWithPayload(sPoKeysDevice *dev, pokeys_command_t cm
     return SendRequestAsync(dev, (uint8_t)req_id);
 }
 
-/**
- * @brief Receives UDP packets and dispatches them to the correct async transaction.
- *
- * @param dev Pointer to the PoKeys device structure.
- * @return Number of responses processed, or 0 if none.
+/*
+ * pk_receive_and_dispatch - receive one packet and complete its transaction.
+ * Shared by PK_ReceiveAndDispatch() and the blocking wait loop.
  */
-int PK_ReceiveAndDispatch(sPoKeysDevice *dev)
+static int pk_receive_and_dispatch(sPoKeysDevice *dev)
 {
     if (!dev) return 0;
 
@@ -290,26 +748,22 @@ int PK_ReceiveAndDispatch(sPoKeysDevice *dev)
         "PoKeys: %s:%s: [1] entering, devHandle=%p\n",
         __FILE__, __FUNCTION__, dev->devHandle);
 
-    if (!dev->devHandle) {
+    if (!pk_async_has_transport(dev)) {
         rtapi_print_msg(RTAPI_MSG_ERR,
             "PoKeys: %s:%s: [1a] devHandle is NULL - skipping\n",
             __FILE__, __FUNCTION__);
         return 0;
     }
 
-    int fd = *(int*)dev->devHandle;
     rtapi_print_msg(RTAPI_MSG_DBG,
-        "PoKeys: %s:%s: [2] fd=%d - about to recvfrom\n",
-        __FILE__, __FUNCTION__, fd);
+        "PoKeys: %s:%s: [2] xdp=%p - about to receive\n",
+        __FILE__, __FUNCTION__, dev->xdpTransport);
 
     uint8_t rx_buffer[64];
     ssize_t len;
-    struct sockaddr_in addr;
-    socklen_t addrlen = sizeof(addr);
 
-    // Non-blocking UDP receive
-    len = recvfrom(fd, rx_buffer, sizeof(rx_buffer),
-                   MSG_DONTWAIT, (struct sockaddr *)&addr, &addrlen);
+    // Non-blocking receive (UDP socket or AF_XDP RX ring)
+    len = pk_async_transport_recv(dev, rx_buffer, sizeof(rx_buffer));
 
     rtapi_print_msg(RTAPI_MSG_DBG,
         "PoKeys: %s:%s: [3] recvfrom returned len=%d (errno=%d)\n",
@@ -331,6 +785,16 @@ int PK_ReceiveAndDispatch(sPoKeysDevice *dev)
         return -1; // Invalid start byte (should be 0xAA from Device → Host)
     }
 
+    // Same checksum test the blocking receive loops apply (sum of bytes 0..6)
+    uint8_t checksum = 0;
+    for (int i = 0; i <= 6; i++) checksum += rx_buffer[i];
+    if (len < 8 || rx_buffer[7] != checksum) {
+        rtapi_print_msg(RTAPI_MSG_ERR,
+            "PoKeys: %s:%s: [4b] bad checksum 0x%02X (expected 0x%02X) - discarding\n",
+            __FILE__, __FUNCTION__, rx_buffer[7], checksum);
+        return -1;
+    }
+
     uint8_t cmd    = rx_buffer[1]; // Command echoed back
     uint8_t req_id = rx_buffer[6]; // Request ID echoed back
 
@@ -339,7 +803,7 @@ int PK_ReceiveAndDispatch(sPoKeysDevice *dev)
         __FILE__, __FUNCTION__, cmd, (unsigned)req_id);
 
     // Find the corresponding async transaction
-    async_transaction_t *t = transaction_find(req_id);
+    async_transaction_t *t = transaction_find(dev, req_id);
 
     rtapi_print_msg(RTAPI_MSG_DBG,
         "PoKeys: %s:%s: [6] transaction_find=%p status=%d parser=%p\n",
@@ -395,8 +859,10 @@ int PK_ReceiveAndDispatch(sPoKeysDevice *dev)
             __FILE__, __FUNCTION__, parse_ret);
     }
 
-    t->status = TRANSACTION_COMPLETED;
     t->response_ready = true;
+    // Publish after response_buffer is written - a blocking waiter may be
+    // polling this slot from another thread.
+    __atomic_store_n(&t->status, TRANSACTION_COMPLETED, __ATOMIC_RELEASE);
 
     rtapi_print_msg(RTAPI_MSG_DBG,
         "PoKeys: %s:%s: [11] done, returning 1\n",
@@ -405,6 +871,23 @@ int PK_ReceiveAndDispatch(sPoKeysDevice *dev)
     return 1; // One response processed
 }
 
+/**
+ * @brief Receives UDP packets and dispatches them to the correct async transaction.
+ *
+ * @param dev Pointer to the PoKeys device structure.
+ * @return Number of responses processed, or 0 if none.
+ */
+int PK_ReceiveAndDispatch(sPoKeysDevice *dev)
+{
+    // Time of the last call by the engine owner (RT thread / user_mainloop).
+    // Blocking callers only pump the engine themselves when nobody else has
+    // done so recently.
+    sPoKeysAsyncContext *ctx = PK_AsyncContextGet(dev);
+    if (ctx)
+        __atomic_store_n(&ctx->lastDispatch_us, get_current_time_us(), __ATOMIC_RELAXED);
+    return pk_receive_and_dispatch(dev);
+}
+
 /**
  * @brief Enhanced timeout and retry check with exponential backoff and error recovery.
  *
@@ -418,64 +901,79 @@ int PK_ReceiveAndDispatch(sPoKeysDevice *dev)
  */
 void PK_TimeoutAndRetryCheck(sPoKeysDevice *dev, uint64_t timeout_us)
 {
-    if (!dev) return;
+    sPoKeysAsyncContext *ctx = PK_AsyncContextGet(dev);
+    if (!ctx) return;
 
     // Guard against NULL devHandle (e.g. USB-only device without UDP socket).
     // Mirrors the identical guard already present in PK_ReceiveAndDispatch and
     // SendRequestAsync.  Without this check, the sendto() inside the retry loop
     // would dereference a NULL pointer and produce SIGSEGV — the same crash that
     // was observed in the RT component before the devHandle guards were added.
-    if (!dev->devHandle) {
+    if (!pk_async_has_transport(dev)) {
         rtapi_print_msg(RTAPI_MSG_ERR,
             "PoKeys: %s:%s: devHandle is NULL - clearing pending transactions\n",
             __FILE__, __FUNCTION__);
         for (int i = 0; i < MAX_TRANSACTIONS; i++) {
-            if (pk_transactions[i].status == TRANSACTION_PENDING) {
-                pk_transactions[i].status = TRANSACTION_FAILED;
-                pk_transactions[i].retries_left = 0;
+            if (ctx->transactions[i].status == TRANSACTION_PENDING) {
+                ctx->transactions[i].status = TRANSACTION_FAILED;
+                ctx->transactions[i].retries_left = 0;
             }
         }
         return;
     }
 
     uint64_t now = get_current_time_us();
-    static uint32_t consecutive_errors = 0;
-    static uint64_t last_error_time = 0;
     
     // Implement circuit breaker pattern - if too many consecutive errors,
-    // temporarily back off to avoid overwhelming the device
+    // temporarily back off to avoid overwhelming the device.  The breaker is
+    // per device: one unreachable device must not stall the retries of another.
     const uint32_t MAX_CONSECUTIVE_ERRORS = 10;
     const uint64_t ERROR_BACKOFF_TIME_US = 1000000; // 1 second backoff
     
-    if (consecutive_errors >= MAX_CONSECUTIVE_ERRORS) {
-        if ((now - last_error_time) < ERROR_BACKOFF_TIME_US) {
+    if (ctx->consecutiveErrors >= MAX_CONSECUTIVE_ERRORS) {
+        if ((now - ctx->lastError_us) < ERROR_BACKOFF_TIME_US) {
             return; // Still in backoff period
         } else {
-            consecutive_errors = 0; // Reset after backoff period
+            ctx->consecutiveErrors = 0; // Reset after backoff period
         }
     }
 
     for (int i = 0; i < MAX_TRANSACTIONS; i++) {
-        async_transaction_t *t = &pk_transactions[i];
+        async_transaction_t *t = &ctx->transactions[i];
 
         if (t->status == TRANSACTION_PENDING) {
+            // Being claimed, or claimed and still filled by its owner: never
+            // resend or time out a half-built slot.  One that is never sent
+            // is failed after PK_UNSENT_TIMEOUT_US so the slot is not lost.
+            if (__atomic_load_n(&t->claim, __ATOMIC_ACQUIRE))
+                continue;
+            if (t->timestamp_sent == 0) {
+                if (t->unsent_since_us == 0)
+                    t->unsent_since_us = now;
+                else if (!t->held && (now - t->unsent_since_us) > PK_UNSENT_TIMEOUT_US)
+                    t->status = TRANSACTION_FAILED;
+                continue;
+            }
+
             // Use fixed timeout (no exponential backoff) to bound slot occupancy.
             // With retries_left=1 and a fixed timeout_us each cycle, a slot is
             // freed within 2 × timeout_us (one retry + one timeout cycle),
             // keeping steady-state slot usage well below MAX_TRANSACTIONS.
-            uint64_t effective_timeout = timeout_us;
+            // Blocking callers bring their own timeout (socketTimeout), so
+            // the servo loop's short one neither fails nor floods them.
+            uint64_t effective_timeout = t->timeout_us ? t->timeout_us : timeout_us;
             
             if ((now - t->timestamp_sent) > effective_timeout) {
                 if (t->retries_left > 0) {
                     // Attempt retry with improved error handling
-                    ssize_t sent = sendto(*(int*)dev->devHandle,
-                                          t->request_buffer, sizeof(t->request_buffer), 0,
-                                          (struct sockaddr *)dev->devHandle2, sizeof(struct sockaddr_in));
+                    size_t tx_len;
+                    const uint8_t *tx = pk_transaction_tx(ctx, t, &tx_len);
+                    ssize_t sent = pk_async_transport_send(dev, tx, tx_len);
                     if (sent >= 0) {
                         t->timestamp_sent = now;
                         t->retries_left--;
                         // Reset consecutive error counter on successful send
-                        if (consecutive_errors > 0) consecutive_errors--;
+                        if (ctx->consecutiveErrors > 0) ctx->consecutiveErrors--;
                         
                         #ifdef DEBUG_ASYNC_RETRIES
                         rtapi_print_msg(RTAPI_MSG_DBG, "PoKeys: Retry for request ID %d, cmd=0x%02X, retries_left=%d\n", 
@@ -483,8 +981,8 @@ void PK_TimeoutAndRetryCheck(sPoKeysDevice *dev, uint64_t timeout_us)
                         #endif
                     } else {
                         // Send failed - increment error counter and log
-                        consecutive_errors++;
-                        last_error_time = now;
+                        ctx->consecutiveErrors++;
+                        ctx->lastError_us = now;
                         
                         rtapi_print_msg(RTAPI_MSG_WARN, "PoKeys: Retry send failed for request ID %d, errno=%d\n", 
                                        t->request_id, errno);
@@ -512,6 +1010,168 @@ void PK_TimeoutAndRetryCheck(sPoKeysDevice *dev, uint64_t timeout_us)
 }
 
 
+/* -------------------------------------------------------------------------
+ * Blocking requests on top of the transaction engine
+ *
+ * SendEthRequest() submits through here so blocking helpers and the async
+ * engine share one request ID space and one receive path: whichever thread
+ * receives a response completes the matching transaction, and nobody steals
+ * packets meant for someone else.
+ * ------------------------------------------------------------------------- */
+
+// Owner is considered active if it dispatched within this window
+#define PK_DISPATCH_ACTIVE_US   5000
+#define PK_WAIT_POLL_US         100
+
+/**
+ * @brief Tells whether the RT engine is currently receiving on @p dev's socket.
+ *
+ * True while the engine owner dispatched within PK_DISPATCH_ACTIVE_US.
+ * Blocking transfers must then go through the engine instead of reading
+ * the socket themselves, or they would swallow the owner's responses.
+ */
+bool PK_AsyncOwnsSocket(const sPoKeysDevice *dev)
+{
+    const sPoKeysAsyncContext *ctx = dev ? (const sPoKeysAsyncContext *)dev->asyncContext : NULL;
+    if (!ctx || __atomic_load_n(&ctx->dev, __ATOMIC_ACQUIRE) != dev) return false;
+    return (get_current_time_us() - __atomic_load_n(&ctx->lastDispatch_us, __ATOMIC_RELAXED))
+           <= PK_DISPATCH_ACTIVE_US;
+}
+
+bool PK_AsyncUseEngine(sPoKeysDevice *dev)
+{
+    if (!dev || !PK_AsyncContextGet(dev)) return false;
+    return dev->connectionParam == PK_ConnectionParam_UDP || PK_AsyncOwnsSocket(dev);
+}
+
+/*
+ * pk_wait_held - send a held transaction and wait for its completion.
+ * Shared by the single-packet and multipart blocking submits.
+ */
+static int32_t pk_wait_held(sPoKeysDevice *dev, async_transaction_t *t, uint8_t *response,
+                            uint32_t timeout_us, uint8_t retries)
+{
+    sPoKeysAsyncContext *ctx = (sPoKeysAsyncContext *)dev->asyncContext;
+
+    if (PK_TransactionSendAsync(dev, t) != 0) {
+        t->status = TRANSACTION_FAILED;
+        t->held = false;
+        return PK_ERR_TRANSFER;
+    }
+
+    // Safety net on top of the engine's own retry/timeout handling
+    uint64_t deadline = t->timestamp_sent + (uint64_t)timeout_us * (retries + 2);
+
+    while (__atomic_load_n(&t->status, __ATOMIC_ACQUIRE) == TRANSACTION_PENDING) {
+        uint64_t now = get_current_time_us();
+        if (now > deadline) {
+            t->status = TRANSACTION_TIMEOUT;
+            break;
+        }
+
+        if ((now - __atomic_load_n(&ctx->lastDispatch_us, __ATOMIC_RELAXED)) <= PK_DISPATCH_ACTIVE_US) {
+            // The engine owner receives for us; just wait for the completion
+            usleep(PK_WAIT_POLL_US);
+            continue;
+        }
+
+        if (pk_receive_and_dispatch(dev) > 0)
+            continue;
+        PK_TimeoutAndRetryCheck(dev, timeout_us);
+
+        if (dev->xdpTransport) {
+            usleep(PK_WAIT_POLL_US);
+        } else {
+            // Sleep in the kernel until data arrives; wake up in time for the
+            // next retry check or the overall deadline, whichever is first
+            uint64_t wait_us = deadline - now;
+            if (wait_us > timeout_us / 4 + PK_WAIT_POLL_US)
+                wait_us = timeout_us / 4 + PK_WAIT_POLL_US;
+            struct pollfd pfd = { .fd = *(int*)dev->devHandle, .events = POLLIN };
+            poll(&pfd, 1, (int)((wait_us + 999) / 1000));
+        }
+    }
+
+    int32_t result = PK_ERR_TRANSFER;
+    if (t->status == TRANSACTION_COMPLETED) {
+        memcpy(response, t->response_buffer, sizeof(t->response_buffer));
+        result = PK_OK;
+    }
+    __atomic_store_n(&t->held, false, __ATOMIC_RELEASE);
+    return result;
+}
+
+/**
+ * @brief Sends a prepared 64-byte request and waits for its response.
+ *
+ * The request (bytes 1-5 and payload from byte 8) is copied into a
+ * transaction; header, request ID and checksum are filled in here.  If the
+ * engine owner is running, the call only waits for the completion; otherwise
+ * it pumps PK_ReceiveAndDispatch/PK_TimeoutAndRetryCheck itself and sleeps in
+ * poll() on the socket between packets, so a response is picked up as soon
+ * as it arrives.
+ *
+ * Not RT-safe (sleeps); meant for setup code and non-RT threads.
+ *
+ * @param dev        Pointer to the PoKeys device structure.
+ * @param request    64-byte request buffer.
+ * @param response   64-byte buffer receiving the response (may equal request).
+ * @param timeout_us Per-attempt timeout in microseconds.
+ * @param retries    Number of resends after the first attempt.
+ * @return PK_OK on success, PK_ERR_GENERIC if no slot is free,
+ *         PK_ERR_TRANSFER on send failure or timeout.
+ */
+int32_t PK_SubmitRequestAndWait(sPoKeysDevice *dev, const uint8_t *request, uint8_t *response,
+                                uint32_t timeout_us, uint8_t retries)
+{
+    if (!dev || !request || !response) return PK_ERR_GENERIC;
+
+    // Held, retries and timeout are in place before the slot is published
+    const pk_claim_init_t init = { .held = true, .retries = retries, .timeout_us = timeout_us };
+    async_transaction_t *t = transaction_alloc_init(dev, &init);
+    if (!t) return PK_ERR_GENERIC;
+
+    uint8_t req_id = t->request_id;
+    memcpy(t->request_buffer, request, sizeof(t->request_buffer));
+    t->request_buffer[0] = 0xBB;
+    t->request_buffer[6] = req_id;
+    uint8_t checksum = 0;
+    for (int i = 0; i <= 6; i++) checksum += t->request_buffer[i];
+    t->request_buffer[7] = checksum;
+
+    t->command_sent = (pokeys_command_t)request[1];
+    dev->requestID = req_id;
+
+    return pk_wait_held(dev, t, response, timeout_us, retries);
+}
+
+/**
+ * @brief Multipart counterpart of PK_SubmitRequestAndWait().
+ *
+ * Header bytes 3-5 of @p request and PK_MULTIPART_DATA_SIZE bytes of
+ * @p data are packed by CreateRequestAsyncMultipart(); the call then waits
+ * for the single response like PK_SubmitRequestAndWait().
+ *
+ * Not RT-safe (sleeps); used by SendEthRequestBig() on UDP.
+ *
+ * @return PK_OK on success, PK_ERR_GENERIC if no slot is free,
+ *         PK_ERR_TRANSFER on send failure or timeout.
+ */
+int32_t PK_SubmitMultipartRequestAndWait(sPoKeysDevice *dev, const uint8_t *request, const uint8_t *data,
+                                         uint8_t *response, uint32_t timeout_us, uint8_t retries)
+{
+    if (!dev || !request || !data || !response) return PK_ERR_GENERIC;
+
+    const pk_claim_init_t init = { .held = true, .retries = retries, .timeout_us = timeout_us };
+    async_transaction_t *t = NULL;
+    int req_id = pk_create_multipart(dev, &request[3], 3, data, PK_MULTIPART_DATA_SIZE, NULL, &init, &t);
+    if (req_id <= 0 || !t) return PK_ERR_GENERIC;
+
+    dev->requestID = (uint8_t)req_id;
+
+    return pk_wait_held(dev, t, response, timeout_us, retries);
+}
+
 /* -------------------------------------------------------------------------
  * Async Scheduler implementation
  * (Migrated from experimental/async_scheduler.c per architecture rules.)
@@ -521,9 +1181,6 @@ void PK_TimeoutAndRetryCheck(sPoKeysDevice *dev, uint64_t timeout_us)
 static periodic_async_task_t async_tasks[MAX_ASYNC_TASKS];
 static size_t async_task_count_internal = 0;
 
-/* Device CPU load percentage (0-100) from last PK_CMD_DEVICE_LOAD_STATUS response */
-static uint8_t scheduler_system_load = 0;
-
 /* 1 when LinuxCNC "Machine On" is active; SCHED_PRIORITY_LOW tasks are suppressed */
 static int scheduler_machine_on = 0;
 
@@ -577,9 +1234,10 @@ int async_dispatcher(void)
          * LOW tasks are skipped already at moderate load (>50 %) and always
          * suppressed while the machine is on (config-class tasks). */
         task_priority_t prio = async_tasks[i].priority;
-        if (prio == SCHED_PRIORITY_LOW    && scheduler_system_load >  50) continue;
-        if (prio == SCHED_PRIORITY_NORMAL && scheduler_system_load >  80) continue;
-        if (prio == SCHED_PRIORITY_HIGH   && scheduler_system_load >  95) continue;
+        uint8_t load = scheduler_get_system_load(async_tasks[i].dev);
+        if (prio == SCHED_PRIORITY_LOW    && load >  50) continue;
+        if (prio == SCHED_PRIORITY_NORMAL && load >  80) continue;
+        if (prio == SCHED_PRIORITY_HIGH   && load >  95) continue;
 
         /* Machine-on lock: suppress LOW-priority config tasks while machine is active */
         if (prio == SCHED_PRIORITY_LOW && scheduler_machine_on) continue;
@@ -609,12 +1267,13 @@ int async_dispatcher(void)
     return 1;
 }
 
-void async_task_set_active(const char *name, int active)
+void async_task_set_active(sPoKeysDevice *dev, const char *name, int active)
 {
+    // Every device registers the same task names
     for (size_t i = 0; i < async_task_count_internal; ++i) {
-        if (strcmp(async_tasks[i].name, name) == 0) {
+        if ((dev == NULL || async_tasks[i].dev == dev) &&
+            strcmp(async_tasks[i].name, name) == 0) {
             async_tasks[i].active = (active != 0);
-            return;
         }
     }
 }
@@ -629,12 +1288,15 @@ void scheduler_set_machine_on(int machine_on)
     scheduler_machine_on = (machine_on != 0);
 }
 
-uint8_t scheduler_get_system_load(void)
+uint8_t scheduler_get_system_load(sPoKeysDevice *dev)
 {
-    return scheduler_system_load;
+    // Device CPU load percentage (0-100) from its last PK_CMD_DEVICE_LOAD_STATUS response
+    const sPoKeysAsyncContext *ctx = dev ? (const sPoKeysAsyncContext *)dev->asyncContext : NULL;
+    return ctx ? ctx->systemLoad : 0;
 }
 
-void scheduler_update_system_load(uint8_t cpu_load)
+void scheduler_update_system_load(sPoKeysDevice *dev, uint8_t cpu_load)
 {
-    scheduler_system_load = cpu_load;
+    sPoKeysAsyncContext *ctx = PK_AsyncContextGet(dev);
+    if (ctx) ctx->systemLoad = cpu_load;
 }
@@ -1,37 +1,17 @@
 #ifndef POKEYSLIB_ASYNC_H
 #define POKEYSLIB_ASYNC_H
 #include "PoKeysLibHal.h"
+#include "PoKeysLibCmdQueue.h"
 #include <stdint.h>
 #include <stddef.h>
 #include <stdbool.h>
 
 
 #define MAX_TRANSACTIONS 64 // Maximum number of async transactions
-#define MAX_ASYNC_COMMANDS 32  // Maximum number of queued async commands; enqueue_async_command() drops new entries when full
-
-typedef enum {
-    CMD_MOVE_PV,
-    CMD_HOME_START,
-    CMD_PROBE_START,
-    CMD_EMERGENCY_STOP,
-    CMD_EXTERNAL_OUTPUT_SET
-} async_cmd_type_t;
-
-typedef struct {
-    async_cmd_type_t type;
-    uint8_t axis_mask;
-    float pos_values[8];
-    float vel_values[8];
-    uint32_t misc_data;
-    bool processed;
-} async_command_t;
-
-typedef struct {
-    async_command_t commands[MAX_ASYNC_COMMANDS];
-    volatile int head, tail;
-    volatile int count;
-} async_command_queue_t;
-
+#define PK_PRIORITY_TRANSACTIONS 2 // Slots at the end of the table reserved for the priority lane
+#define PK_ESTOP_TRANSACTION (MAX_TRANSACTIONS - 1) // Reserved slot only e-stop requests may use
+#define PK_ASYNC_CONTEXT_MAX 4 // Devices with their own transaction engine
+#define PK_PARSER_CTX_SIZE 48 // Per-transaction scratch for response parsers
 typedef enum {
     TRANSACTION_PENDING = 0,
     TRANSACTION_COMPLETED = 1,
@@ -313,6 +293,8 @@ typedef struct {
 
     uint64_t timestamp_sent;
     uint8_t retries_left;
+    uint32_t timeout_us;       // Per-attempt timeout of a blocking caller, 0 = the retry check's
+    uint64_t unsent_since_us;  // Set by the retry check while claimed but not yet sent
 
     transaction_status_t status;
     bool response_ready;
@@ -321,7 +303,66 @@ typedef struct {
 
     void *target_ptr;
     size_t target_size;
-} async_transaction_t;
+
+    uint8_t claim;  // Atomic claim flag used by transaction_alloc()
+    bool held;      // Blocking caller still reads the slot (PK_SubmitRequestAndWait)
+    bool multipart; // 512-byte request (CreateRequestAsyncMultipart)
+
+    // Parser state of this request, zeroed on claim (PK_TransactionContext)
+    uint8_t parser_ctx[PK_PARSER_CTX_SIZE] __attribute__((aligned(8)));
+} __attribute__((aligned(PK_CACHELINE))) async_transaction_t;
+
+#define PK_MULTIPART_REQUEST_SIZE  512  // 8 parts x 64 bytes
+#define PK_MULTIPART_DATA_SIZE     448  // 8 parts x 56 data bytes
+
+/*
+ * Transaction engine state of one device.  Everything a request touches
+ * between claim and completion lives here, so devices served from the same
+ * process (or from different threads) never share a slot, a request ID
+ * sequence or a circuit breaker.  Contexts come from a static table and are
+ * bound to a device on its first request (dev->asyncContext).
+ */
+typedef struct {
+    async_transaction_t transactions[MAX_TRANSACTIONS];
+    uint8_t             multipart[MAX_TRANSACTIONS][PK_MULTIPART_REQUEST_SIZE]; // Indexed like transactions
+
+    sPoKeysDevice      *dev;                    // Owner, NULL while free
+    uint8_t             currentRequestID;
+    uint32_t            idBusy[8];              // Bit per request ID a slot still owns
+    uint8_t             systemLoad;             // Device CPU load (%), see scheduler_update_system_load()
+    uint32_t            consecutiveErrors;      // Retry send failures (circuit breaker)
+    uint64_t            lastError_us;
+
+    // Written by the engine owner every cycle, polled by blocking callers
+    uint64_t            lastDispatch_us __attribute__((aligned(PK_CACHELINE)));
+} __attribute__((aligned(PK_CACHELINE))) sPoKeysAsyncContext;
+
+/** Engine context of @p dev, bound on first use; NULL if the table is full. */
+sPoKeysAsyncContext *PK_AsyncContextGet(sPoKeysDevice *dev);
+
+/** Return the context of @p dev to the table (call on disconnect). */
+void PK_AsyncContextRelease(sPoKeysDevice *dev);
+
+/** Open transaction of @p dev with @p request_id, or NULL. */
+async_transaction_t *transaction_find(sPoKeysDevice *dev, uint8_t request_id);
+
+/**
+ * Reserved priority slot of @p dev that owns @p request_id, whatever its
+ * status, or NULL.  Only the PK_PRIORITY_TRANSACTIONS slots are searched
+ * and nothing is logged, so the priority lane can use it from RT.
+ */
+async_transaction_t *PK_PriorityTransactionFind(sPoKeysDevice *dev, uint8_t request_id);
+
+/**
+ * Parser scratch (PK_PARSER_CTX_SIZE bytes, zeroed when the slot was
+ * claimed) of the transaction of @p dev with @p request_id.  Request
+ * functions fill it after Create*, the parser reads it back with the ID
+ * from response[6].  NULL if no such transaction exists.
+ */
+void *PK_TransactionContext(sPoKeysDevice *dev, uint8_t request_id);
+
+#define PK_PARSER_CTX_CHECK(type) \
+    _Static_assert(sizeof(type) <= PK_PARSER_CTX_SIZE, #type " exceeds PK_PARSER_CTX_SIZE")
 
 typedef struct {
     uint8_t request_id;
@@ -354,8 +395,92 @@ int CreateRequestAsyncWithPayload(
         pokeys_response_parser_t parser_func
     );
 
+/**
+ * Same as CreateRequestAsyncWithPayload(), but uses one of the
+ * PK_PRIORITY_TRANSACTIONS reserved slots other than PK_ESTOP_TRANSACTION.
+ * Ordinary traffic can never exhaust these; a still-pending priority request
+ * is superseded instead, but never a pending e-stop.
+ */
+int CreateRequestAsyncPriority(
+        sPoKeysDevice *device,
+        pokeys_command_t cmd,
+        const uint8_t *params,
+        size_t params_len,
+        const void *payload,
+        size_t payload_size,
+        pokeys_response_parser_t parser_func
+    );
+
+/**
+ * E-stop counterpart of CreateRequestAsyncPriority(): uses the
+ * PK_ESTOP_TRANSACTION slot, which only a newer e-stop can supersede.
+ */
+int CreateRequestAsyncEstop(
+        sPoKeysDevice *device,
+        pokeys_command_t cmd,
+        const uint8_t *params,
+        size_t params_len,
+        const void *payload,
+        size_t payload_size,
+        pokeys_response_parser_t parser_func
+    );
+
+/**
+ * Multipart (PK_CMD_MULTIPART_PACKET, 8 x 64 bytes) request tracked as one
+ * transaction; the response is matched on the request ID of the last part.
+ * @param params Header bytes 3..5 (at most 3 bytes).
+ * @param data   Up to PK_MULTIPART_DATA_SIZE bytes, split 56 bytes per part.
+ * @return Request ID (> 0), or negative error code.
+ */
+int CreateRequestAsyncMultipart(sPoKeysDevice *device, const uint8_t *params, size_t params_len,
+                                const void *data, size_t data_len,
+                                pokeys_response_parser_t parser_func);
+
 int SendRequestAsync(sPoKeysDevice *dev, uint8_t request_id);
 
+/** Send a slot returned by PK_RequestTemplateClaim() (no request ID lookup). */
+int PK_TransactionSendAsync(sPoKeysDevice *dev, async_transaction_t *t);
+
+/*
+ * Request templates for the periodic tasks.  The packet (start byte,
+ * command, parameters, fixed payload) and the sum of header bytes 0..5 are
+ * built at compile time with PK_REQUEST_TEMPLATE(); per send only the
+ * request ID, the checksum and the varLen bytes at varOffset are written.
+ * Templates are const and carry no device state, so every device shares
+ * them.
+ */
+#define PK_TEMPLATE_PEV2_TEST_BYTE  0x01   // Byte 3 = (0x10 + request ID) % 199
+
+typedef struct {
+    uint8_t                  packet[64];
+    uint8_t                  headerSum;      // Sum of bytes 0..5
+    uint8_t                  varOffset;      // First byte written per send (>= 8)
+    uint8_t                  varLen;         // Bytes written per send
+    uint8_t                  flags;          // PK_TEMPLATE_*
+    pokeys_command_t         cmd;
+    pokeys_response_parser_t parser;
+} sPoKeysRequestTemplate;
+
+#define PK_REQUEST_TEMPLATE(_cmd, _p0, _p1, _p2, _p3, _var_len, _flags, _parser) { \
+    .packet    = { 0xBB, (_cmd), (_p0), (_p1), (_p2), (_p3) },                   \
+    .headerSum = (uint8_t)(0xBB + (_cmd) + (_p0) + (_p1) + (_p2) + (_p3)),       \
+    .varOffset = 8,                                                              \
+    .varLen    = (_var_len),                                                     \
+    .flags     = (_flags),                                                       \
+    .cmd       = (_cmd),                                                         \
+    .parser    = (_parser) }
+
+/**
+ * Claim a slot and fill it from @p tpl; @p var (up to tpl->varLen bytes)
+ * goes to tpl->varOffset.  Returns NULL if the table is full.
+ */
+async_transaction_t *PK_RequestTemplateClaim(sPoKeysDevice *dev, const sPoKeysRequestTemplate *tpl,
+                                             const void *var, size_t var_len);
+
+/** PK_RequestTemplateClaim() + PK_TransactionSendAsync(); 0 or negative error. */
+int PK_RequestTemplateSendAsync(sPoKeysDevice *dev, const sPoKeysRequestTemplate *tpl,
+                                const void *var, size_t var_len);
+
 /**
  * Convenience wrapper: CreateRequestAsync() + SendRequestAsync() in one call.
  * Use this in every async send function instead of returning CreateRequestAsync()
@@ -384,6 +509,38 @@ int PK_ReceiveAndDispatch(sPoKeysDevice *dev);
 
 void PK_TimeoutAndRetryCheck(sPoKeysDevice *dev, uint64_t timeout_us);
 
+/**
+ * Blocking request through the transaction engine (used by SendEthRequest).
+ * Shares the request ID space and receive path with the async API.
+ * @return PK_OK, PK_ERR_GENERIC (no free slot) or PK_ERR_TRANSFER.
+ */
+int32_t PK_SubmitRequestAndWait(sPoKeysDevice *dev, const uint8_t *request, uint8_t *response,
+                                uint32_t timeout_us, uint8_t retries);
+
+/**
+ * Multipart (8 x 64 byte) blocking request through the transaction engine
+ * (used by SendEthRequestBig).  @p data holds PK_MULTIPART_DATA_SIZE bytes.
+ */
+int32_t PK_SubmitMultipartRequestAndWait(sPoKeysDevice *dev, const uint8_t *request, const uint8_t *data,
+                                         uint8_t *response, uint32_t timeout_us, uint8_t retries);
+
+/** True while the RT engine is receiving on @p dev's socket (blocking I/O must not read it). */
+bool PK_AsyncOwnsSocket(const sPoKeysDevice *dev);
+
+/**
+ * True if blocking transfers of @p dev go through the transaction engine:
+ * a context is bound and the link is UDP or the engine owns the socket.
+ * Without a context (table full) they use the direct socket path.
+ */
+bool PK_AsyncUseEngine(sPoKeysDevice *dev);
+
+/**
+ * Next request ID of @p dev, shared by all request paths of that device.
+ * IDs still owned by a transaction slot are skipped.  Returns 0 (never a
+ * valid ID) when no async context could be bound.
+ */
+uint8_t next_request_id(sPoKeysDevice *dev);
+
 // PulseEngine v2 Async Functions
 int PK_PEv2_StatusGetAsync(sPoKeysDevice *device);
 int PK_PEv2_Status2GetAsync(sPoKeysDevice *device);
@@ -392,14 +549,68 @@ int PK_PEv2_AdditionalParametersGetAsync(sPoKeysDevice *device);
 int PK_PEv2_AdditionalParametersSetAsync(sPoKeysDevice *device);
 int PK_PEv2_AxisConfigurationGetAsync(sPoKeysDevice *device);
 int PK_PEv2_AxisConfigurationSetAsync(sPoKeysDevice *device);
+int PK_PEv2_BacklashCompensationSettingsGetAsync(sPoKeysDevice *device);
+int PK_PEv2_BacklashCompensationSettingsSetAsync(sPoKeysDevice *device);
 int PK_PEv2_PulseEngineMovePVAsync(sPoKeysDevice *device);
 int PK_PEv2_HomingStartAsync(sPoKeysDevice *device);
 int PK_PEv2_ExternalOutputsSetAsync(sPoKeysDevice *device);
+int PK_PEv2_StatusRequestCreateAsync(sPoKeysDevice *device, pokeys_response_parser_t parser);
+int PK_PEv2_StatusDecode(sPoKeysDevice *dev, const uint8_t *resp);
+int PK_PEv2_StatusPublishHAL(sPoKeysDevice *dev);
+int PK_PEv2_FeedbackExtrapolateHAL(sPoKeysDevice *dev);
+
+/** Request slots of a bulk PEv2 configuration transfer (PEv2.cfgReqID). */
+#define PK_PEV2_CFG_AXIS0       0   /* 0..7: axis configuration */
+#define PK_PEV2_CFG_ADDITIONAL  8   /* additional parameters (emergency input) */
+#define PK_PEV2_CFG_BACKLASH    9   /* backlash compensation settings */
+#define PK_PEV2_CFG_COUNT       10
+
+/**
+ * @brief Reads all 8 axis configurations, the additional parameters and the
+ * backlash settings with every request in flight at once.
+ * Poll PK_PEv2_ConfigurationBulkStatus() for completion.
+ * @param timeout_us Deadline for the whole transfer.
+ */
+int PK_PEv2_ConfigurationGetAllAsync(sPoKeysDevice *dev, uint32_t timeout_us);
+
+/** @brief Bulk write counterpart of PK_PEv2_ConfigurationGetAllAsync(). */
+int PK_PEv2_ConfigurationSetAllAsync(sPoKeysDevice *dev, uint32_t timeout_us);
+
+/**
+ * @brief Completion of the last bulk configuration transfer.
+ * @return PK_OK when every request was answered, PK_ERR_AGAIN while some are
+ *         in flight, PK_ERR_TIMEOUT if the deadline passed first,
+ *         PK_ERR_TRANSFER if a request could not be created or sent or its
+ *         response did not parse (see PEv2.cfgFailedMask).
+ */
+int PK_PEv2_ConfigurationBulkStatus(sPoKeysDevice *dev);
+
+/** Phases of the acknowledged PEv2 engine state machine (PEv2.smPhase). */
+typedef enum {
+    PK_PEV2_SM_IDLE    = 0,   /**< No transition in progress */
+    PK_PEV2_SM_SETTING = 1,   /**< SET_STATE sent, waiting for the acknowledge */
+    PK_PEV2_SM_VERIFY  = 2,   /**< Acknowledged, status read back to confirm the state */
+    PK_PEV2_SM_FAULT   = 3    /**< Not confirmed within state-timeout-ms */
+} ePK_PEv2StatePhase;
+
+/**
+ * @brief Drives PEv2 engine state from the engine-enable / engine-reset pins.
+ * Each transition is acknowledged, confirmed from a status read, retried and
+ * time-boxed.  Call once per servo cycle after responses have been dispatched.
+ */
+int PK_PEv2_StateMachineService(sPoKeysDevice *dev);
 
 // Motion buffer async functions
 int PK_PEv2_BufferFillAsync(sPoKeysDevice *device);
 int PK_PEv2_BufferFill_16Async(sPoKeysDevice *device);
 int PK_PEv2_BufferClearAsync(sPoKeysDevice *device);
+int PK_PEv2_BufferFillRequestCreateAsync(sPoKeysDevice *device, const uint8_t *entries,
+                                         uint8_t count, pokeys_response_parser_t parser);
+int PK_PEv2_BufferFillDecode(sPoKeysDevice *dev, const uint8_t *resp);
+int PK_PEv2_BufferFillLargeAsync(sPoKeysDevice *device);
+int PK_PEv2_BufferFillLarge_16Async(sPoKeysDevice *device);
+int PK_PEv2_BufferFillLargeRequestCreateAsync(sPoKeysDevice *device, const uint8_t *entries,
+                                              uint8_t count, pokeys_response_parser_t parser);
 
 // Encoder Reset Functions - Critical for LinuxCNC compatibility
 int PK_EncoderRawValueResetAsync(sPoKeysDevice* device, uint32_t encoderMask);
@@ -491,6 +702,575 @@ int PK_PoNETModuleReinitializeAsync(sPoKeysDevice* device, uint8_t moduleID);
 /* PEv2 HAL pin export - implemented in PoKeysLibPulseEngine_v2Async.c */
 int export_pev2_pins(const char *prefix, long comp_id, sPoKeysDevice *device);
 
+/* -------------------------------------------------------------------------
+ * Device groups - coherent multi-board PEv2 feedback
+ * (implemented in PoKeysLibDeviceGroupAsync.c)
+ *
+ * The PEv2 status requests of all group members are sent back to back in
+ * one batch and tagged with a group epoch.  HAL feedback pins of the members
+ * are only written once every member has answered for that epoch, or when
+ * the epoch deadline expires (partial snapshot, coherent = 0).
+ * ------------------------------------------------------------------------- */
+
+#define PK_DEVICE_GROUP_MAX          4   // Maximum number of device groups
+#define PK_DEVICE_GROUP_MAX_MEMBERS  4   // Maximum number of boards per group
+
+typedef struct {
+    sPoKeysDevice *members[PK_DEVICE_GROUP_MAX_MEMBERS];
+    uint8_t        memberCount;
+    uint8_t        memberReqID[PK_DEVICE_GROUP_MAX_MEMBERS]; // Request ID of each member for the current epoch
+    uint8_t        answeredMask;                             // Members that answered the current epoch
+    uint8_t        inFlight;                                 // Epoch requests sent, snapshot not yet published
+
+    uint32_t       epoch;
+    uint32_t       deadline_us;                              // Publish a partial snapshot after this time
+    uint64_t       epochStart_us;
+    uint64_t       firstAnswer_us;
+    uint64_t       lastAnswer_us;
+    uint32_t       deadlineMisses;
+    uint32_t       staleResponses;                           // Responses that arrived for an old epoch
+
+    hal_u32_t     *pin_epoch;                                // Epoch of the last published snapshot
+    hal_bit_t     *pin_coherent;                             // 1 if all members answered that epoch
+    hal_u32_t     *pin_missing_mask;                         // Members missing from the last snapshot
+    hal_u32_t     *pin_skew_us;                              // First to last member answer in the last snapshot
+    hal_u32_t     *pin_deadline_misses;
+    hal_u32_t     *pin_stale_responses;
+} sPoKeysDeviceGroup;
+
+/**
+ * @brief Creates a device group.
+ * @param members     Member devices; members[0] is the group leader.
+ * @param count       Number of members (1..PK_DEVICE_GROUP_MAX_MEMBERS).
+ * @param deadline_us Epoch deadline in microseconds.
+ * @return Group index (>= 0), or a negative PK_ERR code.
+ */
+int PK_DeviceGroupCreate(sPoKeysDevice **members, uint8_t count, uint32_t deadline_us);
+
+/** Returns the group, or NULL for an invalid index. */
+sPoKeysDeviceGroup *PK_DeviceGroupGet(int group);
+
+/**
+ * @brief Starts a new sampling epoch for the group led by @p leader.
+ *
+ * Scheduler-compatible (async_func_t); register it in place of the members'
+ * own PK_PEv2_StatusUpdateHALAsync tasks.  While an epoch is still in flight
+ * and its deadline has not passed, the call does nothing; once the deadline
+ * has passed, the partial snapshot is published before the next epoch starts.
+ */
+int PK_DeviceGroupSampleAsync(sPoKeysDevice *leader);
+
+int export_device_group_pins(const char *prefix, long comp_id, int group);
+
+/* -------------------------------------------------------------------------
+ * PEv2 motion-buffer streaming
+ * (implemented in PoKeysLibMotionStreamAsync.c)
+ *
+ * The servo thread pushes one 8-bit motion slot per cycle into a host ring;
+ * PK_MotionStreamService() moves them to the device with at most one
+ * BufferFill in flight.  Credits come from PEv2.info.bufferDepth minus the
+ * estimated device level, which is corrected by the accepted count of every
+ * fill response.  Slots are released only once the device accepted them.
+ * Fills are sent without engine retries: when a fill gets no answer, the
+ * stream waits until it would have run out and reads the device position
+ * back, then releases the slots the device executed and resends only the
+ * rest, so a lost response never makes a segment run twice.
+ * ------------------------------------------------------------------------- */
+
+#define PK_MOTION_STREAM_MAX         4      // Devices that can stream at the same time
+#define PK_MOTION_STREAM_SLOTS       256    // Host ring depth (power of two)
+#define PK_MOTION_STREAM_SLOT_US     1000   // Device consumes one slot per millisecond
+#define PK_MOTION_STREAM_TIMEOUT_US  5000   // Fill without response is reconciled after this
+#define PK_MOTION_STREAM_SETTLE_US   2000   // Margin after a lost fill would have run out
+
+/*
+ * Trajectory-to-pulse encoder for motion-buffer slots.
+ *
+ * Each slot carries the absolute pulse target minus the pulses already
+ * emitted, rounded half up, so rounding never accumulates.  emitted[] holds
+ * whole pulses in a double (exact up to 2^53).  A delta beyond the slot
+ * range is clamped, counted in saturations[] and carried into the following
+ * slots instead of being lost.  All 8 axes are processed as fixed-width
+ * lanes with one double -> int32 conversion each; built with -O2 (GCC 12)
+ * the lane loop vectorises on plain SSE2.  Makefile.noqmakeRT builds
+ * without optimisation, where it stays scalar.
+ */
+#define PK_MOTION_ENC_BIAS       65536.0  // Keeps the rounded delta positive for the int32 conversion
+#define PK_MOTION_ENC_MAX_8BIT   127      // bits 6:0 count, bit 7 direction
+#define PK_MOTION_ENC_MAX_16BIT  32767    // bits 14:0 count, bit 15 direction
+
+typedef struct {
+    double         scale[8];         // Pulses per position unit
+    double         emitted[8];       // Pulses sent to the device so far (whole numbers)
+    uint32_t       saturations[8];   // Slots clamped to the slot range, per axis
+    uint8_t        axes;             // Axes per slot (1..8)
+    uint8_t        wide;             // 0 = 8-bit slots, 1 = 16-bit slots
+
+    hal_u32_t     *pin_saturations[8];
+} sPoKeysMotionEncoder;
+
+/** Sets axis count, slot width and scales; does not touch emitted[]. */
+void PK_MotionEncoderConfigure(sPoKeysMotionEncoder *enc, uint8_t axes, uint8_t wide, const double *scale);
+
+/** Aligns the encoder to the current positions so the next slot starts from zero. */
+void PK_MotionEncoderReset(sPoKeysMotionEncoder *enc, const double *pos);
+
+/**
+ * @brief Encodes a block of servo samples into motion-buffer slots.
+ * @param pos   count x 8 positions (sample-major, all 8 lanes per sample).
+ * @param count Number of samples; one slot is produced per sample.
+ * @param out   count x axes bytes (8-bit) or count x axes x 2 bytes (16-bit, LE).
+ * @return Number of bytes written.
+ */
+uint32_t PK_MotionEncodeBlock(sPoKeysMotionEncoder *enc, const double *pos, uint32_t count, uint8_t *out);
+
+typedef struct {
+    sPoKeysDevice *dev;
+    uint8_t        slots[PK_MOTION_STREAM_SLOTS][8];  // One entry byte per axis
+
+    uint32_t       head;             // Sequence number of the next slot pushed
+    uint32_t       acked;            // First sequence number not yet accepted by the device
+
+    uint8_t        inFlight;         // A fill is waiting for its response
+    uint8_t        fillReqID;
+    uint8_t        fillCount;        // Slots carried by the fill in flight
+    uint8_t        lastAccepted;     // Accepted count of the last fill response
+    uint32_t       fillSeq;          // Sequence number of the first slot in the fill
+    uint32_t       fillLevel;        // Estimated device level when the fill was sent
+    uint64_t       fillSent_us;
+
+    int32_t        ackedPos[8];      // Device position once every accepted slot has run
+    uint8_t        reconciling;      // Fill timed out; position read-back pending
+    uint8_t        reconcileReqID;   // Status read in flight (0 = none)
+    uint64_t       reconcileAt_us;   // Time by which the lost fill would have run out
+    uint64_t       reconcileSent_us;
+
+    uint32_t       deviceLevel;      // Estimated slots queued in the device
+    uint64_t       levelStamp_us;    // Time up to which deviceLevel has been drained
+    uint8_t        primed;           // Device buffer has held slots since the last underrun
+
+    uint32_t       underruns;
+    uint32_t       overruns;         // Slots dropped because the host ring was full
+    uint32_t       resends;
+    uint32_t       staleResponses;
+    uint32_t       reconcileFaults;  // Read-back matched no prefix of the lost fill
+
+    sPoKeysMotionEncoder encoder;   // Used by callers that push positions
+
+    hal_u32_t     *pin_host_level;
+    hal_u32_t     *pin_device_level;
+    hal_u32_t     *pin_underruns;
+    hal_u32_t     *pin_overruns;
+    hal_u32_t     *pin_resends;
+} sPoKeysMotionStream;
+
+/** Attaches a motion stream to a device.  @return PK_OK or negative PK_ERR code. */
+int PK_MotionStreamCreate(sPoKeysDevice *dev);
+
+/** Returns the stream of a device, or NULL. */
+sPoKeysMotionStream *PK_MotionStreamGet(const sPoKeysDevice *dev);
+
+/** Drops all queued slots and forgets the fill in flight (e.g. on mode change). */
+void PK_MotionStreamReset(sPoKeysDevice *dev);
+
+/**
+ * @brief Appends one slot (one entry byte per enabled axis) to the host ring.
+ * @return PK_OK, or PK_ERR_GENERIC if the ring is full (counted as overrun).
+ */
+int PK_MotionStreamPush(sPoKeysDevice *dev, const uint8_t *entries);
+
+/**
+ * @brief Sends the next fill if none is in flight and the device has credit.
+ * Call once per servo cycle after responses have been dispatched.
+ */
+int PK_MotionStreamService(sPoKeysDevice *dev);
+
+int export_motion_stream_pins(const char *prefix, long comp_id, sPoKeysDevice *dev);
+
+/* -------------------------------------------------------------------------
+ * Priority lane for safety-critical outputs and e-stop
+ * (implemented in PoKeysLibPriorityAsync.c)
+ *
+ * Edges on PEv2.estop-request and on the external relay/OC output pins are
+ * sent in the servo cycle they are seen, through reserved transaction slots
+ * (CreateRequestAsyncPriority), instead of waiting for the 100 Hz tasks.
+ * Each request can be repeated a few times at a fixed spacing; duplicates
+ * carry the same request ID and are idempotent on the device.
+ * ------------------------------------------------------------------------- */
+
+#define PK_PRIORITY_LANE_MAX      4    // Devices with a priority lane
+#define PK_PRIORITY_ESTOP         0    // Lane request index: engine stop
+#define PK_PRIORITY_OUTPUTS       1    // Lane request index: external outputs
+#define PK_PRIORITY_REQUESTS      2
+
+typedef struct {
+    sPoKeysDevice *dev;
+    uint8_t        primed;                           // Previous pin states are valid
+    uint8_t        estopPrev;                        // estop-request on the previous service
+    uint8_t        relayPrev;                        // External relay mask on the previous service
+    uint8_t        ocPrev;                           // External OC mask on the previous service
+
+    async_transaction_t *trans[PK_PRIORITY_REQUESTS]; // Slot of the request being repeated
+    uint8_t        reqID[PK_PRIORITY_REQUESTS];      // Request being repeated (slot superseded if it differs)
+    uint8_t        copiesLeft[PK_PRIORITY_REQUESTS]; // Redundant copies still to send
+    uint64_t       nextCopy_us[PK_PRIORITY_REQUESTS];
+    uint32_t       edges;                            // Edges sent through the lane
+    uint32_t       sendErrors;                       // Lane sends that failed
+
+    hal_bit_t     *pin_estop_request;                // HAL_IN  rising edge stops the engine
+    hal_u32_t     *pin_copies;                       // HAL_IN  transmissions per edge (1 = no redundancy)
+    hal_u32_t     *pin_copy_spacing_us;              // HAL_IN  spacing between copies
+    hal_u32_t     *pin_latency_us;                   // HAL_OUT cycle start to first copy on the wire
+    hal_u32_t     *pin_edges;                        // HAL_OUT edges sent
+    hal_u32_t     *pin_send_errors;                  // HAL_OUT failed lane sends
+} sPoKeysPriorityLane;
+
+int PK_PriorityLaneCreate(sPoKeysDevice *dev);
+sPoKeysPriorityLane *PK_PriorityLaneGet(const sPoKeysDevice *dev);
+
+/**
+ * @brief Detects edges on the lane pins and sends them, then sends any
+ * redundant copies that are due.  Call at the start of the servo function
+ * with that cycle's start time, and again later in the cycle so copies go
+ * out close to their spacing.
+ */
+int PK_PriorityLaneService(sPoKeysDevice *dev, uint64_t cycle_start_us);
+
+/** Stops the pulse engine through a reserved priority slot. */
+int PK_PEv2_EmergencyStopPriorityAsync(sPoKeysDevice *dev);
+
+int export_priority_lane_pins(const char *prefix, long comp_id, sPoKeysDevice *dev);
+
+/* -------------------------------------------------------------------------
+ * Per-cycle device snapshot (implemented in PoKeysLibSnapshotAsync.c)
+ *
+ * Parsers stage digital inputs, encoder counts and PEv2 status into a back
+ * buffer as packets arrive.  PK_SnapshotPublish() copies it to the front
+ * buffer under a seqlock once per servo cycle and only then writes the HAL
+ * pins, so every HAL read within a period sees one consistent, timestamped
+ * set.  Other threads read the front buffer with PK_SnapshotRead().
+ * Devices without a snapshot keep writing HAL pins from the parsers.
+ * ------------------------------------------------------------------------- */
+
+#define PK_SNAPSHOT_MAX           4    // Devices with a snapshot
+#define PK_SNAPSHOT_ENCODERS      26   // Basic + fast encoders (pages 0 and 1)
+
+typedef enum {
+    PK_SNAPSHOT_DIGITAL_IN = 0,
+    PK_SNAPSHOT_ENCODERS_SUB,
+    PK_SNAPSHOT_PEV2_STATUS,
+    PK_SNAPSHOT_SUBSYSTEMS
+} ePK_SnapshotSubsystem;
+
+typedef struct {
+    uint64_t stamp_us[PK_SNAPSHOT_SUBSYSTEMS];   // Arrival of the newest packet per subsystem (0 = none)
+    uint8_t  digitalIn[7];                       // Digital input bits, pins 0..55
+    uint32_t encoderValidMask;                   // Encoders received at least once
+    int32_t  encoder[PK_SNAPSHOT_ENCODERS];      // Raw encoder counts
+
+    uint8_t  PulseEngineState;                   // PEv2 status, all from one packet
+    uint8_t  PulseEngineActivated;
+    uint8_t  ErrorInputStatus;
+    uint8_t  LimitStatusP;
+    uint8_t  LimitStatusN;
+    uint8_t  HomeStatus;
+    uint8_t  AxesState[8];
+    int32_t  CurrentPosition[8];
+    double   fbVelocity[8];                      // Velocity estimate belonging to CurrentPosition
+} sPoKeysSnapshotData;
+
+typedef struct {
+    sPoKeysDevice      *dev;
+    uint32_t            seq;                     // Seqlock: odd while front is rewritten
+    uint8_t             dirtyMask;               // Subsystems staged since the last publish
+    sPoKeysSnapshotData back;                    // Staged by the parsers
+    sPoKeysSnapshotData front;                   // Published set
+    sPoKeysBitBank      digitalInBank;           // Digital inputs as written to HAL, with edge counts
+
+    hal_u32_t          *pin_seq;                 // HAL_OUT publish sequence (even)
+    hal_u32_t          *pin_skew_us;             // HAL_OUT stamp spread of the published set
+} sPoKeysSnapshot;
+
+int PK_SnapshotCreate(sPoKeysDevice *dev);
+sPoKeysSnapshot *PK_SnapshotGet(const sPoKeysDevice *dev);
+
+/*
+ * Staging helpers for parsers.  Return PK_OK when staged; any other value
+ * means the device has no snapshot and the caller writes HAL directly.
+ */
+int PK_SnapshotStageDigitalInputs(sPoKeysDevice *dev, const uint8_t *bits);
+int PK_SnapshotStageEncoders(sPoKeysDevice *dev, uint32_t first, uint32_t count, const uint8_t *raw);
+
+/** Stage the decoded device->PEv2 status, or publish it at once without a snapshot. */
+int PK_SnapshotStagePEv2Status(sPoKeysDevice *dev);
+
+/** Copy the single-packet PEv2 status fields of device->PEv2 into @p st. */
+void PK_PEv2_StatusCapture(const sPoKeysDevice *dev, sPoKeysSnapshotData *st);
+
+/** Write a captured PEv2 status set (e.g. the snapshot front buffer) to HAL. */
+int PK_PEv2_StatusPublishHALFrom(sPoKeysDevice *dev, const sPoKeysSnapshotData *st);
+
+/** Swap the staged set in and write it to HAL.  Call once per servo cycle. */
+int PK_SnapshotPublish(sPoKeysDevice *dev);
+
+/** Copy the published set; retries while a publish is in progress. */
+int PK_SnapshotRead(const sPoKeysDevice *dev, sPoKeysSnapshotData *out);
+
+int export_snapshot_pins(const char *prefix, long comp_id, sPoKeysDevice *dev);
+
+/**
+ * @brief XOR @p bits (the low @p nbits) against the previously published
+ * state of @p bank, count an edge and stamp it with @p now_us for every bit
+ * that changed, and remember @p bits.  Callers write only the HAL pins of
+ * the returned mask.  The first call reports every bit as changed.
+ */
+uint64_t PK_BitBankUpdate(sPoKeysBitBank *bank, uint64_t bits, uint8_t nbits, uint64_t now_us);
+
+/* Bit layout of sPoKeysPEv2.statusInputBank */
+#define PEV2_BANK_LIMIT_N   0    // Bits 0..7:   LimitStatusN
+#define PEV2_BANK_LIMIT_P   8    // Bits 8..15:  LimitStatusP
+#define PEV2_BANK_HOME      16   // Bits 16..23: HomeStatus
+#define PEV2_BANK_ESTOP     24   // Bit 24:      ErrorInputStatus bit 0
+#define PEV2_BANK_BITS      25
+
+/* -------------------------------------------------------------------------
+ * Digital pin bank (implemented in PoKeysLibIOAsync.c)
+ *
+ * Structure-of-arrays view of the digital I/O hot path.  sPoKeysPinData
+ * stays the cold per-pin configuration; the bank holds one-bit-per-pin
+ * masks and dense HAL pointer arrays, each starting on its own cache line,
+ * so the get/set tasks no longer stride over whole pin records.
+ * PK_PinBankSync() builds it from Pins[] after export_IO_pins() and must be
+ * called again after Pins[].preventUpdate is changed.
+ * ------------------------------------------------------------------------- */
+
+#define PK_PINBANK_MAX            4    // Devices with a pin bank
+#define PK_PINBANK_PINS           56   // Pins covered by the 0xCC block I/O
+
+typedef struct {
+    uint64_t       inValid;                      // Pins with exported digin pins
+    uint64_t       outValid;                     // Pins with exported digout pins
+    uint64_t       preventMask;                  // Pins excluded from output writes
+    uint32_t       pinCount;
+    sPoKeysDevice *dev;
+
+    hal_bit_t     *in[PK_PINBANK_PINS]     __attribute__((aligned(PK_CACHELINE)));
+    hal_bit_t     *in_not[PK_PINBANK_PINS] __attribute__((aligned(PK_CACHELINE)));
+    hal_bit_t     *out[PK_PINBANK_PINS]    __attribute__((aligned(PK_CACHELINE)));
+} __attribute__((aligned(PK_CACHELINE))) sPoKeysPinBank;
+
+/** Create or refresh the pin bank of @p dev from its Pins[] records. */
+int PK_PinBankSync(sPoKeysDevice *dev);
+sPoKeysPinBank *PK_PinBankGet(const sPoKeysDevice *dev);
+
+/**
+ * @brief Build the 0xCC set payload: output bits in bytes 0..6 and the
+ * "do not update" mask (preventUpdate and pins without digout) in 12..18.
+ */
+void PK_PinBankBuildOutputs(const sPoKeysPinBank *bank, uint8_t *payload);
+
+/** Write the pins selected by @p changed to HAL from @p bits (bit n = pin n). */
+void PK_PinBankPublishInputs(const sPoKeysPinBank *bank, uint64_t bits, uint64_t changed);
+
+/* -------------------------------------------------------------------------
+ * Output shadow registers (implemented in PoKeysLibShadowAsync.c)
+ *
+ * Per-device record of the last device-acknowledged value of each output
+ * group.  The periodic output tasks only write groups whose value differs,
+ * re-send writes that timed out or failed, and refresh every group after
+ * outputs.refresh-ms (0 disables the refresh).
+ * ------------------------------------------------------------------------- */
+
+#define PK_SHADOW_MAX             4    // Devices with output shadows
+#define PK_SHADOW_VALUE_BYTES     64   // cmd + 4 params + up to 56 payload bytes
+
+typedef enum {
+    PK_SHADOW_DIGITAL_OUT = 0,
+    PK_SHADOW_PWM,
+    PK_SHADOW_POEXTBUS,
+    PK_SHADOW_PONET_STATUS,
+    PK_SHADOW_PEV2_EXTOUT,
+    PK_SHADOW_GROUPS
+} ePK_ShadowGroup;
+
+typedef struct {
+    uint8_t  acked[PK_SHADOW_VALUE_BYTES];       // Last acknowledged value
+    uint8_t  inflight[PK_SHADOW_VALUE_BYTES];    // Value of the write in flight
+    uint16_t ackedLen;
+    uint16_t inflightLen;
+    uint8_t  ackedValid;                         // acked reflects the device
+    uint8_t  reqID;                              // Write in flight (0 = none)
+    uint64_t sent_us;
+    uint64_t acked_us;
+} sPoKeysShadowGroup;
+
+typedef struct {
+    sPoKeysDevice     *dev;
+    sPoKeysShadowGroup group[PK_SHADOW_GROUPS];
+    uint32_t           writes;                   // Writes put on the wire
+    uint32_t           suppressed;               // Writes skipped as unchanged
+    uint32_t           resends;                  // Writes repeated after a timeout/failure
+
+    hal_u32_t         *pin_refresh_ms;           // HAL_IN  re-send unchanged groups after this
+    hal_u32_t         *pin_writes;               // HAL_OUT
+    hal_u32_t         *pin_suppressed;           // HAL_OUT
+    hal_u32_t         *pin_resends;              // HAL_OUT
+} sPoKeysShadow;
+
+int PK_ShadowCreate(sPoKeysDevice *dev);
+sPoKeysShadow *PK_ShadowGet(const sPoKeysDevice *dev);
+
+/** Forget all acknowledged values, e.g. after a reconnect; every group is written again. */
+void PK_ShadowInvalidate(sPoKeysDevice *dev);
+
+/**
+ * @brief Write an output group unless the device already acknowledged the
+ * same value.  Without a shadow for @p dev the request is always sent.
+ * @return PK_OK when sent or skipped, negative error code otherwise.
+ */
+int PK_ShadowWriteAsync(sPoKeysDevice *dev, ePK_ShadowGroup group, pokeys_command_t cmd,
+                        const uint8_t *params, size_t params_len,
+                        const uint8_t *payload, size_t payload_size,
+                        pokeys_response_parser_t parser);
+
+int export_shadow_pins(const char *prefix, long comp_id, sPoKeysDevice *dev);
+
+/* -------------------------------------------------------------------------
+ * Demand-driven polling (implemented in PoKeysLibDemandAsync.c)
+ *
+ * The component's own pins are scanned for signal links, at most
+ * PK_DEMAND_SCAN_BATCH pins per call of the demand_scan task; the result
+ * is applied after each complete pass.  Each input/poll task stays enabled
+ * only while the device has the feature (info flags, once device info was
+ * read) and at least one pin it serves is linked.  Output tasks only need
+ * the feature: they send on change, so setp on an unlinked pin still
+ * reaches the device.  demand.task-mask reports the result, one bit per entry of
+ * the demand task table (same order as the registration in
+ * start_async_processing); tasks outside the table are never touched.
+ * Tasks of pin groups that were not exported are never enabled.
+ * ------------------------------------------------------------------------- */
+
+#define PK_DEMAND_MAX             4    // Devices with demand tracking
+
+typedef enum {
+    PK_DEMAND_DIGIN = 0,                         // digin.*
+    PK_DEMAND_DIGOUT,                            // digout.*
+    PK_DEMAND_ENCODER,                           // encoder.*
+    PK_DEMAND_ADCIN,                             // adcin.*
+    PK_DEMAND_ADCOUT,                            // adcout.* (PWM)
+    PK_DEMAND_PONET,                             // ponet.*
+    PK_DEMAND_PEV2,                              // PEv2.*
+    PK_DEMAND_RTC,                               // rtc.*
+    PK_DEMAND_CLASSES
+} ePK_DemandClass;
+
+typedef struct {
+    sPoKeysDevice *dev;
+    int            comp_id;
+    char           prefix[HAL_NAME_LEN + 1];
+    uint8_t        scanned;                      // At least one scan completed
+    uint32_t       exportedClasses;              // Groups whose pins were exported
+    uint32_t       linkedClasses;                // Bit per ePK_DemandClass
+    uint32_t       encoderLinked;                // Bit per linked encoder index
+    uint32_t       taskMask;                     // Bit per demand task table entry
+    const void    *scanFirst;                    // First pin under prefix (hal_pin_t *)
+    const void    *scanCursor;                   // Next pin of the pass, NULL = start a pass
+    uint32_t       scanLinked;                   // linkedClasses of the pass in progress
+    uint32_t       scanEncoders;                 // encoderLinked of the pass in progress
+
+    hal_bit_t     *pin_enable;                   // HAL_IN  0 keeps every task enabled
+    hal_u32_t     *pin_task_mask;                // HAL_OUT
+    hal_u32_t     *pin_linked_mask;              // HAL_OUT bit per ePK_DemandClass
+} sPoKeysDemand;
+
+/**
+ * @brief Create demand tracking for @p dev.  Tasks serving a class outside
+ * @p exported (pins not exported, see the groups= modparam) are disabled
+ * right away and stay disabled regardless of demand.enable.
+ */
+int PK_DemandCreate(sPoKeysDevice *dev, int comp_id, const char *prefix, uint32_t exported);
+sPoKeysDemand *PK_DemandGet(const sPoKeysDevice *dev);
+
+/**
+ * Scheduler task: walk the next batch of pins; after a complete pass,
+ * update the task enables.  Bounded per call, safe from the servo thread.
+ */
+int PK_DemandScanAsync(sPoKeysDevice *dev);
+
+/**
+ * @brief Whether any encoder in [first, first+count) is linked.  Returns 1
+ * until the first scan completed or without demand tracking for @p dev.
+ */
+int PK_DemandEncodersWanted(const sPoKeysDevice *dev, uint32_t first, uint32_t count);
+
+int export_demand_pins(const char *prefix, long comp_id, sPoKeysDevice *dev);
+
+/* -------------------------------------------------------------------------
+ * Device memory arena (implemented in PoKeysLibArenaAsync.c)
+ *
+ * One hal_malloc block per device, sized from the device info right after
+ * PK_DeviceDataGet() on connect, locked with mlock() and touched page by
+ * page so the servo thread never takes the first-touch page fault.  Only
+ * the per-device arrays of InitializeNewDevice() are carved from it.
+ * Memory allocated before the info is known (the device record, socket
+ * handles, netDeviceData) and the static transaction and packet tables of
+ * PoKeysLibAsync.c are not in the arena; they are only locked and
+ * prefaulted in place.  PK_ArenaSealAll() is called at hal_ready().  The
+ * seal does not prevent allocations: a later PK_ArenaAlloc() still
+ * succeeds through hal_malloc (a reconnect must get its arrays), but it is
+ * logged and counted in arena.late-allocs, which must stay 0.
+ * ------------------------------------------------------------------------- */
+
+#define PK_ARENA_MAX              4    // Devices with an arena
+#define PK_ARENA_SLACK            1024 // Spare bytes beyond the computed size
+
+typedef struct {
+    sPoKeysDevice *dev;
+    uint8_t       *base;                         // PK_CACHELINE aligned
+    size_t         size;
+    size_t         used;
+    uint32_t       allocs;                       // Served from the arena
+    uint32_t       fallbacks;                    // Arena full or sealed, served by hal_malloc
+    uint32_t       lateAllocs;                   // Requested after PK_ArenaSealAll
+    uint8_t        locked;                       // mlock() succeeded
+    uint8_t        sealed;
+
+    hal_u32_t     *pin_size;                     // HAL_OUT
+    hal_u32_t     *pin_used;                     // HAL_OUT
+    hal_u32_t     *pin_late_allocs;              // HAL_OUT
+} sPoKeysArena;
+
+/** Bytes the per-device arrays of InitializeNewDevice() need for @p info. */
+size_t PK_ArenaSizeFor(const sPoKeysDevice_Info *info);
+
+/**
+ * @brief Create the arena of @p dev from dev->info and prefault it together
+ * with the memory the device already owns.  Calling it again before the
+ * seal rewinds the arena (re-initialisation of the same device).
+ */
+int PK_ArenaCreate(sPoKeysDevice *dev);
+sPoKeysArena *PK_ArenaGet(const sPoKeysDevice *dev);
+
+/**
+ * @brief Zeroed, PK_CACHELINE aligned memory from the arena of @p dev.
+ * Falls back to hal_malloc (prefaulted, not from the arena) when there is
+ * no arena, it is exhausted or it was sealed; the sealed case is counted
+ * in lateAllocs.
+ */
+void *PK_ArenaAlloc(sPoKeysDevice *dev, size_t size);
+
+/** mlock() @p size bytes at @p p and touch every page. */
+int PK_ArenaPrefault(void *p, size_t size);
+
+/** Mark every arena sealed; call right before hal_ready().  Allocation
+ * keeps working afterwards, it is only counted (see PK_ArenaAlloc). */
+void PK_ArenaSealAll(void);
+
+/** Lock and prefault the engine contexts of PoKeysLibAsync.c. */
+void PK_AsyncPrefault(void);
+
+int export_arena_pins(const char *prefix, long comp_id, sPoKeysDevice *dev);
+
 /* -------------------------------------------------------------------------
  * Async Scheduler
  * Provides periodic, rate-limited firing of async send functions so that
@@ -500,7 +1280,7 @@ int export_pev2_pins(const char *prefix, long comp_id, sPoKeysDevice *device);
  * (Migrated from experimental/async_scheduler.h per architecture rules.)
  * ------------------------------------------------------------------------- */
 
-#define MAX_ASYNC_TASKS 16
+#define MAX_ASYNC_TASKS 32 // All devices together
 
 typedef int (*async_func_t)(sPoKeysDevice *dev);
 
@@ -549,8 +1329,11 @@ int register_async_task(async_func_t func, sPoKeysDevice *dev, double freq_hz,
  */
 int async_dispatcher(void);
 
-/** Enable or disable a named task without removing it from the table. */
-void async_task_set_active(const char *name, int active);
+/**
+ * Enable or disable the task @p name of @p dev (NULL: of every device)
+ * without removing it from the table.
+ */
+void async_task_set_active(sPoKeysDevice *dev, const char *name, int active);
 
 /** Return the number of registered tasks. */
 size_t async_task_count(void);
@@ -563,17 +1346,17 @@ size_t async_task_count(void);
 void scheduler_set_machine_on(int machine_on);
 
 /**
- * Return the last observed device CPU load percentage (0–100).
+ * Return the last observed CPU load percentage (0–100) of @p dev.
  * Used by callers that need to display or log the current interface load.
  */
-uint8_t scheduler_get_system_load(void);
+uint8_t scheduler_get_system_load(sPoKeysDevice *dev);
 
 /**
- * Update the scheduler's cached system load.
+ * Update the cached system load of @p dev.
  * Call this from the PK_CMD_DEVICE_LOAD_STATUS response parser (or after
- * reading dev->deviceLoadStatus.CPUload) so the dispatcher can apply
- * load-based throttling on the next cycle.
+ * reading dev->deviceLoadStatus.CPUload) so the dispatcher can throttle the
+ * tasks of that device on the next cycle.
  */
-void scheduler_update_system_load(uint8_t cpu_load);
+void scheduler_update_system_load(sPoKeysDevice *dev, uint8_t cpu_load);
 
 #endif // POKEYSLIB_ASYNC_H
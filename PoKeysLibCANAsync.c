@@ -22,12 +22,12 @@ typedef struct {
     uint8_t used;
 } CANAsyncContext;
 
-static CANAsyncContext can_ctx[256];
+PK_PARSER_CTX_CHECK(CANAsyncContext);
 
 static int PK_CANRead_Parse(sPoKeysDevice *dev, const uint8_t *resp)
 {
-    uint8_t id = resp[6];
-    CANAsyncContext *c = &can_ctx[id];
+    CANAsyncContext *c = PK_TransactionContext(dev, resp[6]);
+    if (!c) return PK_ERR_GENERIC;
     if (c->status_ptr)
         *(c->status_ptr) = resp[3];
     if (c->msg_ptr && resp[3])
@@ -73,9 +73,11 @@ int PK_CANReadAsync(sPoKeysDevice* device, sPoKeysCANmsg *msg, uint8_t *status)
     int req = CreateRequestAsync(device, PK_CMD_CAN_OPERATIONS, params, 1,
                                  NULL, 0, PK_CANRead_Parse);
     if (req < 0) return req;
-    can_ctx[req].status_ptr = status;
-    can_ctx[req].msg_ptr = msg;
-    can_ctx[req].used = 1;
+    CANAsyncContext *c = PK_TransactionContext(device, (uint8_t)req);
+    if (!c) return PK_ERR_GENERIC;
+    c->status_ptr = status;
+    c->msg_ptr = msg;
+    c->used = 1;
     return SendRequestAsync(device, req);
 }
 
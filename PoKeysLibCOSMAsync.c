@@ -8,12 +8,12 @@ typedef struct {
     uint8_t used;
 } COSMAsyncContext;
 
-static COSMAsyncContext cosm_ctx[256];
+PK_PARSER_CTX_CHECK(COSMAsyncContext);
 
 static int PK_COSM_ParseBasic(sPoKeysDevice *dev, const uint8_t *resp)
 {
-    uint8_t id = resp[6];
-    COSMAsyncContext *c = &cosm_ctx[id];
+    COSMAsyncContext *c = PK_TransactionContext(dev, resp[6]);
+    if (!c) return PK_ERR_GENERIC;
     sPoKeysCOSMSettings *s = c->settings;
     if (s) {
         s->updateRate = resp[9] | (resp[10] << 8);
@@ -28,8 +28,8 @@ static int PK_COSM_ParseBasic(sPoKeysDevice *dev, const uint8_t *resp)
 
 static int PK_COSM_ParseHeader(sPoKeysDevice *dev, const uint8_t *resp)
 {
-    uint8_t id = resp[6];
-    COSMAsyncContext *c = &cosm_ctx[id];
+    COSMAsyncContext *c = PK_TransactionContext(dev, resp[6]);
+    if (!c) return PK_ERR_GENERIC;
     if (c->settings) {
         memcpy(c->settings->requestHeaders[c->page], resp + 9, 50);
     }
@@ -43,8 +43,10 @@ int PK_COSMSettingsGetAsync(sPoKeysDevice* device, sPoKeysCOSMSettings* settings
     uint8_t param0[1] = { 0 };
     int req = CreateRequestAsync(device, PK_CMD_COSM_SETTINGS, param0, 1, NULL, 0, PK_COSM_ParseBasic);
     if (req < 0) return req;
-    cosm_ctx[req].settings = settings;
-    cosm_ctx[req].used = 1;
+    COSMAsyncContext *c = PK_TransactionContext(device, (uint8_t)req);
+    if (!c) return PK_ERR_GENERIC;
+    c->settings = settings;
+    c->used = 1;
     int err = SendRequestAsync(device, req);
     if (err != PK_OK) return err;
 
@@ -53,9 +55,11 @@ int PK_COSMSettingsGetAsync(sPoKeysDevice* device, sPoKeysCOSMSettings* settings
         uint8_t param[1] = { (uint8_t)(p+1) };
         int r = CreateRequestAsync(device, PK_CMD_COSM_SETTINGS, param, 1, NULL, 0, PK_COSM_ParseHeader);
         if (r < 0) return r;
-        cosm_ctx[r].settings = settings;
-        cosm_ctx[r].page = p;
-        cosm_ctx[r].used = 1;
+        COSMAsyncContext *hc = PK_TransactionContext(device, (uint8_t)r);
+        if (!hc) return PK_ERR_GENERIC;
+        hc->settings = settings;
+        hc->page = p;
+        hc->used = 1;
         err = SendRequestAsync(device, r);
         if (err != PK_OK) return err;
     }
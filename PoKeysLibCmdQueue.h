@@ -0,0 +1,115 @@
+#ifndef POKEYSLIBCMDQUEUE_H
+#define POKEYSLIBCMDQUEUE_H
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * Async command ring shared by the HAL component's producers and its RT
+ * consumer.  Kept free of HAL headers so it can be exercised on its own
+ * (tests/cmd_queue_stress.c).
+ */
+
+#define MAX_ASYNC_COMMANDS 32  // Maximum number of queued async commands (power of two); async_cmd_queue_reserve() drops new entries when full
+#define ASYNC_COMMAND_MASK (MAX_ASYNC_COMMANDS - 1)
+#if (MAX_ASYNC_COMMANDS & ASYNC_COMMAND_MASK) != 0
+#error "MAX_ASYNC_COMMANDS must be a power of two"
+#endif
+
+typedef enum {
+    CMD_MOVE_PV,
+    CMD_HOME_START,
+    CMD_PROBE_START,
+    CMD_EMERGENCY_STOP,
+    CMD_EXTERNAL_OUTPUT_SET
+} async_cmd_type_t;
+
+typedef struct {
+    async_cmd_type_t type;
+    uint8_t axis_mask;
+    float pos_values[8];
+    float vel_values[8];
+    uint32_t misc_data;
+    bool processed;
+} async_command_t;
+
+/*
+ * Bounded multi-producer/single-consumer command ring.  A slot is free for
+ * ring position pos when seq == pos and holds a committed command when
+ * seq == pos + 1.  Producers claim positions by CAS on enqueue_pos; only the
+ * RT thread advances dequeue_pos.
+ */
+typedef struct {
+    uint32_t seq;
+    async_command_t cmd;
+} async_command_slot_t;
+
+typedef struct {
+    async_command_slot_t slots[MAX_ASYNC_COMMANDS];
+    uint32_t enqueue_pos;   // Next position to claim (producers)
+    uint32_t dequeue_pos;   // Next position to consume (RT thread only)
+    uint32_t drops;         // Enqueues rejected because the ring was full
+    uint32_t high_water;    // Highest fill level seen by the consumer
+} async_command_queue_t;
+
+/* Marks every slot free and empties the ring. */
+static inline void async_cmd_queue_init(async_command_queue_t *q)
+{
+    for (uint32_t i = 0; i < MAX_ASYNC_COMMANDS; i++)
+        __atomic_store_n(&q->slots[i].seq, i, __ATOMIC_RELAXED);
+    __atomic_store_n(&q->dequeue_pos, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&q->enqueue_pos, 0, __ATOMIC_RELEASE);
+}
+
+/*
+ * Claim the next free slot for a producer.  The command is built in place
+ * and published with async_cmd_queue_commit().  Returns NULL (and counts a
+ * drop) when the ring is full.
+ */
+static inline async_command_t *async_cmd_queue_reserve(async_command_queue_t *q, uint32_t *pos_out)
+{
+    uint32_t pos = __atomic_load_n(&q->enqueue_pos, __ATOMIC_RELAXED);
+    for (;;) {
+        async_command_slot_t *slot = &q->slots[pos & ASYNC_COMMAND_MASK];
+        int32_t diff = (int32_t)(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - pos);
+        if (diff == 0) {
+            // On failure the CAS reloads pos and we try that position instead
+            if (__atomic_compare_exchange_n(&q->enqueue_pos, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                *pos_out = pos;
+                return &slot->cmd;
+            }
+        } else if (diff < 0) {
+            __atomic_fetch_add(&q->drops, 1, __ATOMIC_RELAXED);
+            return NULL;
+        } else {
+            pos = __atomic_load_n(&q->enqueue_pos, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+static inline void async_cmd_queue_commit(async_command_queue_t *q, uint32_t pos)
+{
+    __atomic_store_n(&q->slots[pos & ASYNC_COMMAND_MASK].seq, pos + 1, __ATOMIC_RELEASE);
+}
+
+/* Oldest committed command, consumed in place; NULL when the ring is empty. */
+static inline async_command_t *async_cmd_queue_peek(async_command_queue_t *q)
+{
+    uint32_t pos = q->dequeue_pos;
+    async_command_slot_t *slot = &q->slots[pos & ASYNC_COMMAND_MASK];
+    if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != pos + 1)
+        return NULL;
+    return &slot->cmd;
+}
+
+/* Frees the slot returned by async_cmd_queue_peek() (consumer only). */
+static inline void async_cmd_queue_release(async_command_queue_t *q)
+{
+    uint32_t pos = q->dequeue_pos;
+    __atomic_store_n(&q->slots[pos & ASYNC_COMMAND_MASK].seq,
+                     pos + MAX_ASYNC_COMMANDS, __ATOMIC_RELEASE);
+    __atomic_store_n(&q->dequeue_pos, pos + 1, __ATOMIC_RELAXED);
+}
+
+#endif // POKEYSLIBCMDQUEUE_H
@@ -22,8 +22,10 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include "PoKeysLibHal.h"
 #include "PoKeysLibCore.h"
 #include "PoKeysLibCoreSockets.h"
+#include "PoKeysLibAsync.h"
 #include "string.h"
 #include "stdio.h"
+#include <unistd.h>
 //#define PK_COM_DEBUG
 
 /**
@@ -149,6 +151,24 @@ int32_t PK_GetCurrentDeviceConnectionType(sPoKeysDevice* device)
         return device->connectionType;
 }
 
+/**
+ * @brief Allocate a device structure on a cache-line boundary.
+ *
+ * hal_malloc() only guarantees 8-byte alignment, while sPoKeysPEv2 (and so
+ * sPoKeysDevice) is declared cache-line aligned to keep its hot block on
+ * line boundaries.  The extra line is never returned: HAL memory is not
+ * freed.
+ *
+ * @return Aligned, uninitialised device structure or NULL.
+ */
+sPoKeysDevice* PK_DeviceAlloc(void)
+{
+    uint8_t *raw = (uint8_t*)hal_malloc(sizeof(sPoKeysDevice) + PK_CACHELINE - 1);
+    if (raw == NULL)
+        return NULL;
+    return (sPoKeysDevice*)(((uintptr_t)raw + PK_CACHELINE - 1) & ~(uintptr_t)(PK_CACHELINE - 1));
+}
+
 void InitializeNewDevice(sPoKeysDevice* device)
 {
     rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: Initializing new device...\n", __FILE__, __FUNCTION__);
@@ -179,10 +199,14 @@ void InitializeNewDevice(sPoKeysDevice* device)
 
     PK_DeviceDataGet(device);
 
-    device->Pins = (sPoKeysPinData*)hal_malloc(sizeof(sPoKeysPinData) * device->info.iPinCount);
+    // All per-device arrays below come from the locked, prefaulted arena
+    if (PK_ArenaCreate(device) != PK_OK)
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: no device arena, using hal_malloc\n", __FILE__, __FUNCTION__);
+
+    device->Pins = (sPoKeysPinData*)PK_ArenaAlloc(device, sizeof(sPoKeysPinData) * device->info.iPinCount);
 	memset(device->Pins, 0, sizeof(sPoKeysPinData) * device->info.iPinCount);
 
-    device->AnalogInput = (sPoKeysAnalogData*)hal_malloc(sizeof(sPoKeysAnalogData) * 7);
+    device->AnalogInput = (sPoKeysAnalogData*)PK_ArenaAlloc(device, sizeof(sPoKeysAnalogData) * 7);
     memset(device->AnalogInput, 0, sizeof(sPoKeysAnalogData) * 7);
 
 	for (i = 0; i < device->info.iPinCount; i++)
@@ -198,13 +222,13 @@ void InitializeNewDevice(sPoKeysDevice* device)
 
     // Allocate memory for encoders
     rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: Device iEncodersCount: %d\n", __FILE__, __FUNCTION__, device->info.iEncodersCount);
-	device->Encoders = (sPoKeysEncoder*)hal_malloc(sizeof(sPoKeysEncoder) * device->info.iEncodersCount);
+	device->Encoders = (sPoKeysEncoder*)PK_ArenaAlloc(device, sizeof(sPoKeysEncoder) * device->info.iEncodersCount);
 	memset(device->Encoders, 0, sizeof(sPoKeysEncoder) * device->info.iEncodersCount);
 
     rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: Device iEasySensors: %d\n", __FILE__, __FUNCTION__, device->info.iEasySensors);
     if (device->info.iEasySensors)
     {
-        device->EasySensors = (sPoKeysEasySensor*)hal_malloc(sizeof(sPoKeysEasySensor) * device->info.iEasySensors);
+        device->EasySensors = (sPoKeysEasySensor*)PK_ArenaAlloc(device, sizeof(sPoKeysEasySensor) * device->info.iEasySensors);
         memset(device->EasySensors, 0, sizeof(sPoKeysEasySensor) * device->info.iEasySensors);
     } else
     {
@@ -223,7 +247,7 @@ void InitializeNewDevice(sPoKeysDevice* device)
 	if (device->info.iPWMCount > 0)
 	{
         rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: Allocating memory for PWM.max_Voltage...\n", __FILE__, __FUNCTION__);
-        device->PWM.max_Voltage = (hal_float_t*)hal_malloc(sizeof(hal_float_t) * device->info.iPWMCount);
+        device->PWM.max_Voltage = (hal_float_t*)PK_ArenaAlloc(device, sizeof(hal_float_t) * device->info.iPWMCount);
         for (uint32_t i = 0; i < device->info.iPWMCount; i++)
         {
             // check for first pin of PK_DeviceID_PoKeys57CNC
@@ -277,7 +301,7 @@ void InitializeNewDevice(sPoKeysDevice* device)
             device->PWM.PWMduty[i] = 0;
     */
         rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: Allocating memory for PWM.PWManalogOutputs...\n", __FILE__, __FUNCTION__);
-        device->PWM.PWManalogOutputs = (hal_adcout_t*)hal_malloc(sizeof(hal_adcout_t) * device->info.iPWMCount);
+        device->PWM.PWManalogOutputs = (hal_adcout_t*)PK_ArenaAlloc(device, sizeof(hal_adcout_t) * device->info.iPWMCount);
         if (device->PWM.PWMperiod==0000){
             device->PWM.PWMperiod = 500000; // Default PWM period in clock cycles (20 ms at 25 MHz)
         }
@@ -304,7 +328,7 @@ void InitializeNewDevice(sPoKeysDevice* device)
         }
 
         rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: Allocating memory for PWM.PWMenabledChannels...\n", __FILE__, __FUNCTION__);
-		device->PWM.PWMenabledChannels = (unsigned char*)hal_malloc(sizeof(unsigned char) * device->info.iPWMCount);
+		device->PWM.PWMenabledChannels = (unsigned char*)PK_ArenaAlloc(device, sizeof(unsigned char) * device->info.iPWMCount);
 		//memset(device->PWM.PWMenabledChannels, 0, sizeof(unsigned char) * device->info.iPWMCount);
         for (uint32_t i = 0; i < device->info.iPWMCount; i++)
             device->PWM.PWMenabledChannels[i] = 0;
@@ -313,19 +337,19 @@ void InitializeNewDevice(sPoKeysDevice* device)
 	{
 		device->PWM.PWMenabledChannels = NULL;
 	}
-	device->PWM.PWMpinIDs = (unsigned char*)hal_malloc(sizeof(unsigned char) * device->info.iPWMCount);
+	device->PWM.PWMpinIDs = (unsigned char*)PK_ArenaAlloc(device, sizeof(unsigned char) * device->info.iPWMCount);
 	memset(device->PWM.PWMpinIDs, 0, sizeof(unsigned char) * device->info.iPWMCount);
 
 	PK_FillPWMPinNumbers(device);
 
-	device->PoExtBusData = (unsigned char*)hal_malloc(sizeof(unsigned char) * device->info.iPoExtBus);
+	device->PoExtBusData = (unsigned char*)PK_ArenaAlloc(device, sizeof(unsigned char) * device->info.iPoExtBus);
 
-    device->MatrixLED = (sPoKeysMatrixLED*)hal_malloc(sizeof(sPoKeysMatrixLED) * device->info.iMatrixLED);
+    device->MatrixLED = (sPoKeysMatrixLED*)PK_ArenaAlloc(device, sizeof(sPoKeysMatrixLED) * device->info.iMatrixLED);
 	memset(device->MatrixLED, 0, sizeof(sPoKeysMatrixLED) * device->info.iMatrixLED);
 
     memset(&device->PEv2, 0, sizeof(sPoKeysPEv2));
 
-    device-> multiPartBuffer = hal_malloc(512);
+    device-> multiPartBuffer = PK_ArenaAlloc(device, 512);
     if (device->multiPartBuffer <= 0) device->multiPartBuffer = 0;
 
 #ifdef USE_ALIGN_TEST
@@ -489,7 +513,7 @@ sPoKeysDevice* PK_ConnectToDevice(uint32_t deviceIndex)
         {
             if (numDevices == deviceIndex)
             {
-				tmpDevice = (sPoKeysDevice*)hal_malloc(sizeof(sPoKeysDevice));
+				tmpDevice = PK_DeviceAlloc();
 
                 //printf("Connect to this device...");
                 rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: Connect to this device...  (devHandle:%d devHandle2:%d)\n", __FILE__, __FUNCTION__,tmpDevice->devHandle,tmpDevice->devHandle2);
@@ -535,7 +559,7 @@ sPoKeysDevice* PK_ConnectToDevice(uint32_t deviceIndex)
         {
             if (numDevices == deviceIndex)
             {
-                tmpDevice = (sPoKeysDevice*)hal_malloc(sizeof(sPoKeysDevice));
+                tmpDevice = PK_DeviceAlloc();
 
                 //printf("Connect to this device...");
                 rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: (devHandle:%d devHandle2:%d)\n", __FILE__, __FUNCTION__,tmpDevice->devHandle,tmpDevice->devHandle2);
@@ -578,7 +602,7 @@ sPoKeysDevice* PK_ConnectToDevice(uint32_t deviceIndex)
 	//void * devData = ConnectToFastUSBInterface(serialNumber);
 	if (devData != NULL)
 	{
-		tmpDevice = (sPoKeysDevice*)hal_malloc(sizeof(sPoKeysDevice));
+		tmpDevice = PK_DeviceAlloc();
 
 		tmpDevice->devHandle = NULL;
 		tmpDevice->devHandle2 = devData;
@@ -610,7 +634,7 @@ sPoKeysDevice* PK_ConnectToPoKeysDevice_USB(uint32_t serialNumber, uint32_t flag
 	void * devData = ConnectToFastUSBInterface(serialNumber);
 	if (devData != NULL)
 	{
-		tmpDevice = (sPoKeysDevice*)hal_malloc(sizeof(sPoKeysDevice));
+		tmpDevice = PK_DeviceAlloc();
 
 		tmpDevice->devHandle = NULL;
         tmpDevice->devHandle2 = devData;
@@ -648,7 +672,7 @@ sPoKeysDevice* PK_ConnectToPoKeysDevice_USB(uint32_t serialNumber, uint32_t flag
 
                 if (k == 7)
                 {
-                    tmpDevice = (sPoKeysDevice*)hal_malloc(sizeof(sPoKeysDevice));
+                    tmpDevice = PK_DeviceAlloc();
 
                     //printf("Connect to this device...");
                     rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: Connect to this device...(devHandle: %d  devHandle2: %d )\n", __FILE__, __FUNCTION__, tmpDevice->devHandle, tmpDevice->devHandle2);
@@ -678,7 +702,7 @@ sPoKeysDevice* PK_ConnectToPoKeysDevice_USB(uint32_t serialNumber, uint32_t flag
 			else
             {
                 // Old, PoKeys55 device - we must to connect and read the serial number...
-                tmpDevice = (sPoKeysDevice*)hal_malloc(sizeof(sPoKeysDevice));
+                tmpDevice = PK_DeviceAlloc();
                 #ifndef RTAPI
                 tmpDevice->devHandle = (void*)hid_open_path(cur_dev->path);
                 #endif
@@ -856,6 +880,7 @@ void PK_DisconnectDevice(sPoKeysDevice* device)
 #endif
 		}
 
+		PK_AsyncContextRelease(device);
 		CleanDevice(device);
 		//free(device);
     }
@@ -919,6 +944,90 @@ int32_t PK_CustomRequest(sPoKeysDevice* device, unsigned char type, unsigned cha
     return SendRequest(device);
 }
 
+static int32_t pk_send_request_unlocked(sPoKeysDevice* device, uint8_t* request, uint8_t* response);
+
+/*
+ * Per-device transport lock.  SendRequest(), SendRequest_multiPart(),
+ * SendRequest_NoResponse() and PK_SendRequestContext() hold it for the
+ * exchange on the device's socket or handle (and its request ID counter).
+ * It does not cover the staging of device->request before SendRequest()
+ * or the parsing of device->response after it; only callers with their
+ * own buffers are safe from other threads.
+ * Not recursive: code holding it calls the *_unlocked variants.
+ */
+static inline void pk_transport_lock(sPoKeysDevice* device)
+{
+    while (__atomic_exchange_n(&device->transportLock, 1, __ATOMIC_ACQUIRE))
+        usleep(50);
+}
+
+static inline void pk_transport_unlock(sPoKeysDevice* device)
+{
+    __atomic_store_n(&device->transportLock, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Exchange a request held in a caller-owned context.
+ *
+ * Unlike SendRequest(), the request is taken from @p context->request and
+ * the response is returned in @p context->response, so several threads can
+ * talk to the same device at once, each with its own context (typically on
+ * the stack).  UDP network devices go through the async transaction engine,
+ * which keeps every exchange in its own transaction slot.  On USB, FastUSB
+ * and TCP the transport works on the context's buffers directly, under the
+ * same transport lock as SendRequest(); device->request/response are never
+ * touched, so a legacy caller's staged request or pending response survives.
+ *
+ * @param device  Target device structure.
+ * @param context Request context with the request prepared by CreateRequest().
+ * @return PK_OK on success or an error code on failure.
+ */
+int32_t PK_SendRequestContext(sPoKeysDevice* device, sPoKeysRequestContext* context)
+{
+    int32_t result;
+
+    if (device == NULL || context == NULL) return PK_ERR_GENERIC;
+
+    if (device->connectionType == PK_DeviceType_NetworkDevice &&
+        device->connectionParam == PK_ConnectionParam_UDP &&
+        PK_AsyncContextGet(device) != NULL)
+    {
+        uint32_t retries = (device->sendRetries > 255) ? 255 : device->sendRetries;
+        result = PK_SubmitRequestAndWait(device, context->request, context->response,
+                                         PK_EthAttemptTimeoutUs(device), (uint8_t)retries);
+        if (result == PK_OK) context->requestID = context->response[6];
+        return result;
+    }
+
+    pk_transport_lock(device);
+    result = pk_send_request_unlocked(device, context->request, context->response);
+    pk_transport_unlock(device);
+    context->requestID = context->request[6];
+    return result;
+}
+
+/**
+ * @brief Send an arbitrary request using a caller-owned context.
+ *
+ * Thread-safe counterpart of PK_CustomRequest().
+ *
+ * @param device  Target device structure.
+ * @param context Request context; the response is returned in context->response.
+ * @param type    Command ID (PK_CMD_* constant).
+ * @param param1  First command parameter.
+ * @param param2  Second command parameter.
+ * @param param3  Third command parameter.
+ * @param param4  Fourth command parameter.
+ * @return Result of PK_SendRequestContext().
+ */
+int32_t PK_CustomRequestContext(sPoKeysDevice* device, sPoKeysRequestContext* context, unsigned char type, unsigned char param1, unsigned char param2, unsigned char param3, unsigned char param4)
+{
+    if (context == NULL) return PK_ERR_GENERIC;
+
+    CreateRequest(context->request, type, param1, param2, param3, param4);
+    return PK_SendRequestContext(device, context);
+}
+
 uint8_t getChecksum(uint8_t * data)
 {
     uint8_t temp = 0;
@@ -950,9 +1059,8 @@ int32_t LastWaitCount = 0;
  * @param device Target device instance.
  * @return PK_OK on success or an error code on failure.
  */
-int32_t SendRequest_multiPart(sPoKeysDevice* device)
+static int32_t pk_send_request_multipart_unlocked(sPoKeysDevice* device)
 {
-    if (device == NULL) return PK_ERR_GENERIC;
 	if (device->connectionType == PK_DeviceType_NetworkDevice)
 	{
         return SendEthRequestBig(device);
@@ -970,6 +1078,15 @@ int32_t SendRequest_multiPart(sPoKeysDevice* device)
 #endif
 }
 
+int32_t SendRequest_multiPart(sPoKeysDevice* device)
+{
+    if (device == NULL) return PK_ERR_GENERIC;
+    pk_transport_lock(device);
+    int32_t result = pk_send_request_multipart_unlocked(device);
+    pk_transport_unlock(device);
+    return result;
+}
+
 
 //#define PK_COM_DEBUG
 /**
@@ -982,10 +1099,24 @@ int32_t SendRequest_multiPart(sPoKeysDevice* device)
  * function waits for a reply with header 0xAA that carries the same
  * request ID and a valid checksum.
  *
+ * Holds the device's transport lock for the exchange itself.  Staging
+ * device->request and reading device->response happen outside it, so
+ * threads that share a device should use PK_SendRequestContext() (own
+ * buffers) instead.
+ *
  * @param device Device that holds the prepared request buffer.
  * @return PK_OK on success or PK_ERR_TRANSFER on failure.
  */
 int32_t SendRequest(sPoKeysDevice* device)
+{
+    if (device == NULL) return PK_ERR_GENERIC;
+    pk_transport_lock(device);
+    int32_t result = pk_send_request_unlocked(device, device->request, device->response);
+    pk_transport_unlock(device);
+    return result;
+}
+
+static int32_t pk_send_request_unlocked(sPoKeysDevice* device, uint8_t* request, uint8_t* response)
 {
     // Initialize variables
     uint32_t waits = 0;
@@ -1004,11 +1135,11 @@ int32_t SendRequest(sPoKeysDevice* device)
     if (device == NULL) return PK_ERR_GENERIC;
 	if (device->connectionType == PK_DeviceType_NetworkDevice)
 	{
-		return SendEthRequest(device);
+		return SendEthRequestBuffers(device, request, response);
 	}
 #ifdef POKEYSLIB_USE_LIBUSB
 		if (device->connectionType == PK_DeviceType_FastUSBDevice)
-			return SendRequestFastUSB(device);
+			return SendRequestFastUSBBuffers(device, request, response);
 #endif
     devHandle = (hid_device*)device->devHandle;
 
@@ -1018,11 +1149,11 @@ int32_t SendRequest(sPoKeysDevice* device)
     // Request sending loop
     while (retries++ < 2)
     {
-        device->request[0] = 0xBB;
-        device->request[6] = ++device->requestID;
-        device->request[7] = getChecksum(device->request);
+        request[0] = 0xBB;
+        request[6] = ++device->requestID;
+        request[7] = getChecksum(request);
 
-        memcpy(bufferOut + 1, device->request, 64);
+        memcpy(bufferOut + 1, request, 64);
 
         #ifdef PK_COM_DEBUG
                 printf("\n * SEND ");
@@ -1049,7 +1180,7 @@ int32_t SendRequest(sPoKeysDevice* device)
         while (waits++ < 50)
         {
             #ifndef RTAPI
-            result = hid_read(devHandle, device->response, 65);
+            result = hid_read(devHandle, response, 65);
             #endif
             // Error is not an option
             if (result < 0)
@@ -1063,16 +1194,16 @@ int32_t SendRequest(sPoKeysDevice* device)
         printf("\n * RECV ");
         for (i = 0; i < 10; i++)
         {
-                printf("%X ", device->response[i]);
+                printf("%X ", response[i]);
         }
 
-        printf(" (request ID: %X ?= %X", device->response[6], device->requestID);
+        printf(" (request ID: %X ?= %X", response[6], device->requestID);
 #endif
 
                 // Check the header and the request ID
-                if (device->response[0] == 0xAA && device->response[6] == device->requestID)
+                if (response[0] == 0xAA && response[6] == device->requestID)
                 {
-                    if (device->response[7] == getChecksum(device->response))
+                    if (response[7] == getChecksum(response))
                     {
                         LastRetryCount = retries;
                         LastWaitCount = waits;
@@ -1099,7 +1230,18 @@ int32_t SendRequest(sPoKeysDevice* device)
  * @return PK_OK on successful USB transfer or PK_ERR_TRANSFER when the
  *         packet could not be sent.
  */
+static int32_t pk_send_request_noresponse_unlocked(sPoKeysDevice* device);
+
 int32_t SendRequest_NoResponse(sPoKeysDevice* device)
+{
+    if (device == NULL) return PK_ERR_GENERIC;
+    pk_transport_lock(device);
+    int32_t result = pk_send_request_noresponse_unlocked(device);
+    pk_transport_unlock(device);
+    return result;
+}
+
+static int32_t pk_send_request_noresponse_unlocked(sPoKeysDevice* device)
 {
     // Initialize variables
     uint32_t waits = 0;
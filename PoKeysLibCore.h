@@ -58,12 +58,14 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 		void * ConnectToFastUSBInterface(int32_t serial);
 		void DisconnectFromFastUSBInterface(void * device);
 		int32_t SendRequestFastUSB(sPoKeysDevice* device);
+		int32_t SendRequestFastUSBBuffers(sPoKeysDevice* device, uint8_t* request, uint8_t* response);
 		int32_t SendRequestFastUSB_NoResponse(sPoKeysDevice* device);
 		int32_t SendRequestFastUSB_multiPart(sPoKeysDevice* device);
 	#else	
 		#define ConnectToFastUSBInterface(device) NULL;
 		#define DisconnectFromFastUSBInterface(device) ;
 		#define SendRequestFastUSB(device) ;
+		#define SendRequestFastUSBBuffers(device, request, response) ;
 		#define SendRequestFastUSB_multiPart(device) ;
 	#endif
 #endif
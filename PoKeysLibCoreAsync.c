@@ -290,7 +290,7 @@ sPoKeysDevice* PK_ConnectToDeviceAsync(uint32_t deviceIndex)
             (stage == CONN_ENUM_1002 && cur_dev->interface_number == -1)) {
             
             if (numDevices == deviceIndex) {
-                tmpDevice = hal_malloc(sizeof(sPoKeysDevice));
+                tmpDevice = PK_DeviceAlloc();
                 if (!tmpDevice) break;
 
                 tmpDevice->devHandle = (void*)hid_open_path(cur_dev->path);
@@ -363,7 +363,7 @@ sPoKeysDevice* PK_ConnectToPoKeysDevice_USB_Async(uint32_t serialNumber, uint32_
                     (deviceTypeRequested == 4 && cur_dev->serial_number[0] != '4')) k = 0;
 
                 if (k == 7) {
-                    tmpDevice = hal_malloc(sizeof(sPoKeysDevice));
+                    tmpDevice = PK_DeviceAlloc();
                     tmpDevice->devHandle = (void*)hid_open_path(cur_dev->path);
                     tmpDevice->devHandle2 = 0;
                     tmpDevice->connectionType = PK_DeviceType_USBDevice;
@@ -380,7 +380,7 @@ sPoKeysDevice* PK_ConnectToPoKeysDevice_USB_Async(uint32_t serialNumber, uint32_
                     return tmpDevice;
                 }
             } else {
-                tmpDevice = hal_malloc(sizeof(sPoKeysDevice));
+                tmpDevice = PK_DeviceAlloc();
                 tmpDevice->devHandle = (void*)hid_open_path(cur_dev->path);
                 tmpDevice->devHandle2 = 0;
                 tmpDevice->connectionType = PK_DeviceType_USBDevice;
@@ -461,7 +461,7 @@ sPoKeysDevice *PK_ConnectToDeviceWSerial_Async(uint32_t serial, uint32_t timeout
     switch (state)
     {
         case IDLE:
-            dev = hal_malloc(sizeof(sPoKeysDevice));
+            dev = PK_DeviceAlloc();
             // Start discovery, initialize fields
             state = DISCOVERY_START;
             start_time_us = get_current_time_us();
@@ -783,7 +783,7 @@ sPoKeysDevice* PK_ConnectToDevice(uint32_t deviceIndex)
         {
             if (numDevices == deviceIndex)
             {
-                tmpDevice = (sPoKeysDevice*)hal_malloc(sizeof(sPoKeysDevice));
+                tmpDevice = PK_DeviceAlloc();
 
                 tmpDevice->devHandle = (void*)hid_open_path(cur_dev->path);
                 tmpDevice->devHandle2 = NULL;
@@ -817,7 +817,7 @@ sPoKeysDevice* PK_ConnectToDevice(uint32_t deviceIndex)
         {
             if (numDevices == deviceIndex)
             {
-                tmpDevice = (sPoKeysDevice*)hal_malloc(sizeof(sPoKeysDevice));
+                tmpDevice = PK_DeviceAlloc();
 
                 tmpDevice->devHandle = (void*)hid_open_path(cur_dev->path);
                 tmpDevice->devHandle2 = NULL;
@@ -846,7 +846,7 @@ sPoKeysDevice* PK_ConnectToDevice(uint32_t deviceIndex)
 
     if (devData != NULL)
     {
-        tmpDevice = (sPoKeysDevice*)hal_malloc(sizeof(sPoKeysDevice));
+        tmpDevice = PK_DeviceAlloc();
 
         tmpDevice->devHandle = NULL;
         tmpDevice->devHandle2 = devData;
@@ -874,7 +874,7 @@ sPoKeysDevice* PK_ConnectToPoKeysDevice_USB(uint32_t serialNumber, uint32_t flag
     void * devData = ConnectToFastUSBInterface(serialNumber);
     if (devData != NULL)
     {
-        tmpDevice = (sPoKeysDevice*)hal_malloc(sizeof(sPoKeysDevice));
+        tmpDevice = PK_DeviceAlloc();
 
         tmpDevice->devHandle = NULL;
         tmpDevice->devHandle2 = devData;
@@ -908,7 +908,7 @@ sPoKeysDevice* PK_ConnectToPoKeysDevice_USB(uint32_t serialNumber, uint32_t flag
 
                 if (k == 7)
                 {
-                    tmpDevice = (sPoKeysDevice*)hal_malloc(sizeof(sPoKeysDevice));
+                    tmpDevice = PK_DeviceAlloc();
 
                     tmpDevice->devHandle = (void*)hid_open_path(cur_dev->path);
                     tmpDevice->devHandle2 = 0;
@@ -929,7 +929,7 @@ sPoKeysDevice* PK_ConnectToPoKeysDevice_USB(uint32_t serialNumber, uint32_t flag
             }
             else
             {
-                tmpDevice = (sPoKeysDevice*)hal_malloc(sizeof(sPoKeysDevice));
+                tmpDevice = PK_DeviceAlloc();
                 tmpDevice->devHandle = (void*)hid_open_path(cur_dev->path);
                 tmpDevice->devHandle2 = 0;
 
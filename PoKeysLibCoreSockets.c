@@ -35,11 +35,16 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
     #include <netinet/in.h>
     #include <net/if.h>
     #include <sys/ioctl.h>
+    #include <poll.h>
+    #include <time.h>
+    #include <errno.h>
 #endif
 #include <stdio.h>
 #include <string.h>
 #include <sys/stat.h>
 #include "PoKeysLibHal.h"
+#include "PoKeysLibAsync.h"
+#include "PoKeysLibCoreSocketsAsync.h"
 
 /**
  * @file PoKeysLibCoreSockets.c
@@ -486,7 +491,7 @@ sPoKeysDevice* PK_ConnectToNetworkDevice(sPoKeysNetworkDeviceSummary * device)
 
     if (device == NULL) return NULL;
 
-    tmpDevice = (sPoKeysDevice*)hal_malloc(sizeof(sPoKeysDevice));
+    tmpDevice = PK_DeviceAlloc();
     tmpDevice->devHandle2 = hal_malloc(sizeof(struct sockaddr_in));
     memset(tmpDevice->devHandle2, 0, sizeof(struct sockaddr_in));  // ← CRUCIAL!
     tmpDevice->connectionType = PK_DeviceType_NetworkDevice; // Network device
@@ -555,7 +560,6 @@ sPoKeysDevice* PK_ConnectToNetworkDevice(sPoKeysNetworkDeviceSummary * device)
 #else
 	result = 0;
     if (tmpDevice->connectionParam != PK_ConnectionParam_UDP){
-        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: devHandle=%d  devHandle2=%d\n", __FILE__, __FUNCTION__,*(int *)tmpDevice->devHandle,*(int *)tmpDevice->devHandle2);
         result = connect(*(int *)tmpDevice->devHandle, (struct sockaddr *)tmpDevice->devHandle2, sizeof(struct sockaddr_in));
     }
 	else{
@@ -618,54 +622,191 @@ void PK_DisconnectNetworkDevice(sPoKeysDevice* device)
 }
 
 
+/*
+ * Wait per send attempt of a blocking transfer, the same on every path:
+ * socketTimeout ms for each of the (readRetries + 1) reads.
+ */
+uint32_t PK_EthAttemptTimeoutUs(const sPoKeysDevice* device)
+{
+    uint64_t us = 1000ULL * device->socketTimeout * ((uint64_t)device->readRetries + 1);
+    return (us > UINT32_MAX) ? UINT32_MAX : (uint32_t)us;
+}
+
+#ifndef WIN32
+/*
+ * Linux wait path of the blocking transfers (TCP, multipart).  The socket is
+ * polled against one absolute CLOCK_MONOTONIC deadline per send attempt, so
+ * signals and unrelated packets neither extend nor restart the wait.
+ */
+static uint64_t PK_EthMonotonicUs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000;
+}
+
+// Request ID of a blocking transfer.  Without an async context (table
+// full) no engine shares the ID space, so the device counter is used;
+// UDP and TCP then both take the direct path.
+static uint8_t PK_EthNextRequestID(sPoKeysDevice* device)
+{
+    uint8_t id = next_request_id(device);
+    if (id == 0) {
+        id = (uint8_t)(device->requestID + 1);
+        if (id == 0) id = 1;
+    }
+    return id;
+}
+
+// Discard anything still queued from earlier requests that timed out.
+// Only called when no async engine reads the socket (see PK_AsyncOwnsSocket)
+static void PK_EthDrainStale(int fd)
+{
+    uint8_t tmp[512];
+    while (recv(fd, tmp, sizeof(tmp), MSG_DONTWAIT) > 0) { }
+}
+
+/*
+ * PK_EthWaitResponse - wait until the response carrying expectedID arrives.
+ * Responses with another ID are dropped and the wait continues without
+ * resending; callers only get here while the async engine does not own the
+ * socket, so those are stale replies to our own earlier attempts.  Returns PK_OK, PK_ERR_TIMEOUT at the deadline or
+ * PK_ERR_TRANSFER on socket errors.
+ */
+static int32_t PK_EthWaitResponse(sPoKeysDevice* device, uint8_t* response, uint8_t expectedID, uint64_t deadline)
+{
+    int fd = *(int*)device->devHandle;
+    int isStream = (device->connectionParam != PK_ConnectionParam_UDP);
+    uint32_t got = 0;
+    struct pollfd pfd;
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+
+    while (1)
+    {
+        uint64_t now = PK_EthMonotonicUs();
+        if (now >= deadline) return PK_ERR_TIMEOUT;
+
+        int result = poll(&pfd, 1, (int)((deadline - now + 999) / 1000));
+        if (result < 0)
+        {
+            if (errno == EINTR) continue;
+            return PK_ERR_TRANSFER;
+        }
+        if (result == 0) return PK_ERR_TIMEOUT;
+
+        // Consume everything queued before polling again
+        while (1)
+        {
+            ssize_t n = recv(fd, (char *)response + got, 64 - got, MSG_DONTWAIT);
+            if (n == 0) return PK_ERR_TRANSFER; // Connection closed
+            if (n < 0)
+            {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+                if (errno == EINTR) continue;
+                return PK_ERR_TRANSFER;
+            }
+
+            // TCP may split a response; a short UDP datagram is simply dropped
+            if (isStream)
+            {
+                got += (uint32_t)n;
+                if (got < 64) continue;
+                got = 0;
+            }
+            else if (n != 64)
+            {
+                continue;
+            }
+
+            if (response[0] == 0xAA && response[6] == expectedID &&
+                response[7] == getChecksum(response))
+                return PK_OK;
+
+            debug_printf("!! Wrong response received!");
+        }
+    }
+}
+#endif
+
 /**
  * @brief Sends a single request packet and waits for its 64 byte response.
  *
- * The packet contained in @c device->request is transmitted using either UDP or
- * TCP depending on the connection parameters. The function blocks using
- * select()/recv() until a valid response is received or retries are exhausted.
+ * The packet in @p request is transmitted using either UDP or TCP depending
+ * on the connection parameters and the reply is written to @p response;
+ * device->request/response are not touched, so callers with their own
+ * buffers (PK_SendRequestContext) never disturb a legacy caller's.  On Linux, UDP requests - and
+ * TCP requests while the RT engine is receiving on the socket - are
+ * submitted through the async transaction engine (PK_SubmitRequestAndWait) so
+ * blocking calls share the request ID space and receive path with
+ * PK_ReceiveAndDispatch and never consume the engine's responses.  Otherwise
+ * the call blocks in poll() (select() on Windows) until a valid response is
+ * received or retries are exhausted.
  *
- * @param device Pointer to an initialized network ::sPoKeysDevice.
+ * @param device   Pointer to an initialized network ::sPoKeysDevice.
+ * @param request  64-byte request; header, request ID and checksum are filled in.
+ * @param response 64-byte buffer receiving the reply.
  *
  * @return PK_OK on success or PK_ERR_TRANSFER on communication failure.
  */
-int32_t SendEthRequest(sPoKeysDevice* device)
+int32_t SendEthRequestBuffers(sPoKeysDevice* device, uint8_t* request, uint8_t* response)
 {
+#ifdef WIN32
     uint32_t retries1 = 0;
+#endif
     uint32_t retries2 = 0;
     int result;
 
+#ifdef WIN32
     fd_set fds;
     struct timeval stimeout;
+#endif
 
     if (device == NULL) return PK_ERR_GENERIC;
     if (device->connectionType != PK_DeviceType_NetworkDevice) return PK_ERR_GENERIC;
     if (device->devHandle == NULL) return PK_ERR_GENERIC;
 
+#ifndef WIN32
+    // Without an async context (table full) the direct path below serves UDP too
+    if (PK_AsyncUseEngine(device))
+    {
+        uint32_t retries = (device->sendRetries > 255) ? 255 : device->sendRetries;
+        return PK_SubmitRequestAndWait(device, request, response,
+                                       PK_EthAttemptTimeoutUs(device), (uint8_t)retries);
+    }
+#endif
+
     while (1)
     {
         // Form the request packet
+#ifdef WIN32
         device->requestID++;
+#else
+        device->requestID = PK_EthNextRequestID(device);
+#endif
 
-        device->request[0] = 0xBB;
-        device->request[6] = device->requestID;
-        device->request[7] = getChecksum(device->request);
+        request[0] = 0xBB;
+        request[6] = device->requestID;
+        request[7] = getChecksum(request);
 
         //memcpy(requestBuffer, device->request, 64);
 
+#ifndef WIN32
+        PK_EthDrainStale(*(int*)device->devHandle);
+#endif
+
         debug_printf("\nSending...");
         // Send the data
 
         if (device->connectionParam == PK_ConnectionParam_UDP)
         {
 #ifdef WIN32
-            if (sendto((SOCKET)device->devHandle, (char *)device->request, 64, 0, (SOCKADDR *)device->devHandle2, sizeof(struct sockaddr_in)) == -1)
+            if (sendto((SOCKET)device->devHandle, (char *)request, 64, 0, (SOCKADDR *)device->devHandle2, sizeof(struct sockaddr_in)) == -1)
 #else
-            rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: devHandle=%d\n", __FILE__, __FUNCTION__,device->devHandle);
-            rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: devHandle2=%d\n", __FILE__, __FUNCTION__,device->devHandle2);
            // struct sockaddr_in *a = (struct sockaddr_in *)dev->devHandle2;
            // rtapi_print_msg(RTAPI_MSG_ERR, ""PoKeys: %s:%s: → sendto check: sin_family=%d, ip=%08x, port=%d\n", __FILE__, __FUNCTION__, a->sin_family, ntohl(a->sin_addr.s_addr), ntohs(a->sin_port));
-            if (sendto(*(int*)device->devHandle, (char *)device->request, 64, 0, (SOCKADDR *)device->devHandle2, sizeof(struct sockaddr_in)) == -1)
+            if (sendto(*(int*)device->devHandle, (char *)request, 64, 0, (SOCKADDR *)device->devHandle2, sizeof(struct sockaddr_in)) == -1)
 #endif
             {
                 debug_printf("Error sending UDP report\nAborting...\n");
@@ -674,9 +815,9 @@ int32_t SendEthRequest(sPoKeysDevice* device)
         } else
         {
 #ifdef WIN32
-            if (send((SOCKET)device->devHandle, (char *)device->request, 64, 0) != 64)
+            if (send((SOCKET)device->devHandle, (char *)request, 64, 0) != 64)
 #else
-            if (send(*(int*)device->devHandle, (char *)device->request, 64, 0) != 64)
+            if (send(*(int*)device->devHandle, (char *)request, 64, 0) != 64)
 #endif
             {
                 debug_printf("Error sending TCP report\nAborting...\n");
@@ -684,10 +825,10 @@ int32_t SendEthRequest(sPoKeysDevice* device)
             }
         }
 
+#ifdef WIN32
 		// Wait for the response
 		while(1)
 		{           
-#ifdef WIN32
             FD_ZERO(&fds);
             FD_SET((SOCKET)device->devHandle, &fds);
 
@@ -705,37 +846,16 @@ int32_t SendEthRequest(sPoKeysDevice* device)
             }
 
             //device->reserved64 = GetTickCount64();
-            result = recv((SOCKET)device->devHandle, (char *)device->response, 64, 0);
+            result = recv((SOCKET)device->devHandle, (char *)response, 64, 0);
             //device->reserved64 = GetTickCount64() - device->reserved64;
             //printf("Time: %u\n", (uint32_t)device->reserved64);
-#else
-            FD_ZERO(&fds);
-            FD_SET(*(int*)device->devHandle, &fds);
-
-            stimeout.tv_sec = 0;
-            stimeout.tv_usec = 1000 * device->socketTimeout;
-
-            result = select(*(int*)device->devHandle + 1, &fds, NULL, NULL, &stimeout);
-
-            if (result == 0 || result == -1)
-            {
-                // Timeout...
-                debug_printf("Timeout!");
-                if (++retries1 > 10) break;
-                continue;
-            }
-
-            //if (FD_ISSET(*(int*)device->devHandle, &fds) == 0)
-
-            result = recv(*(int*)device->devHandle, (char *)device->response, 64, 0);
-#endif
 
 			// 64 bytes received?
 			if (result == 64)
 			{
-				if (device->response[0] == 0xAA && device->response[6] == device->requestID)
+				if (response[0] == 0xAA && response[6] == device->requestID)
 				{
-					if (device->response[7] == getChecksum(device->response))
+					if (response[7] == getChecksum(response))
 					{
 						debug_printf(" Received!");
 						return PK_OK;
@@ -752,15 +872,18 @@ int32_t SendEthRequest(sPoKeysDevice* device)
 			else if (result == 0)
 				debug_printf("Connection closed\n");
 			else
-#ifdef WIN32
                 debug_printf("recv failed: %d\n", WSAGetLastError());
-#else
-                debug_printf("recv failed\n");
-#endif
 
             
             if (++retries1 > device->readRetries) break;
 		}
+#else
+        // Wait for the response, ignoring replies to other requests
+        result = PK_EthWaitResponse(device, response, device->requestID,
+                                    PK_EthMonotonicUs() + PK_EthAttemptTimeoutUs(device));
+        if (result == PK_OK) return PK_OK;
+        if (result != PK_ERR_TIMEOUT) return PK_ERR_TRANSFER;
+#endif
 
         if (retries2++ > device->sendRetries) break;
     }
@@ -770,6 +893,13 @@ int32_t SendEthRequest(sPoKeysDevice* device)
 
 }
 
+/** SendEthRequestBuffers() on device->request and device->response. */
+int32_t SendEthRequest(sPoKeysDevice* device)
+{
+    if (device == NULL) return PK_ERR_GENERIC;
+    return SendEthRequestBuffers(device, device->request, device->response);
+}
+
 /**
  * @brief Sends a request packet without waiting for a reply.
  *
@@ -796,7 +926,11 @@ int32_t SendEthRequest_NoResponse(sPoKeysDevice* device)
     while (1)
     {
         // Form the request packet
+#ifdef WIN32
         device->requestID++;
+#else
+        device->requestID = PK_EthNextRequestID(device);
+#endif
 
         device->request[0] = 0xBB;
         device->request[6] = device->requestID;
@@ -853,13 +987,17 @@ int32_t SendEthRequest_NoResponse(sPoKeysDevice* device)
  */
 int32_t SendEthRequestBig(sPoKeysDevice* device)
 {
+#ifdef WIN32
     uint32_t retries1 = 0;
+#endif
     uint32_t retries2 = 0;
     int result;
 	uint32_t i;
 
+#ifdef WIN32
     fd_set fds;
     struct timeval stimeout;
+#endif
 
     uint8_t * requestBuffer;
     uint8_t * requestBufferPtr = 0;
@@ -868,6 +1006,17 @@ int32_t SendEthRequestBig(sPoKeysDevice* device)
     if (device->connectionType != PK_DeviceType_NetworkDevice) return PK_ERR_GENERIC;
     if (device->devHandle == NULL) return PK_ERR_GENERIC;
 
+#ifndef WIN32
+    // Same routing as SendEthRequest(): never read a socket the engine reads
+    if (PK_AsyncUseEngine(device))
+    {
+        uint32_t retries = (device->sendRetries > 255) ? 255 : device->sendRetries;
+        return PK_SubmitMultipartRequestAndWait(device, device->request, device->multiPartData,
+                                                device->response, PK_EthAttemptTimeoutUs(device),
+                                                (uint8_t)retries);
+    }
+#endif
+
     if (device->multiPartBuffer == 0) return PK_ERR_GENERIC;
     requestBuffer = device->multiPartBuffer;
 
@@ -888,12 +1037,20 @@ int32_t SendEthRequestBig(sPoKeysDevice* device)
             else if (i == 7)
                 requestBufferPtr[2] |= (1<<4);
 
+#ifdef WIN32
             requestBufferPtr[6] = ++device->requestID;
+#else
+            requestBufferPtr[6] = device->requestID = PK_EthNextRequestID(device);
+#endif
             requestBufferPtr[7] = getChecksum(requestBufferPtr);
 
             memcpy(requestBufferPtr + 8, device->multiPartData + i*56, 56);
         }
 
+#ifndef WIN32
+        PK_EthDrainStale(*(int*)device->devHandle);
+#endif
+
         debug_printf("\nSending...");
         // Send the data
 
@@ -923,10 +1080,10 @@ int32_t SendEthRequestBig(sPoKeysDevice* device)
             }
         }
 
+#ifdef WIN32
         // Wait for the response
         while(1)
         {
-#ifdef WIN32
             FD_ZERO(&fds);
             FD_SET((SOCKET)device->devHandle, &fds);
 
@@ -944,25 +1101,6 @@ int32_t SendEthRequestBig(sPoKeysDevice* device)
             }
 
             result = recv((SOCKET)device->devHandle, (char *)device->response, 64, 0);
-#else
-            FD_ZERO(&fds);
-            FD_SET(*(int*)device->devHandle, &fds);
-
-            stimeout.tv_sec = 0;
-            stimeout.tv_usec = 1000 * device->socketTimeout;
-
-            result = select(*(int*)device->devHandle + 1, &fds, NULL, NULL, &stimeout);
-
-            if (result == 0 || result == -1)
-            {
-                // Timeout...
-                debug_printf("Timeout!");
-                if (++retries1 > 10) break;
-                continue;
-            }
-
-            result = recv(*(int*)device->devHandle, (char *)device->response, 64, 0);
-#endif
 
             // 64 bytes received?
             if (result == 64)
@@ -986,15 +1124,18 @@ int32_t SendEthRequestBig(sPoKeysDevice* device)
             else if (result == 0)
                 debug_printf("Connection closed\n");
             else
-#ifdef WIN32
                 debug_printf("recv failed: %d\n", WSAGetLastError());
-#else
-                debug_printf("recv failed\n");
-#endif
 
 
             if (++retries1 > device->readRetries) break;
         }
+#else
+        // Wait for the response, ignoring replies to other requests
+        result = PK_EthWaitResponse(device, device->response, device->requestID,
+                                    PK_EthMonotonicUs() + PK_EthAttemptTimeoutUs(device));
+        if (result == PK_OK) return PK_OK;
+        if (result != PK_ERR_TIMEOUT) return PK_ERR_TRANSFER;
+#endif
 
         if (retries2++ > device->sendRetries) break;
     }
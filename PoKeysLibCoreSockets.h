@@ -25,6 +25,8 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
     uint32_t* GetBroadcastAddresses(void);
     int32_t SendEthRequest(sPoKeysDevice* device);
+    int32_t SendEthRequestBuffers(sPoKeysDevice* device, uint8_t* request, uint8_t* response);
     int32_t SendEthRequest_NoResponse(sPoKeysDevice* device);
     int32_t SendEthRequestBig(sPoKeysDevice* device);
+    uint32_t PK_EthAttemptTimeoutUs(const sPoKeysDevice* device);
 #endif
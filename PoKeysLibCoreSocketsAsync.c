@@ -1,5 +1,6 @@
 #include "PoKeysLibHal.h"
 #include "PoKeysLibCoreSocketsAsync.h"
+#include "PoKeysLibAsync.h"
 #include <ifaddrs.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -231,7 +232,7 @@ int PK_SearchNetworkDevicesAsync_Process(void)
      if (device == NULL)
          return NULL;
  
-     sPoKeysDevice* tmpDevice = (sPoKeysDevice*)hal_malloc(sizeof(sPoKeysDevice));
+     sPoKeysDevice* tmpDevice = PK_DeviceAlloc();
      if (!tmpDevice)
          return NULL;
  
@@ -466,6 +467,8 @@ int PK_RecvEthResponseAsync(sPoKeysDevice* device)
  * - No retries or blocking waits are performed inside this function.
  * - Only works with UDP connections (TCP not supported for multi-part transfers).
  * - Make sure `device->multiPartData` is filled with 448 bytes of payload data before calling.
+ * - The response is not tracked by the transaction engine; RT code should use
+ *   CreateRequestAsyncMultipart() instead so PK_ReceiveAndDispatch() routes it.
  *
  * @see PK_RecvEthBigResponseAsync()
  */
@@ -485,7 +488,8 @@ int PK_SendEthRequestBigAsync(sPoKeysDevice* device)
         if (i == 0) p[2] |= (1 << 3); // First
         if (i == 7) p[2] |= (1 << 4); // Last
 
-        p[6] = ++device->requestID;
+        p[6] = device->requestID = next_request_id(device);
+        if (p[6] == 0) return PK_ERR_GENERIC; // No async context
         p[7] = getChecksum(p);
 
         memcpy(p + 8, device->multiPartData + (i * 56), 56);
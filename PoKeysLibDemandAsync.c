@@ -0,0 +1,247 @@
+#include "PoKeysLibHal.h"
+#include "PoKeysLibAsync.h"
+#include "hal_priv.h"
+#include <stddef.h>
+#include <string.h>
+
+/*
+ * Demand-driven polling.
+ *
+ * Every periodic task costs a request/response pair, whether or not anything
+ * in the HAL configuration reads its pins.  PK_DemandScanAsync() walks the
+ * pins owned by the component, records which pin groups are linked to a
+ * signal and switches the scheduler tasks accordingly.  It runs as a
+ * periodic task so links made after hal_ready() (the usual case: halfiles
+ * are loaded after loadrt) and later re-links are picked up.
+ *
+ * The scheduler may run from the servo thread, so one call walks at most
+ * PK_DEMAND_SCAN_BATCH pins and resumes from a cursor on the next call; the
+ * result is applied once a pass over all pins completed.  HAL keeps the pin
+ * list sorted by name, so the pins under our prefix form one run that is
+ * followed through next_ptr.  Our own pins are never freed while the
+ * component is loaded, which keeps the cursor valid between calls.  The HAL
+ * mutex is only tried - a busy mutex (halcmd in progress) postpones the
+ * batch to the next period instead of blocking the servo thread.
+ *
+ * Output tasks are change-driven (only differences against the output
+ * shadow are sent), so they stay enabled whether or not their pins are
+ * linked - an output set with setp on an unlinked pin must still reach the
+ * device.  Only input/poll tasks are gated on links.
+ */
+
+#define PK_DEMAND_NO_FEATURE ((size_t)-1)
+#define PK_DEMAND_SCAN_BATCH 64                  // Pins walked per call
+
+typedef struct {
+    const char *task;                            // Scheduler task name
+    uint32_t    classes;                         // Any of these linked -> wanted
+    size_t      feature;                         // offsetof(sPoKeysDevice_Info, ...) or none
+    uint8_t     output;                          // Sends outputs: not gated on links
+} sPoKeysDemandTask;
+
+static const sPoKeysDemandTask demand_tasks[] = {
+    { "rtc",              1u << PK_DEMAND_RTC,    PK_DEMAND_NO_FEATURE, 0 },
+    { "encoders",         1u << PK_DEMAND_ENCODER, offsetof(sPoKeysDevice_Info, iBasicEncoderCount), 0 },
+    { "digio_get",        1u << PK_DEMAND_DIGIN,  offsetof(sPoKeysDevice_Info, iPinCount), 0 },
+    { "digio_setget",     (1u << PK_DEMAND_DIGIN) | (1u << PK_DEMAND_DIGOUT),
+                                                  offsetof(sPoKeysDevice_Info, iPinCount), 1 },
+    { "digio_set",        1u << PK_DEMAND_DIGOUT, offsetof(sPoKeysDevice_Info, iPinCount), 1 },
+    { "pwm",              1u << PK_DEMAND_ADCOUT, offsetof(sPoKeysDevice_Info, iPWMCount), 1 },
+    { "aio",              1u << PK_DEMAND_ADCIN,  offsetof(sPoKeysDevice_Info, iAnalogInputs), 0 },
+    { "ponet_status",     1u << PK_DEMAND_PONET,  offsetof(sPoKeysDevice_Info, iPoNET), 0 },
+    { "ponet_mod_status", 1u << PK_DEMAND_PONET,  offsetof(sPoKeysDevice_Info, iPoNET), 0 },
+    { "ponet_mod_set",    1u << PK_DEMAND_PONET,  offsetof(sPoKeysDevice_Info, iPoNET), 1 },
+    { "pev2_status",      1u << PK_DEMAND_PEV2,   offsetof(sPoKeysDevice_Info, iPulseEnginev2), 0 },
+    { "pev2_movepv",      1u << PK_DEMAND_PEV2,   offsetof(sPoKeysDevice_Info, iPulseEnginev2), 0 },
+    { "pev2_extout",      1u << PK_DEMAND_PEV2,   offsetof(sPoKeysDevice_Info, iPulseEnginev2), 1 },
+};
+#define PK_DEMAND_TASKS (sizeof(demand_tasks) / sizeof(demand_tasks[0]))
+
+static const char *const demand_class_names[PK_DEMAND_CLASSES] = {
+    "digin.", "digout.", "encoder.", "adcin.", "adcout.", "ponet.", "PEv2.", "rtc."
+};
+
+static sPoKeysDemand demands[PK_DEMAND_MAX];
+static int demand_count = 0;
+
+sPoKeysDemand *PK_DemandGet(const sPoKeysDevice *dev)
+{
+    for (int d = 0; d < demand_count; d++) {
+        if (demands[d].dev == dev)
+            return &demands[d];
+    }
+    return NULL;
+}
+
+static void PK_DemandApply(sPoKeysDemand *dm);
+
+int PK_DemandCreate(sPoKeysDevice *dev, int comp_id, const char *prefix, uint32_t exported)
+{
+    if (!dev) return PK_ERR_NOT_CONNECTED;
+    if (!prefix || strlen(prefix) > HAL_NAME_LEN) return PK_ERR_PARAMETER;
+    if (PK_DemandGet(dev)) return PK_OK;
+    if (demand_count >= PK_DEMAND_MAX) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: demand table full (PK_DEMAND_MAX=%d)\n",
+                        __FILE__, __FUNCTION__, PK_DEMAND_MAX);
+        return PK_ERR_GENERIC;
+    }
+
+    sPoKeysDemand *dm = &demands[demand_count++];
+    memset(dm, 0, sizeof(*dm));
+    dm->dev = dev;
+    dm->comp_id = comp_id;
+    strcpy(dm->prefix, prefix);
+    dm->exportedClasses = exported;
+    dm->taskMask = (1u << PK_DEMAND_TASKS) - 1;
+    PK_DemandApply(dm);
+    return PK_OK;
+}
+
+// Whether a pin name lies under "<prefix>."
+static int PK_DemandOwnName(const sPoKeysDemand *dm, const char *name, size_t prefix_len)
+{
+    return strncmp(name, dm->prefix, prefix_len) == 0 && name[prefix_len] == '.';
+}
+
+// Classify one pin name ("<prefix>.<class>.<n>...") into the pass in progress
+static void PK_DemandClassify(sPoKeysDemand *dm, const char *name, size_t prefix_len)
+{
+    name += prefix_len + 1;
+
+    for (int c = 0; c < PK_DEMAND_CLASSES; c++) {
+        size_t len = strlen(demand_class_names[c]);
+        if (strncmp(name, demand_class_names[c], len) != 0) continue;
+
+        dm->scanLinked |= (1u << c);
+        if (c == PK_DEMAND_ENCODER) {
+            uint32_t idx = 0;
+            const char *p = name + len;
+            if (*p < '0' || *p > '9') return;
+            while (*p >= '0' && *p <= '9') idx = idx * 10 + (uint32_t)(*p++ - '0');
+            if (idx < 32) dm->scanEncoders |= (1u << idx);
+        }
+        return;
+    }
+}
+
+static void PK_DemandApply(sPoKeysDemand *dm)
+{
+    const sPoKeysDevice_Info *info = &dm->dev->info;
+    int enabled = dm->pin_enable ? *dm->pin_enable : 1;
+    uint32_t mask = 0;
+
+    for (size_t t = 0; t < PK_DEMAND_TASKS; t++) {
+        // Never run a task whose pins were not exported
+        int want = (dm->exportedClasses & demand_tasks[t].classes) != 0;
+        if (want && enabled && dm->scanned) {
+            // Outputs are sent on change; setp on an unlinked pin must still reach the device
+            if (!demand_tasks[t].output)
+                want = (dm->linkedClasses & demand_tasks[t].classes) != 0;
+            // Feature flags are only meaningful once device info was read
+            if (want && info->iPinCount != 0 && demand_tasks[t].feature != PK_DEMAND_NO_FEATURE)
+                want = *(const hal_u32_t *)((const char *)info + demand_tasks[t].feature) != 0;
+        }
+        async_task_set_active(dm->dev, demand_tasks[t].task, want);
+        if (want) mask |= (1u << t);
+    }
+
+    if (mask != dm->taskMask)
+        rtapi_print_msg(RTAPI_MSG_INFO, "PoKeys: %s: task-mask 0x%04x -> 0x%04x\n",
+                        dm->prefix, (unsigned)dm->taskMask, (unsigned)mask);
+    dm->taskMask = mask;
+    if (dm->pin_task_mask)   *dm->pin_task_mask = mask;
+    if (dm->pin_linked_mask) *dm->pin_linked_mask = dm->linkedClasses;
+}
+
+int PK_DemandScanAsync(sPoKeysDevice *dev)
+{
+    sPoKeysDemand *dm = PK_DemandGet(dev);
+    if (!dm) return PK_ERR_PARAMETER;
+
+    // Busy mutex: keep the previous result, retry next period
+    if (rtapi_mutex_try(&(hal_data->mutex)) != 0)
+        return PK_OK;
+
+    int pass_done = 0;
+    hal_comp_t *comp = halpr_find_comp_by_id(dm->comp_id);
+    if (comp) {
+        size_t prefix_len = strlen(dm->prefix);
+        hal_pin_t *pin = (hal_pin_t *)dm->scanCursor;
+
+        if (pin == NULL) {
+            // First pin of our run; looked up once, pins are not added later
+            if (dm->scanFirst == NULL) {
+                for (pin = halpr_find_pin_by_owner(comp, NULL); pin;
+                     pin = halpr_find_pin_by_owner(comp, pin)) {
+                    if (PK_DemandOwnName(dm, pin->name, prefix_len)) break;
+                }
+                dm->scanFirst = pin;
+            }
+            pin = (hal_pin_t *)dm->scanFirst;
+            dm->scanLinked = 0;
+            dm->scanEncoders = 0;
+        }
+
+        for (int n = 0; pin && n < PK_DEMAND_SCAN_BATCH; n++) {
+            if (pin->signal != 0)
+                PK_DemandClassify(dm, pin->name, prefix_len);
+            // The run ends at the first pin that is not ours
+            pin = pin->next_ptr ? (hal_pin_t *)SHMPTR(pin->next_ptr) : NULL;
+            if (pin && (pin->owner_ptr != SHMOFF(comp) ||
+                        !PK_DemandOwnName(dm, pin->name, prefix_len)))
+                pin = NULL;
+        }
+
+        dm->scanCursor = pin;
+        if (pin == NULL) {
+            dm->linkedClasses = dm->scanLinked;
+            dm->encoderLinked = dm->scanEncoders;
+            dm->scanned = 1;
+            pass_done = 1;
+        }
+    }
+    rtapi_mutex_give(&(hal_data->mutex));
+
+    if (pass_done)
+        PK_DemandApply(dm);
+    return PK_OK;
+}
+
+int PK_DemandEncodersWanted(const sPoKeysDevice *dev, uint32_t first, uint32_t count)
+{
+    sPoKeysDemand *dm = PK_DemandGet(dev);
+    if (!dm || !dm->scanned || (dm->pin_enable && !*dm->pin_enable)) return 1;
+    if (first >= 32) return 0;
+
+    uint32_t range = (count >= 32 - first) ? ~0u << first : ((1u << count) - 1) << first;
+    return (dm->encoderLinked & range) != 0;
+}
+
+int export_demand_pins(const char *prefix, long comp_id, sPoKeysDevice *dev)
+{
+    int r;
+    sPoKeysDemand *dm = PK_DemandGet(dev);
+
+    if (dm == NULL) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: no demand tracking for device\n", __FILE__, __FUNCTION__);
+        return -1;
+    }
+
+    r = hal_pin_bit_newf(HAL_IN, &(dm->pin_enable), comp_id, "%s.demand.enable", prefix);
+    if (r != 0) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: %s.demand.enable failed\n", __FILE__, __FUNCTION__, prefix);
+        return r;
+    }
+
+    r = hal_pin_u32_newf(HAL_OUT, &(dm->pin_task_mask), comp_id, "%s.demand.task-mask", prefix);
+    if (r != 0) return r;
+
+    r = hal_pin_u32_newf(HAL_OUT, &(dm->pin_linked_mask), comp_id, "%s.demand.linked-mask", prefix);
+    if (r != 0) return r;
+
+    *(dm->pin_enable) = 1;
+    *(dm->pin_task_mask) = dm->taskMask;
+    *(dm->pin_linked_mask) = 0;
+
+    return 0;
+}
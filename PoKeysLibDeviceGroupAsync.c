@@ -0,0 +1,195 @@
+#include "PoKeysLibHal.h"
+#include "PoKeysLibAsync.h"
+#include <string.h>
+
+extern uint64_t get_current_time_us(void);
+
+/*
+ * Device groups - synchronized PEv2 feedback sampling across boards.
+ *
+ * On gantry machines the axes of one joint set are split over several
+ * PoKeys boards.  Polling each board from its own task samples the boards
+ * up to a cycle apart; a group instead batches the status requests of all
+ * members back to back and only publishes HAL feedback once the whole epoch
+ * is complete (or its deadline expired).
+ */
+
+static sPoKeysDeviceGroup device_groups[PK_DEVICE_GROUP_MAX];
+static int device_group_count = 0;
+
+static sPoKeysDeviceGroup *PK_DeviceGroupFindByLeader(const sPoKeysDevice *leader)
+{
+    for (int g = 0; g < device_group_count; g++) {
+        if (device_groups[g].members[0] == leader)
+            return &device_groups[g];
+    }
+    return NULL;
+}
+
+/*
+ * PK_DeviceGroupPublish - stage the status of the current epoch for HAL.
+ * Members that did not answer keep their previous HAL values.
+ */
+static void PK_DeviceGroupPublish(sPoKeysDeviceGroup *grp)
+{
+    uint8_t fullMask = (uint8_t)((1u << grp->memberCount) - 1);
+
+    for (int m = 0; m < grp->memberCount; m++) {
+        if (grp->answeredMask & (1u << m))
+            PK_SnapshotStagePEv2Status(grp->members[m]);
+    }
+
+    if (grp->pin_epoch)           *grp->pin_epoch           = grp->epoch;
+    if (grp->pin_coherent)        *grp->pin_coherent        = (grp->answeredMask == fullMask);
+    if (grp->pin_missing_mask)    *grp->pin_missing_mask    = fullMask & ~grp->answeredMask;
+    if (grp->pin_skew_us)         *grp->pin_skew_us         = grp->answeredMask
+                                                              ? (hal_u32_t)(grp->lastAnswer_us - grp->firstAnswer_us)
+                                                              : 0;
+    if (grp->pin_deadline_misses) *grp->pin_deadline_misses = grp->deadlineMisses;
+    if (grp->pin_stale_responses) *grp->pin_stale_responses = grp->staleResponses;
+
+    grp->inFlight = 0;
+}
+
+/*
+ * Parse callback shared by all group members.  The response is accepted only
+ * if it carries the request ID issued to this member for the epoch in flight;
+ * anything else belongs to an older epoch and is discarded.
+ */
+static int PK_DeviceGroupStatusParse(sPoKeysDevice *dev, const uint8_t *resp)
+{
+    if (!dev || !resp) return PK_ERR_GENERIC;
+
+    for (int g = 0; g < device_group_count; g++) {
+        sPoKeysDeviceGroup *grp = &device_groups[g];
+        for (int m = 0; m < grp->memberCount; m++) {
+            if (grp->members[m] != dev) continue;
+
+            if (!grp->inFlight || grp->memberReqID[m] != resp[6] ||
+                (grp->answeredMask & (1u << m))) {
+                grp->staleResponses++;
+                return PK_ERR_GENERIC;
+            }
+
+            int ret = PK_PEv2_StatusDecode(dev, resp);
+            if (ret != PK_OK) return ret;
+
+            uint64_t now = get_current_time_us();
+            if (grp->answeredMask == 0) grp->firstAnswer_us = now;
+            grp->lastAnswer_us = now;
+            grp->answeredMask |= (uint8_t)(1u << m);
+
+            if (grp->answeredMask == (uint8_t)((1u << grp->memberCount) - 1))
+                PK_DeviceGroupPublish(grp);
+            return PK_OK;
+        }
+    }
+    return PK_ERR_GENERIC;
+}
+
+int PK_DeviceGroupCreate(sPoKeysDevice **members, uint8_t count, uint32_t deadline_us)
+{
+    if (!members || count == 0 || count > PK_DEVICE_GROUP_MAX_MEMBERS || deadline_us == 0)
+        return PK_ERR_PARAMETER;
+    if (device_group_count >= PK_DEVICE_GROUP_MAX) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: group table full (PK_DEVICE_GROUP_MAX=%d)\n",
+                        __FILE__, __FUNCTION__, PK_DEVICE_GROUP_MAX);
+        return PK_ERR_GENERIC;
+    }
+    for (int m = 0; m < count; m++) {
+        if (!members[m]) return PK_ERR_PARAMETER;
+    }
+
+    sPoKeysDeviceGroup *grp = &device_groups[device_group_count];
+    memset(grp, 0, sizeof(*grp));
+    memcpy(grp->members, members, count * sizeof(sPoKeysDevice *));
+    grp->memberCount = count;
+    grp->deadline_us = deadline_us;
+
+    return device_group_count++;
+}
+
+sPoKeysDeviceGroup *PK_DeviceGroupGet(int group)
+{
+    if (group < 0 || group >= device_group_count) return NULL;
+    return &device_groups[group];
+}
+
+int PK_DeviceGroupSampleAsync(sPoKeysDevice *leader)
+{
+    if (!leader) return PK_ERR_NOT_CONNECTED;
+    sPoKeysDeviceGroup *grp = PK_DeviceGroupFindByLeader(leader);
+    if (!grp) return PK_ERR_PARAMETER;
+
+    uint64_t now = get_current_time_us();
+    if (grp->inFlight) {
+        if ((now - grp->epochStart_us) < grp->deadline_us)
+            return PK_OK; // Previous epoch still collecting
+        grp->deadlineMisses++;
+        PK_DeviceGroupPublish(grp);
+    }
+
+    grp->epoch++;
+    grp->answeredMask = 0;
+
+    // Prepare every member first so the sends below go out back to back
+    int prepared = 0;
+    for (int m = 0; m < grp->memberCount; m++) {
+        int req = PK_PEv2_StatusRequestCreateAsync(grp->members[m], PK_DeviceGroupStatusParse);
+        grp->memberReqID[m] = (req > 0) ? (uint8_t)req : 0;
+        if (req > 0) prepared++;
+    }
+    if (prepared == 0) return PK_ERR_GENERIC;
+
+    grp->epochStart_us = get_current_time_us();
+    grp->inFlight = 1;
+
+    int result = PK_OK;
+    for (int m = 0; m < grp->memberCount; m++) {
+        if (grp->memberReqID[m] == 0) continue;
+        if (SendRequestAsync(grp->members[m], grp->memberReqID[m]) != 0)
+            result = PK_ERR_TRANSFER;
+    }
+    return result;
+}
+
+int export_device_group_pins(const char *prefix, long comp_id, int group)
+{
+    int r;
+    sPoKeysDeviceGroup *grp = PK_DeviceGroupGet(group);
+
+    if (grp == NULL) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: invalid group %d\n", __FILE__, __FUNCTION__, group);
+        return -1;
+    }
+
+    r = hal_pin_u32_newf(HAL_OUT, &(grp->pin_epoch), comp_id, "%s.group.%01d.epoch", prefix, group);
+    if (r != 0) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: %s.group.%01d.epoch failed\n", __FILE__, __FUNCTION__, prefix, group);
+        return r;
+    }
+
+    r = hal_pin_bit_newf(HAL_OUT, &(grp->pin_coherent), comp_id, "%s.group.%01d.coherent", prefix, group);
+    if (r != 0) return r;
+
+    r = hal_pin_u32_newf(HAL_OUT, &(grp->pin_missing_mask), comp_id, "%s.group.%01d.missing-mask", prefix, group);
+    if (r != 0) return r;
+
+    r = hal_pin_u32_newf(HAL_OUT, &(grp->pin_skew_us), comp_id, "%s.group.%01d.skew-us", prefix, group);
+    if (r != 0) return r;
+
+    r = hal_pin_u32_newf(HAL_OUT, &(grp->pin_deadline_misses), comp_id, "%s.group.%01d.deadline-misses", prefix, group);
+    if (r != 0) return r;
+
+    r = hal_pin_u32_newf(HAL_OUT, &(grp->pin_stale_responses), comp_id, "%s.group.%01d.stale-responses", prefix, group);
+    if (r != 0) return r;
+
+    *(grp->pin_epoch) = 0;
+    *(grp->pin_coherent) = 0;
+    *(grp->pin_missing_mask) = 0;
+    *(grp->pin_skew_us) = 0;
+    *(grp->pin_deadline_misses) = 0;
+    *(grp->pin_stale_responses) = 0;
+
+    return 0;
+}
@@ -86,13 +86,12 @@ typedef struct {
     sPoKeys57Industrial* inst;
 } PK57iUpdateCtx;
 
-static PK57iUpdateCtx updCtx[256];
+PK_PARSER_CTX_CHECK(PK57iUpdateCtx);
 
 static int PK57i_Update_Parse(sPoKeysDevice* dev, const uint8_t* resp)
 {
-    uint8_t id = resp[6];
-    PK57iUpdateCtx* c = &updCtx[id];
-    if (!c->inst)
+    PK57iUpdateCtx* c = PK_TransactionContext(dev, resp[6]);
+    if (!c || !c->inst)
         return PK_ERR_GENERIC;
     sPoKeys57Industrial* d = c->inst;
     for (uint32_t i=0;i<8;i++)
@@ -132,7 +131,9 @@ int PK57i_UpdateAsync(sPoKeys57Industrial* device, uint8_t resetFaults)
                                             payload, sizeof(payload),
                                             PK57i_Update_Parse);
     if (req < 0) return req;
-    updCtx[req].inst = device;
+    PK57iUpdateCtx* c = PK_TransactionContext(dev, (uint8_t)req);
+    if (!c) return PK_ERR_GENERIC;
+    c->inst = device;
     return SendRequestAsync(dev, req);
 }
 
@@ -95,6 +95,9 @@ int PK_DeviceAliveCheckAsync(sPoKeysDevice* device)
                              PK_Parse_DeviceAlive);
 }
 
+static const sPoKeysRequestTemplate tpl_load_status =
+    PK_REQUEST_TEMPLATE(PK_CMD_DEVICE_LOAD_STATUS, 0, 0, 0, 0, 0, 0, PK_Parse_LoadStatus);
+
 /**
  * @brief Get device load status (async)
  * 
@@ -111,9 +114,7 @@ int PK_DeviceLoadStatusAsync(sPoKeysDevice* device)
     if (!device->info.iLoadStatus) 
         return PK_ERR_NOT_SUPPORTED;
     
-    return CreateAndSendRequestAsync(device, PK_CMD_DEVICE_LOAD_STATUS,
-                             NULL, 0, NULL, 0,
-                             PK_Parse_LoadStatus);
+    return PK_RequestTemplateSendAsync(device, &tpl_load_status, NULL, 0);
 }
 
 /**
@@ -17,13 +17,13 @@ typedef struct {
     uint8_t used;
 } EasySensorAsyncContext;
 
-static EasySensorAsyncContext es_ctx[256];
+PK_PARSER_CTX_CHECK(EasySensorAsyncContext);
 
 /* Parse EasySensor configuration response */
 static int PK_EasySensorSetup_Parse(sPoKeysDevice *dev, const uint8_t *resp)
 {
-    uint8_t id = resp[6];
-    EasySensorAsyncContext *c = &es_ctx[id];
+    EasySensorAsyncContext *c = PK_TransactionContext(dev, resp[6]);
+    if (!c) return PK_ERR_GENERIC;
     if (!c->sensor_ptr) {
         c->used = 0;
         return PK_ERR_GENERIC;
@@ -42,8 +42,8 @@ static int PK_EasySensorSetup_Parse(sPoKeysDevice *dev, const uint8_t *resp)
 /* Parse EasySensor values response */
 static int PK_EasySensorValues_Parse(sPoKeysDevice *dev, const uint8_t *resp)
 {
-    uint8_t id = resp[6];
-    EasySensorAsyncContext *c = &es_ctx[id];
+    EasySensorAsyncContext *c = PK_TransactionContext(dev, resp[6]);
+    if (!c) return PK_ERR_GENERIC;
     if (!c->sensor_ptr) {
         c->used = 0;
         return PK_ERR_GENERIC;
@@ -72,9 +72,11 @@ int PK_EasySensorsSetupGetAsync(sPoKeysDevice* device)
                                      params, 4, NULL, 0,
                                      PK_EasySensorSetup_Parse);
         if (req < 0) return req;
-        es_ctx[req].sensor_ptr = es;
-        es_ctx[req].count = 1;
-        es_ctx[req].used = 1;
+        EasySensorAsyncContext *c = PK_TransactionContext(device, (uint8_t)req);
+        if (!c) return PK_ERR_GENERIC;
+        c->sensor_ptr = es;
+        c->count = 1;
+        c->used = 1;
         int err = SendRequestAsync(device, req);
         if (err != PK_OK) return err;
     }
@@ -118,9 +120,11 @@ int PK_EasySensorsValueGetAllAsync(sPoKeysDevice* device)
                                      params, 4, NULL, 0,
                                      PK_EasySensorValues_Parse);
         if (req < 0) return req;
-        es_ctx[req].sensor_ptr = &device->EasySensors[i];
-        es_ctx[req].count = readNum;
-        es_ctx[req].used = 1;
+        EasySensorAsyncContext *c = PK_TransactionContext(device, (uint8_t)req);
+        if (!c) return PK_ERR_GENERIC;
+        c->sensor_ptr = &device->EasySensors[i];
+        c->count = readNum;
+        c->used = 1;
         int err = SendRequestAsync(device, req);
         if (err != PK_OK) return err;
     }
@@ -254,6 +254,8 @@ int export_encoder_pins(const char *prefix, long comp_id, sPoKeysDevice *device)
  int PK_EncoderValuesGetAsync_ProcessPage0(sPoKeysDevice *device, const uint8_t *response)
  {
      if (device == NULL || response == NULL) return PK_ERR_TRANSFER;
+     if (PK_SnapshotStageEncoders(device, 0, 13, &response[8]) == PK_OK)
+         return PK_OK;
 
 #ifdef DEBUG_ENCODER_VALUES
      rtapi_print_msg(RTAPI_MSG_DBG,
@@ -284,6 +286,8 @@ int export_encoder_pins(const char *prefix, long comp_id, sPoKeysDevice *device)
  int PK_EncoderValuesGetAsync_ProcessPage1(sPoKeysDevice *device, const uint8_t *response)
  {
      if (device == NULL || response == NULL) return PK_ERR_TRANSFER;
+     if (PK_SnapshotStageEncoders(device, 13, 13, &response[8]) == PK_OK)
+         return PK_OK;
 
 #ifdef DEBUG_ENCODER_VALUES
      rtapi_print_msg(RTAPI_MSG_DBG,
@@ -315,6 +319,8 @@ int export_encoder_pins(const char *prefix, long comp_id, sPoKeysDevice *device)
  int PK_EncoderValuesGetAsync_ProcessPage1_FastOnly(sPoKeysDevice *device, const uint8_t *response)
  {
      if (device == NULL || response == NULL) return PK_ERR_TRANSFER;
+     if (PK_SnapshotStageEncoders(device, 13, 12, &response[8]) == PK_OK)
+         return PK_OK;
 
 #ifdef DEBUG_ENCODER_VALUES
      rtapi_print_msg(RTAPI_MSG_DBG,
@@ -504,6 +510,15 @@ int PK_EncoderConfigurationGetAsync(sPoKeysDevice* device)
      return PK_OK;
  }
 
+static const sPoKeysRequestTemplate tpl_encoders_page0 =
+    PK_REQUEST_TEMPLATE(0xCD, 0, 0, 0, 0, 0, 0, PK_EncoderValuesGetAsync_ProcessPage0);
+static const sPoKeysRequestTemplate tpl_encoders_page1 =
+    PK_REQUEST_TEMPLATE(0xCD, 1, 0, 0, 0, 0, 0, PK_EncoderValuesGetAsync_ProcessPage1);
+static const sPoKeysRequestTemplate tpl_encoders_page1_fast =
+    PK_REQUEST_TEMPLATE(0xCD, 1, 0, 0, 0, 0, 0, PK_EncoderValuesGetAsync_ProcessPage1_FastOnly);
+static const sPoKeysRequestTemplate tpl_encoders_ultrafast =
+    PK_REQUEST_TEMPLATE(PK_CMD_PULSE_ENGINE_V2, 0x37, 0, 0, 0, 0, 0, PK_EncoderValuesGetAsync_ProcessUltraFast);
+
 /**
  * @brief Starts asynchronous encoder values retrieval.
  *
@@ -516,33 +531,26 @@ int PK_EncoderConfigurationGetAsync(sPoKeysDevice* device)
      int ret;
 
      // Always read the first 13 encoders
-     ret = CreateAndSendRequestAsync(device, 0xCD, NULL, 0,
-         NULL, 0, PK_EncoderValuesGetAsync_ProcessPage0);
+     ret = PK_RequestTemplateSendAsync(device, &tpl_encoders_page0, NULL, 0);
      if (ret < 0) return ret;
 
-     if (device->info.iBasicEncoderCount >= 25)
+     // Page 1 only when one of its encoders is linked (see PK_DemandScanAsync)
+     if (device->info.iBasicEncoderCount >= 25 && PK_DemandEncodersWanted(device, 13, 13))
      {
          if (device->info.iUltraFastEncoders != 0)
          {
              // Read the next 13 encoders (Page 1, with UltraFast)
-             uint8_t param_next = 1;
-             ret = CreateAndSendRequestAsync(device, 0xCD, &param_next, 1,
-                 NULL, 0, PK_EncoderValuesGetAsync_ProcessPage1);
+             ret = PK_RequestTemplateSendAsync(device, &tpl_encoders_page1, NULL, 0);
              if (ret < 0) return ret;
 
-             // Read UltraFast encoder extra values
-             uint8_t params_ultrafast[] = {0x37}; // Sub-command for test mode
-             ret = CreateAndSendRequestAsync(device, PK_CMD_PULSE_ENGINE_V2,
-                 params_ultrafast, 1, NULL, 0,
-                 PK_EncoderValuesGetAsync_ProcessUltraFast);
+             // Read UltraFast encoder extra values (sub-command 0x37, test mode)
+             ret = PK_RequestTemplateSendAsync(device, &tpl_encoders_ultrafast, NULL, 0);
              if (ret < 0) return ret;
          }
          else
          {
              // Fast encoders only: next 12 encoders (Page 1)
-             uint8_t param_next = 1;
-             ret = CreateAndSendRequestAsync(device, 0xCD, &param_next, 1,
-                 NULL, 0, PK_EncoderValuesGetAsync_ProcessPage1_FastOnly);
+             ret = PK_RequestTemplateSendAsync(device, &tpl_encoders_page1_fast, NULL, 0);
              if (ret < 0) return ret;
          }
      }
@@ -342,7 +342,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
 	
 
-	int32_t SendRequestFastUSB(sPoKeysDevice* device)
+	int32_t SendRequestFastUSBBuffers(sPoKeysDevice* device, uint8_t* request, uint8_t* response)
 	{
 		// Initialize variables
         uint32_t waits = 0;
@@ -366,11 +366,11 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 		// Request sending loop
 		while (retries++ < 2)
 		{
-			device->request[0] = 0xBB;
-			device->request[6] = ++device->requestID;
-			device->request[7] = getChecksum(device->request);
+			request[0] = 0xBB;
+			request[6] = ++device->requestID;
+			request[7] = getChecksum(request);
 
-			result = libusb_bulk_transfer(devh, 0x02, device->request, 64, &bytesTransferred, 10);
+			result = libusb_bulk_transfer(devh, 0x02, request, 64, &bytesTransferred, 10);
 
 			// In case of an error, try sending again
 			if (result < 0)
@@ -380,7 +380,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 				continue;
 			}
 
-            if (device->request[1] == 0x50 || device->request[1] == 0x51 || device->request[1] == 0x52)
+            if (request[1] == 0x50 || request[1] == 0x51 || request[1] == 0x52)
             {
                 // Delay 500 ms...
                 timeoutValue = 500;
@@ -390,7 +390,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 			// Request receiving loop
 			while (waits++ < 10)
 			{
-                result = libusb_bulk_transfer(devh, 0x82, device->response, 64, &bytesTransferred, timeoutValue);
+                result = libusb_bulk_transfer(devh, 0x82, response, 64, &bytesTransferred, timeoutValue);
 
 				// Error is not an option
 				if (result < 0)
@@ -403,9 +403,9 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 				}
 
 				// Check the header and the request ID
-				if (device->response[0] == 0xAA && device->response[6] == device->requestID)
+				if (response[0] == 0xAA && response[6] == device->requestID)
 				{
-					if (device->response[7] == getChecksum(device->response))
+					if (response[7] == getChecksum(response))
 					{
 						LastRetryCount = retries;
 						LastWaitCount = waits;
@@ -436,6 +436,12 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
 		return PK_ERR_TRANSFER;
 	}
+
+	int32_t SendRequestFastUSB(sPoKeysDevice* device)
+	{
+		if (device == NULL) return PK_ERR_GENERIC;
+		return SendRequestFastUSBBuffers(device, device->request, device->response);
+	}
 	
 	int32_t SendRequestFastUSB_NoResponse(sPoKeysDevice* device)
 	{
@@ -379,6 +379,17 @@ typedef struct
 } sPoKeysDevice_Info;
 
 
+// Bank of up to 64 input bits published to HAL on change only
+// (see PK_BitBankUpdate() in PoKeysLibAsync.h)
+#define PK_BITBANK_BITS 64
+typedef struct
+{
+ uint64_t        bits;                       // Bits as last published to HAL
+ uint8_t         primed;                     // bits is valid; until then every bit counts as changed
+ uint32_t        edges[PK_BITBANK_BITS];     // Per-bit edge counter
+ uint64_t        edge_us[PK_BITBANK_BITS];   // Per-bit time of the last edge
+} sPoKeysBitBank;
+
 // Pulse engine v2 information
 typedef struct
 {
@@ -391,12 +402,73 @@ typedef struct
 } sPoKeysPEv2info;
 
 
+#define PK_CACHELINE 64 // Cache line size assumed for hot-data alignment
+
 // Pulse engine v2 structure...
 typedef struct
 {
- sPoKeysPEv2info info;                      // Pulse engine info
-
+ // ---- Hot block: read or written every servo cycle (status decode, HAL
+ // publish, MovePV build). Kept contiguous at the start of the struct so the
+ // per-cycle path touches as few cache lines as possible. The struct is
+ // cache-line aligned, so the block starts on a line boundary as long as
+ // the device comes from PK_DeviceAlloc(). Add per-cycle fields here and
+ // configuration-only fields below. ----
  uint8_t         AxesState[8];              // Axis states (bit-mapped) - see ePK_PEAxisState
+ hal_s32_t         CurrentPosition[8];        // Current position
+ hal_s32_t         ReferencePositionSpeed[8]; // Reference position or speed (position or pulses/s)
+ hal_float_t            ReferenceVelocityPV[8];    // Reference velocity in PV mode (between 0.0 and 1.0) as ratio of max. speed
+ uint8_t         PulseEngineState;          // State of pulse engine - see ePoKeysPEState
+ uint8_t         PulseEngineActivated;      // Pulse engine activation status
+ uint8_t         PulseEngineEnabled;        // Pulse engine enabled status, also number of enabled axes
+ uint8_t         LimitStatusP;              // Limit+ status (bit-mapped)
+ uint8_t         LimitStatusN;              // Limit- status (bit-mapped)
+ uint8_t         HomeStatus;                // Home status (bit-mapped)
+ uint8_t         ErrorInputStatus;          // Stepper motor driver error inputs status (bit-mapped)
+ uint8_t         MiscInputStatus;           // Miscelenous digital inputs...
+ uint8_t         SoftLimitStatus;           // Bit-mapped soft-limit statuses per axes
+ uint8_t         AxisEnabledStatesMask;     // Bit-mapped states, where axis enabled and charge pump signals are active
+ uint8_t         LimitOverride;             // Limit override status
+ uint8_t         param2;
+ hal_float_t     stepgen_STEP_SCALE[8];      // Steps per unit (for position scaling)
+ hal_float_t            MaxSpeed[8];               // Maximum axis speed (in pulses per ms)
+
+ // Feedback extrapolation and change-driven MovePV
+ uint64_t        fbSample_us;                // Estimated device sample time of CurrentPosition
+ uint64_t        fbPrevSample_us;            // Sample time of the previous status
+ double          fbVelocity[8];              // Estimated axis velocity (pulses/s)
+ int32_t         fbPrevPosition[8];          // CurrentPosition of the previous status
+ int32_t         movePVSentPosition[8];      // ReferencePositionSpeed at last send
+ float           movePVSentVelocity[8];      // ReferenceVelocityPV at last send
+ uint64_t        movePVSent_us;              // Time of last MovePV send (0 = never)
+ uint32_t        movePVSkipped;              // MovePV cycles skipped (no axis changed)
+
+ // Per-cycle HAL pins - the remaining pin pointers are further down
+ hal_float_t    *pin_joint_pos_cmd[8];       // pokeys.0.PEv2.0.joint-pos-cmd
+ hal_float_t    *pin_joint_vel_cmd[8];       // pokeys.0.PEv2.0.joint-vel-cmd
+ hal_float_t    *pin_joint_pos_fb[8];        // pokeys.0.PEv2.0.joint-pos-fb
+ hal_bit_t      *pin_joint_in_position[8];  // pokeys.0.PEv2.0.joint-in-position
+ hal_u32_t      *pin_AxesState[8];           // pokeys.0.PEv2.0.AxesState
+ hal_s32_t      *pin_CurrentPosition[8];    // pokeys.0.PEv2.0.CurrentPosition
+ hal_u32_t      *pin_PulseEngineState;      // pokeys.0.PEv2.PulseEngineState
+ hal_u32_t      *pin_PulseEngineActivated;  // pokeys.0.PEv2.PulseEngineActivated
+ hal_bit_t      *pin_digin_Emergency_in;    // pokeys.0.PEv2.digin.Emergency.in
+ hal_bit_t      *pin_digin_Emergency_in_not; // pokeys.0.PEv2.digin.Emergency.in-not
+ hal_bit_t      *pin_digin_LimitN_in[8];    // pokeys.0.PEv2.0.digin.LimitN.in
+ hal_bit_t      *pin_digin_LimitN_in_not[8]; // pokeys.0.PEv2.0.digin.LimitN.in-not
+ hal_bit_t      *pin_digin_LimitP_in[8];    // pokeys.0.PEv2.0.digin.LimitP.in
+ hal_bit_t      *pin_digin_LimitP_in_not[8]; // pokeys.0.PEv2.0.digin.LimitP.in-not
+ hal_bit_t      *pin_digin_Home_in[8];      // pokeys.0.PEv2.0.digin.Home.in
+ hal_bit_t      *pin_digin_Home_in_not[8];  // pokeys.0.PEv2.0.digin.Home.in-not
+ hal_u32_t      *pin_fb_age_us;                  // pokeys.0.PEv2.fb-age-us
+ hal_float_t    *pin_fb_extrapolate_max_us;      // pokeys.0.PEv2.fb-extrapolate-max-us
+ hal_float_t    *pin_movepv_deadband[8];         // pokeys.0.PEv2.0.movepv-deadband
+ hal_u32_t      *pin_movepv_keepalive_ms;        // pokeys.0.PEv2.movepv-keepalive-ms
+ hal_u32_t      *pin_movepv_skipped;             // pokeys.0.PEv2.movepv-skipped
+
+ // ---- Cold block: configuration, setup and diagnostics. Starts on its own
+ // cache line so no hot line is shared with configuration fields. ----
+ sPoKeysPEv2info info __attribute__((aligned(PK_CACHELINE))); // Pulse engine info
+
  uint8_t         AxesConfig[8];             // Axis configuration - see ePK_PEv2_AxisConfig
  uint8_t         AxesSwitchConfig[8];       // Axis switch configuration - see ePK_PEv2_AxisSwitchOptions
  // Expanded AxesConfig bitfields (hal_bit_t for direct HAL availability).
@@ -420,9 +492,7 @@ typedef struct
  hal_bit_t       AxesSwitchConfig_InvertLimitN[8];    // PK_ASO_SWITCH_INVERT_LIMIT_N (bit 5)
  hal_bit_t       AxesSwitchConfig_InvertLimitP[8];    // PK_ASO_SWITCH_INVERT_LIMIT_P (bit 6)
  hal_bit_t       AxesSwitchConfig_InvertHome[8];       // PK_ASO_SWITCH_INVERT_HOME (bit 7)
- hal_s32_t         CurrentPosition[8];        // Current position
  hal_s32_t         PositionSetup[8];          // Position to be set as current position
- hal_s32_t         ReferencePositionSpeed[8]; // Reference position or speed (position or pulses/s)
  int8_t          InvertAxisEnable[8];       // Invert axis enable signal
 
  hal_s32_t         SoftLimitMaximum[8];       // Soft limit maximum position
@@ -440,7 +510,6 @@ typedef struct
 
  hal_s32_t         ProbePosition[8];          // Position where probe detected change
  hal_s32_t         ProbeMaxPosition[8];       // Maximum position to travel to until stopping and returning error
- hal_float_t            MaxSpeed[8];               // Maximum axis speed (in pulses per ms)
  hal_float_t            MaxAcceleration[8];        // Maximum axis acceleration (in pulses/ms/ms)
  hal_float_t            MaxDecceleration[8];       // Maximum axis deceleration (in pulses/ms/ms)
 
@@ -457,28 +526,15 @@ typedef struct
  uint8_t         reserved[7];               // Motion buffer entries - moved further down...
  uint8_t			AxisSignalOptions[8];	   // Axis signal options (invert step or direction)
 
- hal_float_t            ReferenceVelocityPV[8];    // Reference velocity in PV mode (between 0.0 and 1.0) as ratio of max. speed
  uint8_t         ReservedSafety[8];         // 8-bytes reserved
 
  // ------ 64-bit region boundary ------
- uint8_t         PulseEngineEnabled;        // Pulse engine enabled status, also number of enabled axes
  uint8_t         PulseGeneratorType;        // Pulse engine generator type (0: external, 1: internal 3ch)
  uint8_t         ChargePumpEnabled;         // Charge pump output enabled
  uint8_t         EmergencySwitchPolarity;   // Emergency switch polarity (set to 1 to invert)
 
- uint8_t         PulseEngineActivated;      // Pulse engine activation status
- uint8_t         LimitStatusP;              // Limit+ status (bit-mapped)
- uint8_t         LimitStatusN;              // Limit- status (bit-mapped)
- uint8_t         HomeStatus;                // Home status (bit-mapped)
-
- uint8_t         ErrorInputStatus;          // Stepper motor driver error inputs status (bit-mapped)
- uint8_t         MiscInputStatus;           // Miscelenous digital inputs...
- uint8_t         LimitOverride;             // Limit override status
  uint8_t         LimitOverrideSetup;        // Limit override configuration
 
- // State of pulse engine - see ePoKeysPEState
- uint8_t         PulseEngineState;
-
  uint8_t         AxisEnabledMask;           // Bit-mapped ouput enabled mask
  uint8_t         EmergencyInputPin;
  uint8_t         SyncFastOutputsAxisID;	   // Enable synced outputs and select pulse engine axis to map the data to (1-based)
@@ -487,13 +543,10 @@ typedef struct
 
  // ------ 64-bit region boundary ------
  uint8_t         param1;                    // Parameter 1 value
- uint8_t         param2;
  uint8_t         param3;
 
- uint8_t         AxisEnabledStatesMask;     // Bit-mapped states, where axis enabled and charge pump signals are active
  uint8_t         PulseEngineStateSetup;     // Pulse engine new state configuration
 
- uint8_t         SoftLimitStatus;           // Bit-mapped soft-limit statuses per axes
  uint8_t         ExternalRelayOutputs;      // External relay outputs
  uint8_t         ExternalOCOutputs;         // External open-collector outputs
  uint8_t         PulseEngineBufferSize;     // Buffer size information...
@@ -549,28 +602,12 @@ typedef struct
  uint8_t         InternalDriverCurrentConfig[4];
 
  // HAL pin pointers - exported via export_pev2_pins() in PoKeysLibPulseEngine_v2Async.c
- hal_float_t    *pin_joint_pos_cmd[8];       // pokeys.0.PEv2.0.joint-pos-cmd
- hal_float_t    *pin_joint_vel_cmd[8];       // pokeys.0.PEv2.0.joint-vel-cmd
- hal_float_t    *pin_joint_pos_fb[8];        // pokeys.0.PEv2.0.joint-pos-fb
- hal_bit_t      *pin_joint_in_position[8];  // pokeys.0.PEv2.0.joint-in-position
- hal_u32_t      *pin_AxesState[8];           // pokeys.0.PEv2.0.AxesState
  hal_u32_t      *pin_AxesCommand[8];         // pokeys.0.PEv2.0.AxesCommand
- hal_s32_t      *pin_CurrentPosition[8];    // pokeys.0.PEv2.0.CurrentPosition
  hal_u32_t      *pin_nrOfAxes;              // pokeys.0.PEv2.nrOfAxes
  hal_u32_t      *pin_maxPulseFrequency;     // pokeys.0.PEv2.maxPulseFrequency
  hal_u32_t      *pin_bufferDepth;           // pokeys.0.PEv2.bufferDepth
  hal_u32_t      *pin_slotTiming;            // pokeys.0.PEv2.slotTiming
- hal_u32_t      *pin_PulseEngineActivated;  // pokeys.0.PEv2.PulseEngineActivated
- hal_u32_t      *pin_PulseEngineState;      // pokeys.0.PEv2.PulseEngineState
- hal_bit_t      *pin_digin_Emergency_in;    // pokeys.0.PEv2.digin.Emergency.in
- hal_bit_t      *pin_digin_Emergency_in_not; // pokeys.0.PEv2.digin.Emergency.in-not
  hal_bit_t      *pin_digout_Emergency_out;  // pokeys.0.PEv2.digout.Emergency.out
- hal_bit_t      *pin_digin_LimitN_in[8];    // pokeys.0.PEv2.0.digin.LimitN.in
- hal_bit_t      *pin_digin_LimitN_in_not[8]; // pokeys.0.PEv2.0.digin.LimitN.in-not
- hal_bit_t      *pin_digin_LimitP_in[8];    // pokeys.0.PEv2.0.digin.LimitP.in
- hal_bit_t      *pin_digin_LimitP_in_not[8]; // pokeys.0.PEv2.0.digin.LimitP.in-not
- hal_bit_t      *pin_digin_Home_in[8];      // pokeys.0.PEv2.0.digin.Home.in
- hal_bit_t      *pin_digin_Home_in_not[8];  // pokeys.0.PEv2.0.digin.Home.in-not
  hal_u32_t      *pin_HomingStatus[8];       // pokeys.0.PEv2.0.HomingStatus
  hal_bit_t      *pin_index_enable[8];       // pokeys.0.PEv2.0.index-enable
  hal_bit_t      *pin_digout_ExternalRelay_out[4]; // pokeys.0.PEv2.digout.ExternalRelay-0.out
@@ -595,14 +632,46 @@ typedef struct
  hal_bit_t      *pin_joint_wheel_jog_active[8];  // pokeys.0.PEv2.0.joint-wheel-jog-active
  hal_bit_t      *pin_motion_buffer_mode;          // pokeys.0.PEv2.motion-buffer-mode
  hal_s32_t      *pin_motion_buffer_entries_accepted; // pokeys.0.PEv2.motion-buf-entries
+ hal_u32_t      *pin_status_polls_skipped;       // pokeys.0.PEv2.status-polls-skipped
+ hal_bit_t      *pin_engine_enable;              // pokeys.0.PEv2.engine-enable
+ hal_bit_t      *pin_engine_reset;               // pokeys.0.PEv2.engine-reset
+ hal_u32_t      *pin_state_timeout_ms;           // pokeys.0.PEv2.state-timeout-ms
+ hal_bit_t      *pin_state_pending;              // pokeys.0.PEv2.state-pending
+ hal_bit_t      *pin_state_fault;                // pokeys.0.PEv2.state-fault
+ hal_u32_t      *pin_transition_time_us;         // pokeys.0.PEv2.transition-time-us
  // HAL parameters (not HAL pins, stored directly) not already in sPoKeysPEv2 fields
  hal_s32_t       home_sequence[8];           // Homing sequence (-1 = no homing)
- hal_float_t     stepgen_STEP_SCALE[8];      // Steps per unit (for position scaling)
  hal_s32_t       pos_scale[8];               // Position scale factor
  hal_s32_t       pos_offset[8];              // Position offset
  hal_float_t     step_width[8];              // Minimum position delta to register movement
 
-} sPoKeysPEv2;
+ // Status polling - filled by the status decoder
+ uint64_t        statusPiggyback_us;         // Last status carried by a non-poll response (e.g. BufferFill)
+ uint32_t        statusPollsSkipped;         // GET_STATUS polls skipped because status was fresh
+
+ // Engine state machine - see ePK_PEv2StatePhase
+ uint8_t         smPhase;                    // Current phase of the state transition
+ uint8_t         smTarget;                   // Requested PulseEngineState
+ uint8_t         smReqID;                    // Request ID of the SET_STATE / verify in flight
+ uint8_t         smAttempts;                 // SET_STATE attempts for this transition
+ uint8_t         smEnablePrev;               // engine-enable seen on the previous service
+ uint8_t         smResetPrev;                // engine-reset seen on the previous service
+ uint8_t         smFrom;                     // PulseEngineState when the transition started
+ uint32_t        smBackoff_us;               // Wait before the next retry (doubles per retry)
+ uint64_t        smStart_us;                 // Transition start time
+ uint64_t        smAttempt_us;               // Time the current attempt was sent
+
+ // Bulk configuration transfer - see PK_PEv2_ConfigurationGetAllAsync()
+ uint16_t        cfgPendingMask;             // Requests still unanswered (bit = PK_PEV2_CFG_* index)
+ uint16_t        cfgFailedMask;              // Requests not created, not sent or not parsed
+ uint8_t         cfgReqID[10];               // Request ID per PK_PEV2_CFG_* index
+ uint8_t         cfgWrite;                   // 1 = bulk write, 0 = bulk read
+ uint64_t        cfgDeadline_us;             // Bulk transfer deadline
+
+ // Limit/home/e-stop bits as published to HAL - see PEV2_BANK_*
+ sPoKeysBitBank  statusInputBank;
+
+} __attribute__((aligned(PK_CACHELINE))) sPoKeysPEv2;
 
 // RT-safe motion data structures (for async command queue)
 typedef struct {
@@ -853,6 +922,9 @@ typedef struct
  uint8_t PWMduty;
  uint8_t lightValue;
  uint8_t PoNETstatus;
+
+ // statusIn bits as published to HAL (bytes 0..7 and 8..15)
+ sPoKeysBitBank statusInBank[2];
  
  // HAL pin pointers for statusIn array (hardware to HAL)
  hal_u32_t *statusIn_pins[16];
@@ -1066,6 +1138,8 @@ typedef struct
  void*                     devHandle;                     // Communication device handle
  void*                     devHandle2;
  struct sockaddr_in *devHandle3; // Only used for async sendto()
+ void*                     xdpTransport;                  // Optional AF_XDP transport (PoKeysLibXDP.c), NULL = kernel UDP socket
+ void*                     asyncContext;                  // Transaction engine state (sPoKeysAsyncContext), bound on first request
 
  
  sPoKeysDevice_Info        info;                          // PoKeys device info
@@ -1126,7 +1200,7 @@ typedef struct
  uint8_t                   connectionType;                // Connection type
  uint8_t                   connectionParam;               // Additional connection parameter
  uint8_t                   requestID;                     // Communication request ID
- uint8_t                   reserved;
+ uint8_t                   transportLock;                 // Held by SendRequest*() for the transport exchange
  ALIGN_TEST(5)
  hal_u32_t  sendRetries;
  hal_u32_t  readRetries;
@@ -1173,6 +1247,21 @@ typedef struct
  
 } sPoKeysDevice;
 
+// Allocates an uninitialised, cache-line aligned device (PoKeysLibCore.c);
+// use it instead of hal_malloc(sizeof(sPoKeysDevice))
+sPoKeysDevice* PK_DeviceAlloc(void);
+
+// Caller-owned request context. Each thread builds its request and receives
+// its response here instead of in device->request/response, so several
+// threads can exchange packets with one device concurrently.
+typedef struct
+{
+ uint8_t                   request[68];                   // Request buffer (fill with CreateRequest)
+ uint8_t                   response[68];                  // Response buffer
+ uint8_t                   requestID;                     // Request ID of the last exchange
+ uint8_t                   reserved[3];
+} sPoKeysRequestContext;
+
   typedef struct
         {
             // Device info section
@@ -1248,6 +1337,10 @@ POKEYSDECL int32_t PK_SaveConfiguration(sPoKeysDevice* device);
 POKEYSDECL int32_t PK_ClearConfiguration(sPoKeysDevice* device);
 // Exchange custom request
 POKEYSDECL int32_t PK_CustomRequest(sPoKeysDevice* device, unsigned char type, unsigned char param1, unsigned char param2, unsigned char param3, unsigned char param4);
+// Exchange a request prepared in a caller-owned context (thread-safe)
+POKEYSDECL int32_t PK_SendRequestContext(sPoKeysDevice* device, sPoKeysRequestContext* context);
+// Exchange custom request using a caller-owned context (thread-safe)
+POKEYSDECL int32_t PK_CustomRequestContext(sPoKeysDevice* device, sPoKeysRequestContext* context, unsigned char type, unsigned char param1, unsigned char param2, unsigned char param3, unsigned char param4);
 POKEYSDECL int32_t PK_GetDebugValues(sPoKeysDevice * device, int32_t * buffer);
 // Enable (1) or disable (0) fast USB interface in PoKeys56U/PoKeys57U devices
 POKEYSDECL int32_t PK_SetFastUSBEnableStatus(sPoKeysDevice * device, uint32_t newState);
@@ -13,12 +13,12 @@ typedef struct {
 } I2CAsyncContext;
 
 // Simple table indexed by request ID
-static I2CAsyncContext i2c_ctx[256];
+PK_PARSER_CTX_CHECK(I2CAsyncContext);
 
 static int PK_I2C_StatusParse(sPoKeysDevice *dev, const uint8_t *resp)
 {
-    uint8_t id = resp[6];
-    I2CAsyncContext *c = &i2c_ctx[id];
+    I2CAsyncContext *c = PK_TransactionContext(dev, resp[6]);
+    if (!c) return PK_ERR_GENERIC;
     if (c->status_ptr)
         *(c->status_ptr) = resp[3];
     c->used = 0;
@@ -27,8 +27,8 @@ static int PK_I2C_StatusParse(sPoKeysDevice *dev, const uint8_t *resp)
 
 static int PK_I2C_ReadStatusParse(sPoKeysDevice *dev, const uint8_t *resp)
 {
-    uint8_t id = resp[6];
-    I2CAsyncContext *c = &i2c_ctx[id];
+    I2CAsyncContext *c = PK_TransactionContext(dev, resp[6]);
+    if (!c) return PK_ERR_GENERIC;
     if (c->status_ptr)
         *(c->status_ptr) = resp[3];
     if (c->read_bytes_ptr)
@@ -48,8 +48,8 @@ static int PK_I2C_ReadStatusParse(sPoKeysDevice *dev, const uint8_t *resp)
 
 static int PK_I2C_BusScanParse(sPoKeysDevice *dev, const uint8_t *resp)
 {
-    uint8_t id = resp[6];
-    I2CAsyncContext *c = &i2c_ctx[id];
+    I2CAsyncContext *c = PK_TransactionContext(dev, resp[6]);
+    if (!c) return PK_ERR_GENERIC;
     if (c->status_ptr)
         *(c->status_ptr) = resp[3];
     if (resp[3] == PK_I2C_STAT_COMPLETE && c->scan_results_ptr) {
@@ -77,8 +77,10 @@ int PK_I2CGetStatusAsync(sPoKeysDevice* device, uint8_t* activated)
     uint8_t params[1] = { 0x02 };
     int req = CreateRequestAsync(device, PK_CMD_I2C_COMMUNICATION, params, 1, NULL, 0, PK_I2C_StatusParse);
     if (req < 0) return req;
-    i2c_ctx[req].status_ptr = activated;
-    i2c_ctx[req].used = 1;
+    I2CAsyncContext *c = PK_TransactionContext(device, (uint8_t)req);
+    if (!c) return PK_ERR_GENERIC;
+    c->status_ptr = activated;
+    c->used = 1;
     return SendRequestAsync(device, req);
 }
 
@@ -108,8 +110,10 @@ int PK_I2CWriteStatusGetAsync(sPoKeysDevice* device, uint8_t* status)
     uint8_t params[1] = { 0x11 };
     int req = CreateRequestAsync(device, PK_CMD_I2C_COMMUNICATION, params, 1, NULL, 0, PK_I2C_StatusParse);
     if (req < 0) return req;
-    i2c_ctx[req].status_ptr = status;
-    i2c_ctx[req].used = 1;
+    I2CAsyncContext *c = PK_TransactionContext(device, (uint8_t)req);
+    if (!c) return PK_ERR_GENERIC;
+    c->status_ptr = status;
+    c->used = 1;
     return SendRequestAsync(device, req);
 }
 
@@ -129,11 +133,13 @@ int PK_I2CReadStatusGetAsync(sPoKeysDevice* device, uint8_t* status, uint8_t* iR
     uint8_t params[1] = { 0x21 };
     int req = CreateRequestAsync(device, PK_CMD_I2C_COMMUNICATION, params, 1, NULL, 0, PK_I2C_ReadStatusParse);
     if (req < 0) return req;
-    i2c_ctx[req].status_ptr = status;
-    i2c_ctx[req].read_bytes_ptr = iReadBytes;
-    i2c_ctx[req].buffer_ptr = buffer;
-    i2c_ctx[req].max_len = iMaxBufferLength;
-    i2c_ctx[req].used = 1;
+    I2CAsyncContext *c = PK_TransactionContext(device, (uint8_t)req);
+    if (!c) return PK_ERR_GENERIC;
+    c->status_ptr = status;
+    c->read_bytes_ptr = iReadBytes;
+    c->buffer_ptr = buffer;
+    c->max_len = iMaxBufferLength;
+    c->used = 1;
     return SendRequestAsync(device, req);
 }
 
@@ -153,10 +159,12 @@ int PK_I2CBusScanGetResultsAsync(sPoKeysDevice* device, uint8_t* status, uint8_t
     uint8_t params[1] = { 0x31 };
     int req = CreateRequestAsync(device, PK_CMD_I2C_COMMUNICATION, params, 1, NULL, 0, PK_I2C_BusScanParse);
     if (req < 0) return req;
-    i2c_ctx[req].status_ptr = status;
-    i2c_ctx[req].scan_results_ptr = presentDevices;
-    i2c_ctx[req].max_devices = iMaxDevices;
-    i2c_ctx[req].used = 1;
+    I2CAsyncContext *c = PK_TransactionContext(device, (uint8_t)req);
+    if (!c) return PK_ERR_GENERIC;
+    c->status_ptr = status;
+    c->scan_results_ptr = presentDevices;
+    c->max_devices = iMaxDevices;
+    c->used = 1;
     return SendRequestAsync(device, req);
 }
 
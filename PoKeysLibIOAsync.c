@@ -134,6 +134,13 @@ int export_IO_pins(const char *prefix, long comp_id, sPoKeysDevice *device)
         rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: %s.adcout.pwm.period failed\n", __FILE__, __FUNCTION__, prefix);
         return r;
     }
+
+    // Dense hot-path view of the digital pins just exported
+    r = PK_PinBankSync(device);
+    if (r != 0) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: PK_PinBankSync failed\n", __FILE__, __FUNCTION__);
+        return r;
+    }
     return r;
 }
 
@@ -422,6 +429,95 @@ int32_t PK_PinConfigurationSetAsync(sPoKeysDevice* device) {
     return PK_OK;
 }
 
+static sPoKeysPinBank pinbanks[PK_PINBANK_MAX];
+static int pinbank_count = 0;
+
+sPoKeysPinBank *PK_PinBankGet(const sPoKeysDevice *dev)
+{
+    for (int b = 0; b < pinbank_count; b++) {
+        if (pinbanks[b].dev == dev)
+            return &pinbanks[b];
+    }
+    return NULL;
+}
+
+int PK_PinBankSync(sPoKeysDevice *dev)
+{
+    if (!dev) return PK_ERR_NOT_CONNECTED;
+
+    sPoKeysPinBank *bank = PK_PinBankGet(dev);
+    if (!bank) {
+        if (pinbank_count >= PK_PINBANK_MAX) {
+            rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: pin bank table full (PK_PINBANK_MAX=%d)\n",
+                            __FILE__, __FUNCTION__, PK_PINBANK_MAX);
+            return PK_ERR_GENERIC;
+        }
+        bank = &pinbanks[pinbank_count++];
+        memset(bank, 0, sizeof(*bank));
+        bank->dev = dev;
+    }
+
+    bank->pinCount = dev->info.iPinCount < PK_PINBANK_PINS ? dev->info.iPinCount : PK_PINBANK_PINS;
+    bank->inValid = bank->outValid = bank->preventMask = 0;
+    for (uint32_t i = 0; i < bank->pinCount; i++) {
+        const sPoKeysPinData *pin = &dev->Pins[i];
+        bank->in[i]     = pin->DigitalValueGet.in;
+        bank->in_not[i] = pin->DigitalValueGet.in_not;
+        bank->out[i]    = pin->DigitalValueSet.out;
+        if (pin->DigitalValueGet.in && pin->DigitalValueGet.in_not) bank->inValid |= (uint64_t)1 << i;
+        if (pin->DigitalValueSet.out)                               bank->outValid |= (uint64_t)1 << i;
+        if (pin->preventUpdate > 0)                                 bank->preventMask |= (uint64_t)1 << i;
+    }
+    return PK_OK;
+}
+
+void PK_PinBankBuildOutputs(const sPoKeysPinBank *bank, uint8_t *payload)
+{
+    uint64_t all  = ((uint64_t)1 << bank->pinCount) - 1;   // pinCount <= 56
+    uint64_t skip = (bank->preventMask | ~bank->outValid) & all;
+    uint64_t bits = 0;
+
+    for (uint64_t m = all & ~skip; m; m &= m - 1) {
+        int i = __builtin_ctzll(m);
+        bits |= (uint64_t)(*bank->out[i] != 0) << i;
+    }
+    for (int b = 0; b < 7; b++) {
+        payload[b]      = (uint8_t)(bits >> (8 * b));
+        payload[12 + b] = (uint8_t)(skip >> (8 * b));
+    }
+}
+
+void PK_PinBankPublishInputs(const sPoKeysPinBank *bank, uint64_t bits, uint64_t changed)
+{
+    for (uint64_t m = changed & bank->inValid; m; m &= m - 1) {
+        int i = __builtin_ctzll(m);
+        hal_bit_t v = (bits >> i) & 1;
+        *bank->in[i] = v;
+        *bank->in_not[i] = !v;
+    }
+}
+
+/*
+ * 0xCC set payload from the HAL output pins: through the pin bank when one
+ * exists, otherwise by walking the Pins[] records.
+ */
+static void PK_DigitalIOBuildOutputs(sPoKeysDevice *device, uint8_t *payload)
+{
+    const sPoKeysPinBank *bank = PK_PinBankGet(device);
+    if (bank) {
+        PK_PinBankBuildOutputs(bank, payload);
+        return;
+    }
+
+    for (uint32_t i = 0; i < device->info.iPinCount && i < 56; i++) {
+        if (device->Pins[i].preventUpdate > 0) {
+            payload[12 + i / 8] |= (uint8_t)(1u << (i % 8));
+        } else if (*(device->Pins[i].DigitalValueSet.out) > 0) {
+            payload[i / 8]      |= (uint8_t)(1u << (i % 8));
+        }
+    }
+}
+
 /**
  * @brief Asynchronously sets the digital IO values.
  *
@@ -433,41 +529,13 @@ int32_t PK_PinConfigurationSetAsync(sPoKeysDevice* device) {
 int32_t PK_DigitalIOSetAsync(sPoKeysDevice* device) {
     if (!device) return PK_ERR_NOT_CONNECTED;
 
-    /* Dirty-flag state — one set of bytes per process (assumes single device).
-     * dio_out_initialized is false on the first call, forcing an unconditional send. */
-    static uint8_t last_dio_out[7]   = {0};
-    static uint8_t last_mask_out[7]  = {0};
-    static int     dio_out_initialized = 0;
-
-    uint8_t dio[7]  = {0};
-    uint8_t mask[7] = {0};
-
-    for (uint32_t i = 0; i < device->info.iPinCount && i < 56; i++) {
-        if (device->Pins[i].preventUpdate > 0) {
-            mask[i / 8] |= (uint8_t)(1u << (i % 8));
-        } else if (*(device->Pins[i].DigitalValueSet.out) > 0) {
-            dio[i / 8]  |= (uint8_t)(1u << (i % 8));
-        }
-    }
-
-    /* Skip the send if the output pattern has not changed since the last transmission */
-    if (dio_out_initialized &&
-        memcmp(dio,  last_dio_out,  7) == 0 &&
-        memcmp(mask, last_mask_out, 7) == 0) {
-        return PK_OK;
-    }
-
-    memcpy(last_dio_out,  dio,  7);
-    memcpy(last_mask_out, mask, 7);
-    dio_out_initialized = 1;
-
-    for (uint8_t i = 0; i < 7; ++i) {
-        device->request[8  + i] = dio[i];
-        device->request[20 + i] = mask[i];
-    }
+    /* Stage the payload locally - device->request belongs to the blocking API */
+    uint8_t payload[56] = {0};
+    PK_DigitalIOBuildOutputs(device, payload);
 
-    return CreateAndSendRequestAsync(device, 0xCC, (const uint8_t[]){1}, 1,
-                               device->request + 8, 56, NULL);
+    /* Only sent when the pattern differs from what the device acknowledged */
+    return PK_ShadowWriteAsync(device, PK_SHADOW_DIGITAL_OUT, 0xCC, (const uint8_t[]){1}, 1,
+                               payload, sizeof(payload), NULL);
 }
 
 /**
@@ -475,6 +543,15 @@ int32_t PK_DigitalIOSetAsync(sPoKeysDevice* device) {
  */
 int PK_DigitalIOGetParse(sPoKeysDevice* device, const uint8_t* response) {
     if (!device || !response) return PK_ERR_GENERIC;
+    if (PK_SnapshotStageDigitalInputs(device, &response[8]) == PK_OK)
+        return PK_OK;
+    const sPoKeysPinBank *bank = PK_PinBankGet(device);
+    if (bank) {
+        uint64_t bits = 0;
+        memcpy(&bits, &response[8], 7); // Little-endian: pin n = bit n
+        PK_PinBankPublishInputs(bank, bits, ~(uint64_t)0);
+        return PK_OK;
+    }
     for (uint32_t i = 0; i < device->info.iPinCount && i < 56; i++) {
         *(device->Pins[i].DigitalValueGet.in) = ((response[8 + i / 8] & (1 << (i % 8))) != 0);
         *(device->Pins[i].DigitalValueGet.in_not) = ((response[8 + i / 8] & (1 << (i % 8))) == 0);
@@ -485,10 +562,14 @@ int PK_DigitalIOGetParse(sPoKeysDevice* device, const uint8_t* response) {
 /**
  * @brief Asynchronously requests digital IO input values.
  */
+static const sPoKeysRequestTemplate tpl_digio_get =
+    PK_REQUEST_TEMPLATE(0xCC, 0, 0, 0, 0, 0, 0, PK_DigitalIOGetParse);
+static const sPoKeysRequestTemplate tpl_digio_setget =
+    PK_REQUEST_TEMPLATE(0xCC, 1, 0, 0, 0, 56, 0, PK_DigitalIOGetParse);
+
 int PK_DigitalIOGetAsync(sPoKeysDevice* device) {
     if (!device) return PK_ERR_NOT_CONNECTED;
-    return CreateAndSendRequestAsync(device, 0xCC, (const uint8_t[]){0}, 1,
-                              NULL, 0, PK_DigitalIOGetParse);
+    return PK_RequestTemplateSendAsync(device, &tpl_digio_get, NULL, 0);
 }
 
 /**
@@ -497,25 +578,11 @@ int PK_DigitalIOGetAsync(sPoKeysDevice* device) {
 int PK_DigitalIOSetGetAsync(sPoKeysDevice* device) {
     if (!device) return PK_ERR_NOT_CONNECTED;
 
-    uint8_t dio[56] = {0};
-    uint8_t mask[56] = {0};
-
-    for (uint32_t i = 0; i < device->info.iPinCount && i < 56; i++) {
-        if (device->Pins[i].preventUpdate > 0) {
-            mask[i / 8] |= (1 << (i % 8));
-        } else if (*(device->Pins[i].DigitalValueSet.out) > 0) {
-            dio[i / 8] |= (1 << (i % 8));
-        }
-    }
-
-    for (uint8_t i = 0; i < 7; ++i) {
-        device->request[8 + i] = dio[i];
-        device->request[20 + i] = mask[i];
-    }
-
-    return CreateAndSendRequestAsync(device, 0xCC, (const uint8_t[]){1}, 1,
-                               device->request + 8, 
-                                 56, PK_DigitalIOGetParse);
+    /* Build the outputs straight into the slot's zeroed template payload */
+    async_transaction_t *t = PK_RequestTemplateClaim(device, &tpl_digio_setget, NULL, 0);
+    if (!t) return -1;
+    PK_DigitalIOBuildOutputs(device, &t->request_buffer[8]);
+    return PK_TransactionSendAsync(device, t);
 }
 
 /**
@@ -526,13 +593,16 @@ int PK_AnalogIOParse(sPoKeysDevice* device, const uint8_t* response) {
     if (device->info.iAnalogInputs == 0) return PK_ERR_NOT_SUPPORTED;
 
     for (uint32_t i = 0; i < 7 && (40 + i) < device->info.iPinCount; ++i) {
-         *(device->Pins[40 + i].AnalogValue) = ((uint32_t)device->response[8 + i * 2] << 8) + (long)device->response[9 + i * 2];
+         *(device->Pins[40 + i].AnalogValue) = ((uint32_t)response[8 + i * 2] << 8) + (long)response[9 + i * 2];
 		*(device->AnalogInput[i].rawvalue) = *(device->Pins[40 + i].AnalogValue) * 4095 / device->AnalogInput[i].ReferenceVoltage;
 		*(device->AnalogInput[i].Canon.value) = *(device->AnalogInput[i].rawvalue) * device->AnalogInput[i].Canon.scale + device->AnalogInput[i].Canon.offset;
     }
     return PK_OK;
 }
 
+static const sPoKeysRequestTemplate tpl_aio =
+    PK_REQUEST_TEMPLATE(0x3A, 1, 0, 0, 0, 0, 0, PK_AnalogIOParse);
+
 /**
  * @brief Starts async request for analog inputs (CMD 0x3A, param1=1).
  */
@@ -540,8 +610,7 @@ int PK_AnalogIOGetAsync(sPoKeysDevice* device) {
     if (!device) return PK_ERR_NOT_CONNECTED;
     if (device->info.iAnalogInputs == 0) return PK_ERR_NOT_SUPPORTED;
 
-    return CreateAndSendRequestAsync(device, 0x3A, (const uint8_t[]){1}, 1,
-                              NULL, 0, PK_AnalogIOParse);
+    return PK_RequestTemplateSendAsync(device, &tpl_aio, NULL, 0);
 }
 
 /**
@@ -596,10 +665,13 @@ int PK_DigitalCounterParse(sPoKeysDevice* device, const uint8_t* response) {
     if (!device || !response) return PK_ERR_GENERIC;
     if (device->info.iDigitalCounters == 0) return PK_ERR_NOT_SUPPORTED;
 
-    for (uint32_t j = 0; j < 13; j++) {
-        uint8_t pinIndex = device->request[8 + j];
-        if (PK_IsCounterAvailable(device, pinIndex)) {
-            device->Pins[pinIndex].DigitalCounterValue = *(int32_t*)(&response[8 + j * 4]);
+    /* Counters were requested in ascending pin order (see PK_DigitalCounterGetAsync);
+     * rebuild that order instead of reading it back from device->request. */
+    uint32_t j = 0;
+    for (uint32_t i = 0; i < device->info.iPinCount && j < 13; i++) {
+        if (PK_IsCounterAvailable(device, i)) {
+            device->Pins[i].DigitalCounterValue = *(int32_t*)(&response[8 + j * 4]);
+            j++;
         }
     }
     return PK_OK;
@@ -621,7 +693,7 @@ int PK_DigitalCounterGetAsync(sPoKeysDevice* device) {
     }
     if (k == 0) return PK_OK; // no counters to query
 
-    return CreateAndSendRequestAsync(device, 0xD8, NULL, 0, pinIndices, k, PK_DigitalCounterParse);
+    return CreateAndSendRequestAsyncWithPayload(device, 0xD8, NULL, 0, pinIndices, k, PK_DigitalCounterParse);
 }
 
 /**
@@ -725,7 +797,8 @@ int PK_PWMUpdateAsync(sPoKeysDevice* device) {
     payload[35] = (uint8_t)((period >> 16) & 0xFF);
     payload[36] = (uint8_t)((period >> 24) & 0xFF);
 
-    return CreateAndSendRequestAsync(device, 0xCB, (const uint8_t[]){1, 1}, 2, payload, sizeof(payload), NULL);
+    return PK_ShadowWriteAsync(device, PK_SHADOW_PWM, 0xCB, (const uint8_t[]){1, 1}, 2,
+                               payload, sizeof(payload), NULL);
 }
 
 /**
@@ -962,7 +1035,9 @@ int PK_PoExtBusSetAsync(sPoKeysDevice* device) {
     }
 
 
-    return CreateAndSendRequestAsync(device, 0xDA, (const uint8_t[]){1, 0}, 2, payload, len, parse_PoExtBusGet);
+    if (len > 56) len = 56;
+    return PK_ShadowWriteAsync(device, PK_SHADOW_POEXTBUS, 0xDA, (const uint8_t[]){1, 0}, 2,
+                               payload, len, parse_PoExtBusGet);
 }
 
 
@@ -14,7 +14,7 @@ typedef struct {
     uint8_t used;
 } MatrixKBAsyncCtx;
 
-static MatrixKBAsyncCtx kb_ctx[256];
+PK_PARSER_CTX_CHECK(MatrixKBAsyncCtx);
 
 static int PK_MKB_ConfigParse(sPoKeysDevice *dev, const uint8_t *resp)
 {
@@ -40,8 +40,8 @@ static int PK_MKB_ConfigParse(sPoKeysDevice *dev, const uint8_t *resp)
 
 static int PK_MKB_KeyCodeParse(sPoKeysDevice *dev, const uint8_t *resp)
 {
-    uint8_t id = resp[6];
-    MatrixKBAsyncCtx *c = &kb_ctx[id];
+    MatrixKBAsyncCtx *c = PK_TransactionContext(dev, resp[6]);
+    if (!c) return PK_ERR_GENERIC;
     uint8_t blk = c->index;
     for (uint8_t k = 0; k < 16; k++) {
         dev->matrixKB.keyMappingKeyCode[blk*16 + k]     = resp[8 + k];
@@ -61,8 +61,8 @@ static int PK_MKB_KeyCodeParse(sPoKeysDevice *dev, const uint8_t *resp)
 
 static int PK_MKB_KeyCodeUpParse(sPoKeysDevice *dev, const uint8_t *resp)
 {
-    uint8_t id = resp[6];
-    MatrixKBAsyncCtx *c = &kb_ctx[id];
+    MatrixKBAsyncCtx *c = PK_TransactionContext(dev, resp[6]);
+    if (!c) return PK_ERR_GENERIC;
     uint8_t blk = c->index;
     for (uint8_t k = 0; k < 16; k++) {
         dev->matrixKB.keyMappingKeyCodeUp[blk*16 + k]     = resp[8 + k];
@@ -101,8 +101,10 @@ int PK_MatrixKBConfigurationGetAsync(sPoKeysDevice* device)
             int req = CreateRequestAsync(device, PK_CMD_MATRIX_KEYBOARD_CFG,
                                          p1, 1, NULL, 0, PK_MKB_KeyCodeParse);
             if (req < 0) return req;
-            kb_ctx[req].index = n;
-            kb_ctx[req].used = 1;
+            MatrixKBAsyncCtx *c = PK_TransactionContext(device, (uint8_t)req);
+            if (!c) return PK_ERR_GENERIC;
+            c->index = n;
+            c->used = 1;
             int r = SendRequestAsync(device, (uint8_t)req);
             if (r < 0) return r;
 
@@ -111,8 +113,10 @@ int PK_MatrixKBConfigurationGetAsync(sPoKeysDevice* device)
                 int req2 = CreateRequestAsync(device, PK_CMD_MATRIX_KEYBOARD_CFG,
                                               p2, 1, NULL, 0, PK_MKB_KeyCodeUpParse);
                 if (req2 < 0) return req2;
-                kb_ctx[req2].index = n;
-                kb_ctx[req2].used = 1;
+                MatrixKBAsyncCtx *c2 = PK_TransactionContext(device, (uint8_t)req2);
+                if (!c2) return PK_ERR_GENERIC;
+                c2->index = n;
+                c2->used = 1;
                 r = SendRequestAsync(device, (uint8_t)req2);
                 if (r < 0) return r;
             }
@@ -0,0 +1,467 @@
+#include "PoKeysLibHal.h"
+#include "PoKeysLibAsync.h"
+#include <string.h>
+#include <math.h>
+
+extern uint64_t get_current_time_us(void);
+
+/*
+ * Motion stream - credit-based PEv2 motion-buffer streaming.
+ *
+ * The device accepts at most bufferDepth slots and drains one slot per
+ * millisecond.  The stream keeps an estimate of the device level: it is
+ * drained by elapsed time and raised by the accepted count of each fill
+ * response.  A fill that is only partly accepted means the device buffer is
+ * full, which resynchronises the estimate.  Only one fill is in flight, so
+ * every response unambiguously acknowledges the slots starting at fillSeq.
+ *
+ * Fills are never retried blindly: if only the response was lost, a resend
+ * would run the same segment twice.  After a timeout the stream holds further
+ * fills until the lost one would have run out, reads the engine status and
+ * finds how many of its slots the device executed from the position reached.
+ */
+
+#define PK_MOTION_STREAM_MASK  (PK_MOTION_STREAM_SLOTS - 1)
+
+static sPoKeysMotionStream motion_streams[PK_MOTION_STREAM_MAX];
+static int motion_stream_count = 0;
+
+sPoKeysMotionStream *PK_MotionStreamGet(const sPoKeysDevice *dev)
+{
+    for (int s = 0; s < motion_stream_count; s++) {
+        if (motion_streams[s].dev == dev)
+            return &motion_streams[s];
+    }
+    return NULL;
+}
+
+static uint8_t PK_MotionStreamAxes(const sPoKeysDevice *dev)
+{
+    uint8_t axes = dev->PEv2.PulseEngineEnabled & 0x0F;
+    if (axes == 0) axes = 1;
+    if (axes > 8) axes = 8;
+    return axes;
+}
+
+/*
+ * PK_MotionStreamDrainLevel - remove the slots the device consumed since
+ * the last update from the level estimate.
+ */
+static void PK_MotionStreamDrainLevel(sPoKeysMotionStream *st, uint64_t now)
+{
+    uint64_t consumed = (now - st->levelStamp_us) / PK_MOTION_STREAM_SLOT_US;
+    if (consumed == 0) return;
+
+    st->levelStamp_us += consumed * PK_MOTION_STREAM_SLOT_US;
+    if (consumed >= st->deviceLevel) {
+        // Device ran dry while streaming
+        if (st->primed) {
+            st->underruns++;
+            st->primed = 0;
+        }
+        st->deviceLevel = 0;
+    } else {
+        st->deviceLevel -= (uint32_t)consumed;
+    }
+}
+
+// Signed pulse count of one 8-bit slot entry (bits 6:0 count, bit 7 direction)
+static inline int32_t PK_MotionStreamSlotDelta(const sPoKeysMotionStream *st, uint32_t seq, int axis)
+{
+    uint8_t b = st->slots[seq & PK_MOTION_STREAM_MASK][axis];
+    return (b & 0x80) ? -(int32_t)(b & 0x7F) : (int32_t)(b & 0x7F);
+}
+
+/*
+ * PK_MotionStreamAck - release @p count slots from acked on and advance the
+ * position they leave the device at.
+ */
+static void PK_MotionStreamAck(sPoKeysMotionStream *st, uint8_t axes, uint32_t count)
+{
+    for (uint32_t k = 0; k < count; k++) {
+        for (int i = 0; i < axes; i++)
+            st->ackedPos[i] += PK_MotionStreamSlotDelta(st, st->acked + k, i);
+    }
+    st->acked += count;
+}
+
+static void PK_MotionStreamPublish(sPoKeysMotionStream *st)
+{
+    if (st->pin_host_level)   *st->pin_host_level   = st->head - st->acked;
+    if (st->pin_device_level) *st->pin_device_level = st->deviceLevel;
+    if (st->pin_underruns)    *st->pin_underruns    = st->underruns;
+    if (st->pin_overruns)     *st->pin_overruns     = st->overruns;
+    if (st->pin_resends)      *st->pin_resends      = st->resends;
+    for (int i = 0; i < 8; i++) {
+        if (st->encoder.pin_saturations[i])
+            *st->encoder.pin_saturations[i] = st->encoder.saturations[i];
+    }
+}
+
+/*
+ * Parse callback for stream fills.  A late response that arrives while the
+ * fill is being reconciled settles it directly; anything else is counted
+ * and ignored.
+ */
+static int PK_MotionStreamFillParse(sPoKeysDevice *dev, const uint8_t *resp)
+{
+    if (!dev || !resp) return PK_ERR_GENERIC;
+    sPoKeysMotionStream *st = PK_MotionStreamGet(dev);
+    if (!st) return PK_ERR_GENERIC;
+
+    if ((!st->inFlight && !st->reconciling) || resp[6] != st->fillReqID) {
+        st->staleResponses++;
+        return PK_ERR_GENERIC;
+    }
+
+    int ret = PK_PEv2_BufferFillDecode(dev, resp);
+    if (ret != PK_OK) return ret;
+
+    uint8_t accepted = dev->PEv2.motionBufferEntriesAccepted;
+    if (accepted > st->fillCount) accepted = st->fillCount;
+
+    PK_MotionStreamDrainLevel(st, get_current_time_us());
+    PK_MotionStreamAck(st, PK_MotionStreamAxes(dev), accepted);
+    st->deviceLevel += accepted;
+    if (accepted < st->fillCount && dev->PEv2.info.bufferDepth > 0)
+        st->deviceLevel = dev->PEv2.info.bufferDepth;   // Device is full
+    if (st->deviceLevel > 0) st->primed = 1;
+
+    st->lastAccepted = accepted;
+    st->inFlight = 0;
+    st->reconciling = 0;
+    st->reconcileReqID = 0;
+    return PK_OK;
+}
+
+/*
+ * Parse callback for the reconcile status read.  The lost fill has run out
+ * by now, so the device stands at ackedPos plus the first n slots of the
+ * fill for the n it executed.  The largest matching n is taken, so a slot
+ * that may have run is never resent.
+ */
+static int PK_MotionStreamReconcileParse(sPoKeysDevice *dev, const uint8_t *resp)
+{
+    if (!dev || !resp) return PK_ERR_GENERIC;
+    sPoKeysMotionStream *st = PK_MotionStreamGet(dev);
+    if (!st) return PK_ERR_GENERIC;
+
+    if (!st->reconciling || resp[6] != st->reconcileReqID) {
+        st->staleResponses++;
+        return PK_ERR_GENERIC;
+    }
+
+    uint8_t axes = PK_MotionStreamAxes(dev);
+    int32_t pos[8], run[8];
+    for (int i = 0; i < 8; i++) {
+        const uint8_t *p = &resp[24 + i * 4];
+        pos[i] = (int32_t)((uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+                           ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+        run[i] = st->ackedPos[i];
+    }
+
+    int executed = -1;
+    for (uint32_t n = 0; n <= st->fillCount; n++) {
+        if (n > 0) {
+            for (int i = 0; i < axes; i++)
+                run[i] += PK_MotionStreamSlotDelta(st, st->fillSeq + n - 1, i);
+        }
+        int match = 1;
+        for (int i = 0; i < axes; i++)
+            match &= (run[i] == pos[i]);
+        if (match) executed = (int)n;
+    }
+
+    if (executed < 0) {
+        // Moved by something else (jog, position set); keep the slots out
+        // of the ring rather than risk running them twice
+        st->reconcileFaults++;
+        executed = st->fillCount;
+    }
+    PK_MotionStreamAck(st, axes, (uint32_t)executed);
+    if ((uint32_t)executed < st->fillCount)
+        st->resends++;
+
+    // The device ran dry while we waited; restart from its actual position
+    for (int i = 0; i < axes; i++)
+        st->ackedPos[i] = pos[i];
+    st->deviceLevel = 0;
+    st->levelStamp_us = get_current_time_us();
+    st->primed = 0;
+    st->reconciling = 0;
+    st->reconcileReqID = 0;
+    return PK_OK;
+}
+
+static const sPoKeysRequestTemplate tpl_motion_stream_status =
+    PK_REQUEST_TEMPLATE(PK_CMD_PULSE_ENGINE_V2, PEV2_CMD_GET_STATUS, 0, 0, 0, 0,
+                        PK_TEMPLATE_PEV2_TEST_BYTE, PK_MotionStreamReconcileParse);
+
+/*
+ * PK_MotionStreamReconcile - drive a timed-out fill to a verdict.  Returns
+ * PK_OK while still waiting; no fills go out until it is settled.
+ */
+static int PK_MotionStreamReconcile(sPoKeysDevice *dev, sPoKeysMotionStream *st, uint64_t now)
+{
+    if (st->reconcileReqID) {
+        if ((now - st->reconcileSent_us) < PK_MOTION_STREAM_TIMEOUT_US)
+            return PK_OK;
+        st->reconcileReqID = 0;     // Read lost as well; ask again
+    }
+    if (now < st->reconcileAt_us)
+        return PK_OK;
+
+    async_transaction_t *t = PK_RequestTemplateClaim(dev, &tpl_motion_stream_status, NULL, 0);
+    if (!t) return PK_ERR_GENERIC;
+    t->retries_left = 0;
+    st->reconcileReqID = t->request_id;
+    st->reconcileSent_us = now;
+    if (PK_TransactionSendAsync(dev, t) != 0) {
+        st->reconcileReqID = 0;
+        return PK_ERR_TRANSFER;
+    }
+    return PK_OK;
+}
+
+/* ---- Trajectory-to-pulse encoder ---- */
+
+// Absolute pulse target of a position, rounded half up
+static inline double PK_MotionEncoderTarget(double pos, double scale)
+{
+    return floor(pos * scale + 0.5);
+}
+
+void PK_MotionEncoderConfigure(sPoKeysMotionEncoder *enc, uint8_t axes, uint8_t wide, const double *scale)
+{
+    if (!enc) return;
+    enc->axes = (axes == 0) ? 1 : (axes > 8 ? 8 : axes);
+    enc->wide = wide ? 1 : 0;
+    for (int i = 0; i < 8; i++)
+        enc->scale[i] = scale ? scale[i] : 1.0;
+}
+
+void PK_MotionEncoderReset(sPoKeysMotionEncoder *enc, const double *pos)
+{
+    if (!enc) return;
+    for (int i = 0; i < 8; i++)
+        enc->emitted[i] = pos ? PK_MotionEncoderTarget(pos[i], enc->scale[i]) : 0;
+}
+
+uint32_t PK_MotionEncodeBlock(sPoKeysMotionEncoder *enc, const double *pos, uint32_t count, uint8_t *out)
+{
+    if (!enc || !pos || !out) return 0;
+
+    const int32_t limit = enc->wide ? PK_MOTION_ENC_MAX_16BIT : PK_MOTION_ENC_MAX_8BIT;
+    const double range = (double)(limit + 1);
+    double scale[8], emitted[8];
+    uint8_t *o = out;
+
+    // Work on local copies: stores through enc could alias pos, which keeps
+    // the compiler from vectorising the lanes
+    memcpy(scale, enc->scale, sizeof(scale));
+    memcpy(emitted, enc->emitted, sizeof(emitted));
+
+    for (uint32_t n = 0; n < count; n++) {
+        const double *p = &pos[n * 8];
+        int32_t delta[8];
+        uint32_t clamped[8];
+
+        // All 8 lanes, no data-dependent branches.  The delta stays in
+        // double until it is held within one step of the slot range, so a
+        // single double -> int32 conversion is enough; the bias turns the
+        // truncation into floor(), which rounds half up with the + 0.5.
+        for (int i = 0; i < 8; i++) {
+            double d = p[i] * scale[i] - emitted[i] + 0.5;
+            d = (d > range) ? range : d;
+            d = (d < -range) ? -range : d;
+            int32_t r = (int32_t)(d + PK_MOTION_ENC_BIAS) - (int32_t)PK_MOTION_ENC_BIAS;
+            int32_t c = (r > limit) ? limit : ((r < -limit) ? -limit : r);
+            clamped[i] = (c != r);
+            emitted[i] += (double)c;   // The clamped remainder stays in the next target
+            delta[i] = c;
+        }
+        for (int i = 0; i < 8; i++)
+            enc->saturations[i] += clamped[i];
+
+        for (int i = 0; i < enc->axes; i++) {
+            uint32_t mag = (uint32_t)(delta[i] < 0 ? -delta[i] : delta[i]);
+            if (enc->wide) {
+                uint16_t v = (uint16_t)(mag | (delta[i] < 0 ? 0x8000u : 0));
+                *o++ = (uint8_t)(v & 0xFF);
+                *o++ = (uint8_t)(v >> 8);
+            } else {
+                *o++ = (uint8_t)(mag | (delta[i] < 0 ? 0x80u : 0));
+            }
+        }
+    }
+    memcpy(enc->emitted, emitted, sizeof(emitted));
+    return (uint32_t)(o - out);
+}
+
+/* ---- Stream ---- */
+
+int PK_MotionStreamCreate(sPoKeysDevice *dev)
+{
+    if (!dev) return PK_ERR_NOT_CONNECTED;
+    if (PK_MotionStreamGet(dev)) return PK_OK;
+    if (motion_stream_count >= PK_MOTION_STREAM_MAX) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: stream table full (PK_MOTION_STREAM_MAX=%d)\n",
+                        __FILE__, __FUNCTION__, PK_MOTION_STREAM_MAX);
+        return PK_ERR_GENERIC;
+    }
+
+    sPoKeysMotionStream *st = &motion_streams[motion_stream_count++];
+    memset(st, 0, sizeof(*st));
+    st->dev = dev;
+    for (int i = 0; i < 8; i++) st->ackedPos[i] = dev->PEv2.CurrentPosition[i];
+    PK_MotionEncoderConfigure(&st->encoder, 8, 0, NULL);
+    return PK_OK;
+}
+
+void PK_MotionStreamReset(sPoKeysDevice *dev)
+{
+    sPoKeysMotionStream *st = PK_MotionStreamGet(dev);
+    if (!st) return;
+
+    st->acked = st->head;
+    st->inFlight = 0;
+    st->reconciling = 0;
+    st->reconcileReqID = 0;
+    st->deviceLevel = 0;
+    st->primed = 0;
+    for (int i = 0; i < 8; i++) st->ackedPos[i] = dev->PEv2.CurrentPosition[i];
+    PK_MotionStreamPublish(st);
+}
+
+int PK_MotionStreamPush(sPoKeysDevice *dev, const uint8_t *entries)
+{
+    sPoKeysMotionStream *st = PK_MotionStreamGet(dev);
+    if (!st || !entries) return PK_ERR_PARAMETER;
+
+    if ((st->head - st->acked) >= PK_MOTION_STREAM_SLOTS) {
+        st->overruns++;
+        return PK_ERR_GENERIC;
+    }
+
+    memcpy(st->slots[st->head & PK_MOTION_STREAM_MASK], entries, PK_MotionStreamAxes(dev));
+    st->head++;
+    return PK_OK;
+}
+
+int PK_MotionStreamService(sPoKeysDevice *dev)
+{
+    sPoKeysMotionStream *st = PK_MotionStreamGet(dev);
+    if (!st) return PK_ERR_PARAMETER;
+
+    uint64_t now = get_current_time_us();
+    if (st->levelStamp_us == 0) st->levelStamp_us = now;
+    PK_MotionStreamDrainLevel(st, now);
+
+    if (st->inFlight) {
+        if ((now - st->fillSent_us) < PK_MOTION_STREAM_TIMEOUT_US) {
+            PK_MotionStreamPublish(st);
+            return PK_OK;
+        }
+        // The fill may have run even though its response was lost; hold
+        // further fills until it would have run out, then read back
+        st->inFlight = 0;
+        st->reconciling = 1;
+        st->reconcileReqID = 0;
+        st->reconcileAt_us = st->fillSent_us + PK_MOTION_STREAM_SETTLE_US +
+            (uint64_t)(st->fillLevel + st->fillCount) * PK_MOTION_STREAM_SLOT_US;
+    }
+
+    if (st->reconciling) {
+        int ret = PK_MotionStreamReconcile(dev, st, now);
+        PK_MotionStreamPublish(st);
+        return ret;
+    }
+
+    uint8_t axes = PK_MotionStreamAxes(dev);
+    uint32_t count = st->head - st->acked;
+    uint32_t perPacket = PK_MULTIPART_DATA_SIZE / axes;
+    if (perPacket > 255) perPacket = 255;
+    if (count > perPacket) count = perPacket;
+
+    uint32_t depth = dev->PEv2.info.bufferDepth;
+    if (depth > 0) {
+        uint32_t credits = (st->deviceLevel < depth) ? depth - st->deviceLevel : 0;
+        if (count > credits) count = credits;
+    }
+
+    int result = PK_OK;
+    if (count > 0) {
+        // Backlogs that do not fit one packet go out as a 448-byte multipart fill
+        uint8_t payload[PK_MULTIPART_DATA_SIZE];
+        int large = (count * axes > 56);
+        memset(payload, 0, large ? sizeof(payload) : 56);
+        for (uint32_t k = 0; k < count; k++)
+            memcpy(&payload[k * axes], st->slots[(st->acked + k) & PK_MOTION_STREAM_MASK], axes);
+
+        int req = large
+            ? PK_PEv2_BufferFillLargeRequestCreateAsync(dev, payload, (uint8_t)count, PK_MotionStreamFillParse)
+            : PK_PEv2_BufferFillRequestCreateAsync(dev, payload, (uint8_t)count, PK_MotionStreamFillParse);
+        async_transaction_t *t = (req > 0) ? transaction_find(dev, (uint8_t)req) : NULL;
+        if (req < 0) {
+            result = req;
+        } else if (!t) {
+            result = PK_ERR_GENERIC;
+        } else {
+            t->retries_left = 0;    // Lost fills are reconciled, never resent blindly
+            st->fillReqID = (uint8_t)req;
+            st->fillSeq = st->acked;
+            st->fillCount = (uint8_t)count;
+            st->fillLevel = st->deviceLevel;
+            st->fillSent_us = now;
+            st->inFlight = 1;
+            if (SendRequestAsync(dev, (uint8_t)req) != 0) {
+                st->inFlight = 0;
+                result = PK_ERR_TRANSFER;
+            }
+        }
+    }
+
+    PK_MotionStreamPublish(st);
+    return result;
+}
+
+int export_motion_stream_pins(const char *prefix, long comp_id, sPoKeysDevice *dev)
+{
+    int r;
+    sPoKeysMotionStream *st = PK_MotionStreamGet(dev);
+
+    if (st == NULL) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: no motion stream for device\n", __FILE__, __FUNCTION__);
+        return -1;
+    }
+
+    r = hal_pin_u32_newf(HAL_OUT, &(st->pin_host_level), comp_id, "%s.PEv2.motion-buf-host-level", prefix);
+    if (r != 0) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: %s.PEv2.motion-buf-host-level failed\n", __FILE__, __FUNCTION__, prefix);
+        return r;
+    }
+
+    r = hal_pin_u32_newf(HAL_OUT, &(st->pin_device_level), comp_id, "%s.PEv2.motion-buf-device-level", prefix);
+    if (r != 0) return r;
+
+    r = hal_pin_u32_newf(HAL_OUT, &(st->pin_underruns), comp_id, "%s.PEv2.motion-buf-underruns", prefix);
+    if (r != 0) return r;
+
+    r = hal_pin_u32_newf(HAL_OUT, &(st->pin_overruns), comp_id, "%s.PEv2.motion-buf-overruns", prefix);
+    if (r != 0) return r;
+
+    r = hal_pin_u32_newf(HAL_OUT, &(st->pin_resends), comp_id, "%s.PEv2.motion-buf-resends", prefix);
+    if (r != 0) return r;
+
+    for (int i = 0; i < 8; i++) {
+        r = hal_pin_u32_newf(HAL_OUT, &(st->encoder.pin_saturations[i]), comp_id,
+                             "%s.PEv2.%01d.motion-buf-saturations", prefix, i);
+        if (r != 0) {
+            rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: %s.PEv2.%01d.motion-buf-saturations failed\n", __FILE__, __FUNCTION__, prefix, i);
+            return r;
+        }
+    }
+
+    PK_MotionStreamPublish(st);
+    return 0;
+}
@@ -43,15 +43,14 @@ static int PK_PoNET_ModuleLightParse(sPoKeysDevice *dev, const uint8_t *resp)
     return PK_OK;
 }
 
+static const sPoKeysRequestTemplate tpl_ponet_status =
+    PK_REQUEST_TEMPLATE(PK_CMD_POI2C_COMMUNICATION, PONET_OP_GET_STATUS, 0, 0, 0, 0, 0,
+                        PK_PoNET_StatusParse);
+
 int PK_PoNETGetPoNETStatusAsync(sPoKeysDevice* device)
 {
     if (!device) return PK_ERR_NOT_CONNECTED;
-    uint8_t params[1] = { PONET_OP_GET_STATUS };
-    int req = CreateRequestAsync(device, PK_CMD_POI2C_COMMUNICATION,
-                                 params, 1, NULL, 0,
-                                 PK_PoNET_StatusParse);
-    if (req < 0) return req;
-    return SendRequestAsync(device, req);
+    return PK_RequestTemplateSendAsync(device, &tpl_ponet_status, NULL, 0);
 }
 
 int PK_PoNETGetModuleSettingsAsync(sPoKeysDevice* device)
@@ -77,15 +76,14 @@ int PK_PoNETGetModuleStatusRequestAsync(sPoKeysDevice* device)
     return SendRequestAsync(device, req);
 }
 
+static const sPoKeysRequestTemplate tpl_ponet_module_status =
+    PK_REQUEST_TEMPLATE(PK_CMD_POI2C_COMMUNICATION, PONET_OP_GET_MODULE_DATA, 0x30, 0, 0, 0, 0,
+                        PK_PoNET_ModuleStatusParse);
+
 int PK_PoNETGetModuleStatusAsync(sPoKeysDevice* device)
 {
     if (!device) return PK_ERR_NOT_CONNECTED;
-    uint8_t params[2] = { PONET_OP_GET_MODULE_DATA, 0x30 };
-    int req = CreateRequestAsync(device, PK_CMD_POI2C_COMMUNICATION,
-                                 params, 2, NULL, 0,
-                                 PK_PoNET_ModuleStatusParse);
-    if (req < 0) return req;
-    return SendRequestAsync(device, req);
+    return PK_RequestTemplateSendAsync(device, &tpl_ponet_module_status, NULL, 0);
 }
 
 int PK_PoNETSetModuleStatusAsync(sPoKeysDevice* device)
@@ -93,12 +91,8 @@ int PK_PoNETSetModuleStatusAsync(sPoKeysDevice* device)
     if (!device) return PK_ERR_NOT_CONNECTED;
     uint8_t params[2] = { PONET_OP_SET_MODULE_DATA,
                           device->PoNETmodule.moduleID };
-    int req = CreateRequestAsyncWithPayload(device, PK_CMD_POI2C_COMMUNICATION,
-                                            params, 2,
-                                            device->PoNETmodule.statusOut, 16,
-                                            NULL);
-    if (req < 0) return req;
-    return SendRequestAsync(device, req);
+    return PK_ShadowWriteAsync(device, PK_SHADOW_PONET_STATUS, PK_CMD_POI2C_COMMUNICATION,
+                               params, 2, device->PoNETmodule.statusOut, 16, NULL);
 }
 
 int PK_PoNETSetModulePWMAsync(sPoKeysDevice* device)
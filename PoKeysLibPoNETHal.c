@@ -27,6 +27,9 @@
 #include "hal.h"
 #include "PoKeysLibHal.h"
 #include "PoKeysLibAsync.h"
+#include <string.h>
+
+extern uint64_t get_current_time_us(void);
 
 /**
  * @brief Update PoNET HAL pins from device data.
@@ -40,10 +43,16 @@ POKEYSDECL void update_ponet_hal_pins(sPoKeysDevice *device)
 {
     if (!device) return;
     
-    // Copy statusIn array from device to HAL (hardware to HAL)
-    for (int i = 0; i < 16; i++) {
-        if (device->PoNETmodule.statusIn_pins[i]) {
-            *(device->PoNETmodule.statusIn_pins[i]) = device->PoNETmodule.statusIn[i];
+    // Copy statusIn array from device to HAL (hardware to HAL), changed bytes only
+    for (int b = 0; b < 2; b++) {
+        uint64_t bits = 0;
+        memcpy(&bits, &device->PoNETmodule.statusIn[b * 8], 8);
+        uint64_t changed = PK_BitBankUpdate(&device->PoNETmodule.statusInBank[b], bits, 64,
+                                            get_current_time_us());
+        for (int k = 0; k < 8; k++) {
+            int i = b * 8 + k;
+            if (((changed >> (k * 8)) & 0xFF) && device->PoNETmodule.statusIn_pins[i])
+                *(device->PoNETmodule.statusIn_pins[i]) = device->PoNETmodule.statusIn[i];
         }
     }
     
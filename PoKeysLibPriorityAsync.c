@@ -0,0 +1,197 @@
+#include "PoKeysLibHal.h"
+#include "PoKeysLibAsync.h"
+#include <string.h>
+
+extern uint64_t get_current_time_us(void);
+
+/*
+ * Priority lane - event-driven fast path for e-stop and external outputs.
+ *
+ * The lane samples its pins every servo cycle and sends on an edge right
+ * away, using the reserved transaction slots so it cannot be starved by
+ * ordinary traffic.  The e-stop has a slot of its own, so an output update
+ * can never supersede it or cut its redundant copies short.  Requests are idempotent (set state, set outputs), so
+ * redundant copies are simply the same packet sent again.
+ */
+
+static sPoKeysPriorityLane priority_lanes[PK_PRIORITY_LANE_MAX];
+static int priority_lane_count = 0;
+
+sPoKeysPriorityLane *PK_PriorityLaneGet(const sPoKeysDevice *dev)
+{
+    for (int l = 0; l < priority_lane_count; l++) {
+        if (priority_lanes[l].dev == dev)
+            return &priority_lanes[l];
+    }
+    return NULL;
+}
+
+int PK_PriorityLaneCreate(sPoKeysDevice *dev)
+{
+    if (!dev) return PK_ERR_NOT_CONNECTED;
+    if (PK_PriorityLaneGet(dev)) return PK_OK;
+    if (priority_lane_count >= PK_PRIORITY_LANE_MAX) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: lane table full (PK_PRIORITY_LANE_MAX=%d)\n",
+                        __FILE__, __FUNCTION__, PK_PRIORITY_LANE_MAX);
+        return PK_ERR_GENERIC;
+    }
+
+    sPoKeysPriorityLane *lane = &priority_lanes[priority_lane_count++];
+    memset(lane, 0, sizeof(*lane));
+    lane->dev = dev;
+    return PK_OK;
+}
+
+static int PK_PEv2_EmergencyStopRequestCreate(sPoKeysDevice *dev)
+{
+    dev->PEv2.PulseEngineStateSetup = PK_PEState_peSTOPPED;
+    return CreateRequestAsyncEstop(dev, PK_CMD_PULSE_ENGINE_V2,
+                                   (const uint8_t[]){PEV2_CMD_SET_STATE, PK_PEState_peSTOPPED,
+                                                     dev->PEv2.LimitOverrideSetup,
+                                                     dev->PEv2.AxisEnabledMask}, 4,
+                                   NULL, 0, NULL);
+}
+
+int PK_PEv2_EmergencyStopPriorityAsync(sPoKeysDevice *dev)
+{
+    if (!dev) return PK_ERR_NOT_CONNECTED;
+    int req = PK_PEv2_EmergencyStopRequestCreate(dev);
+    if (req < 0) return req;
+    return PK_TransactionSendAsync(dev, PK_PriorityTransactionFind(dev, (uint8_t)req));
+}
+
+/*
+ * PK_PriorityLaneSend - send a prepared lane request and schedule its
+ * redundant copies.
+ */
+static int PK_PriorityLaneSend(sPoKeysPriorityLane *lane, int slot, int req, uint64_t cycle_start_us)
+{
+    async_transaction_t *t = (req > 0) ? PK_PriorityTransactionFind(lane->dev, (uint8_t)req) : NULL;
+    if (!t || PK_TransactionSendAsync(lane->dev, t) != 0) {
+        lane->copiesLeft[slot] = 0;
+        lane->sendErrors++;
+        return PK_ERR_TRANSFER;
+    }
+
+    uint64_t now = get_current_time_us();
+    uint32_t copies = lane->pin_copies ? *lane->pin_copies : 1;
+    uint32_t spacing = lane->pin_copy_spacing_us ? *lane->pin_copy_spacing_us : 0;
+
+    lane->trans[slot] = t;
+    lane->reqID[slot] = (uint8_t)req;
+    lane->copiesLeft[slot] = (copies > 1) ? (uint8_t)((copies > 8 ? 8 : copies) - 1) : 0;
+    lane->nextCopy_us[slot] = now + spacing;
+    lane->edges++;
+
+    if (lane->pin_latency_us)
+        *lane->pin_latency_us = (now > cycle_start_us) ? (hal_u32_t)(now - cycle_start_us) : 0;
+    return PK_OK;
+}
+
+int PK_PriorityLaneService(sPoKeysDevice *dev, uint64_t cycle_start_us)
+{
+    sPoKeysPriorityLane *lane = PK_PriorityLaneGet(dev);
+    if (!lane) return PK_ERR_PARAMETER;
+    sPoKeysPEv2 *pev2 = &dev->PEv2;
+
+    uint8_t estop = (lane->pin_estop_request && *lane->pin_estop_request) ? 1 : 0;
+    uint8_t relay = 0, oc = 0;
+    for (int i = 0; i < 4; i++) {
+        if (pev2->pin_digout_ExternalRelay_out[i] && *pev2->pin_digout_ExternalRelay_out[i])
+            relay |= (uint8_t)(1u << i);
+        if (pev2->pin_digout_ExternalOC_out[i] && *pev2->pin_digout_ExternalOC_out[i])
+            oc |= (uint8_t)(1u << i);
+    }
+
+    int result = PK_OK;
+    if (lane->primed) {
+        // E-stop first: it must not queue behind the output update
+        if (estop && !lane->estopPrev)
+            result = PK_PriorityLaneSend(lane, PK_PRIORITY_ESTOP,
+                                         PK_PEv2_EmergencyStopRequestCreate(dev), cycle_start_us);
+
+        if (relay != lane->relayPrev || oc != lane->ocPrev) {
+            pev2->ExternalRelayOutputs = relay;
+            pev2->ExternalOCOutputs = oc;
+            if (pev2->pin_ExternalRelayOutputs) *pev2->pin_ExternalRelayOutputs = relay;
+            if (pev2->pin_ExternalOCOutputs)    *pev2->pin_ExternalOCOutputs    = oc;
+
+            uint8_t payload[2] = { relay, oc };
+            int req = CreateRequestAsyncPriority(dev, PK_CMD_PULSE_ENGINE_V2,
+                                                 (const uint8_t[]){PEV2_CMD_SET_OUTPUTS}, 1,
+                                                 payload, sizeof(payload), NULL);
+            if (PK_PriorityLaneSend(lane, PK_PRIORITY_OUTPUTS, req, cycle_start_us) != PK_OK)
+                result = PK_ERR_TRANSFER;
+        }
+    }
+    lane->primed = 1;
+    lane->estopPrev = estop;
+    lane->relayPrev = relay;
+    lane->ocPrev = oc;
+
+    // Redundant copies that are due
+    uint64_t now = get_current_time_us();
+    uint32_t spacing = lane->pin_copy_spacing_us ? *lane->pin_copy_spacing_us : 0;
+    for (int slot = 0; slot < PK_PRIORITY_REQUESTS; slot++) {
+        if (lane->copiesLeft[slot] == 0 || now < lane->nextCopy_us[slot]) continue;
+        // Resend the slot itself: the response may already have completed
+        // it, and the ID alone could match an unrelated slot after a wrap
+        async_transaction_t *t = lane->trans[slot];
+        if (t->request_id != lane->reqID[slot]) {
+            lane->copiesLeft[slot] = 0; // Slot was superseded
+            continue;
+        }
+        if (PK_TransactionSendAsync(dev, t) != 0) {
+            lane->sendErrors++;
+            lane->copiesLeft[slot] = 0;
+            continue;
+        }
+        lane->copiesLeft[slot]--;
+        lane->nextCopy_us[slot] = now + spacing;
+    }
+
+    if (lane->pin_edges)       *lane->pin_edges       = lane->edges;
+    if (lane->pin_send_errors) *lane->pin_send_errors = lane->sendErrors;
+    return result;
+}
+
+int export_priority_lane_pins(const char *prefix, long comp_id, sPoKeysDevice *dev)
+{
+    int r;
+    sPoKeysPriorityLane *lane = PK_PriorityLaneGet(dev);
+
+    if (lane == NULL) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: no priority lane for device\n", __FILE__, __FUNCTION__);
+        return -1;
+    }
+
+    r = hal_pin_bit_newf(HAL_IN, &(lane->pin_estop_request), comp_id, "%s.PEv2.estop-request", prefix);
+    if (r != 0) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: %s.PEv2.estop-request failed\n", __FILE__, __FUNCTION__, prefix);
+        return r;
+    }
+
+    r = hal_pin_u32_newf(HAL_IN, &(lane->pin_copies), comp_id, "%s.PEv2.priority-copies", prefix);
+    if (r != 0) return r;
+
+    r = hal_pin_u32_newf(HAL_IN, &(lane->pin_copy_spacing_us), comp_id, "%s.PEv2.priority-copy-spacing-us", prefix);
+    if (r != 0) return r;
+
+    r = hal_pin_u32_newf(HAL_OUT, &(lane->pin_latency_us), comp_id, "%s.PEv2.priority-latency-us", prefix);
+    if (r != 0) return r;
+
+    r = hal_pin_u32_newf(HAL_OUT, &(lane->pin_edges), comp_id, "%s.PEv2.priority-edges", prefix);
+    if (r != 0) return r;
+
+    r = hal_pin_u32_newf(HAL_OUT, &(lane->pin_send_errors), comp_id, "%s.PEv2.priority-send-errors", prefix);
+    if (r != 0) return r;
+
+    *(lane->pin_estop_request) = 0;
+    *(lane->pin_copies) = 3;
+    *(lane->pin_copy_spacing_us) = 200;
+    *(lane->pin_latency_us) = 0;
+    *(lane->pin_edges) = 0;
+    *(lane->pin_send_errors) = 0;
+
+    return 0;
+}
@@ -1,10 +1,21 @@
 #include "PoKeysLibHal.h"
 #include "PoKeysLibAsync.h"
+#include "PoKeysLibCoreSocketsAsync.h"
 #include <math.h>
 #include <stdint.h>
+#include <string.h>
 
-// Forward declaration for transaction_find function
-async_transaction_t* transaction_find(uint8_t request_id);
+extern uint64_t get_current_time_us(void);
+
+// Samples further apart than this are not used for velocity estimation
+#define PEV2_FB_VELOCITY_MAX_DT_US 100000
+
+// A piggybacked status younger than this replaces the next 100 Hz status poll
+#define PEV2_STATUS_FRESH_US 10000
+
+// Wait before the first retry of an unconfirmed SET_STATE; doubled per retry
+#define PEV2_STATE_ATTEMPT_US 20000
+#define PEV2_STATE_BACKOFF_MAX_US 160000
 
 /*
  * Asynchronous helpers for Pulse Engine v2 configuration and status.
@@ -28,12 +39,34 @@ static void PK_PEv2_DecodeStatusFromResp(sPoKeysDevice *dev, const uint8_t *ans)
     dev->PEv2.LimitStatusN = ans[13];
     dev->PEv2.HomeStatus = ans[14];
     memcpy(dev->PEv2.AxesState, ans + 16, 8);
+
+    /*
+     * Timestamp the sample halfway between request send and response
+     * arrival.  The transaction is still pending while its parser runs,
+     * so the send time can be looked up by request ID.
+     */
+    uint64_t now = get_current_time_us();
+    uint64_t sampled = now;
+    async_transaction_t *t = transaction_find(dev, ans[6]);
+    if (t && t->timestamp_sent && t->timestamp_sent <= now)
+        sampled = t->timestamp_sent + (now - t->timestamp_sent) / 2;
+
+    uint64_t dt = (dev->PEv2.fbSample_us && sampled > dev->PEv2.fbSample_us)
+                  ? sampled - dev->PEv2.fbSample_us : 0;
+    dev->PEv2.fbPrevSample_us = dev->PEv2.fbSample_us;
+    dev->PEv2.fbSample_us = sampled;
+
     for (int i = 0; i < 8; i++) {
+        int32_t prev = dev->PEv2.CurrentPosition[i];
         dev->PEv2.CurrentPosition[i] =
             ((int32_t)ans[24 + i * 4]) |
             ((int32_t)ans[25 + i * 4] << 8) |
             ((int32_t)ans[26 + i * 4] << 16) |
             ((int32_t)ans[27 + i * 4] << 24);
+        dev->PEv2.fbPrevPosition[i] = prev;
+        dev->PEv2.fbVelocity[i] = (dt > 0 && dt < PEV2_FB_VELOCITY_MAX_DT_US)
+            ? (double)(dev->PEv2.CurrentPosition[i] - prev) * 1e6 / (double)dt
+            : 0.0;
     }
     dev->PEv2.info.nrOfAxes = ans[56];
     dev->PEv2.info.maxPulseFrequency = ans[57];
@@ -74,11 +107,17 @@ static int PK_PEv2_AdditionalParamsParse(sPoKeysDevice *dev, const uint8_t *resp
     return PK_OK;
 }
 
+/*
+ * The axis index is taken from the request that produced the response
+ * (byte 3), so several axis reads can be in flight at once.
+ */
 static int PK_PEv2_AxisConfigParse(sPoKeysDevice *dev, const uint8_t *resp)
 {
     if (!dev || !resp) return PK_ERR_GENERIC;
     sPoKeysPEv2 *pe = &dev->PEv2;
-    uint8_t ax = pe->param1;
+    async_transaction_t *t = transaction_find(dev, resp[6]);
+    uint8_t ax = t ? t->request_buffer[3] : pe->param1;
+    if (ax >= 8) return PK_ERR_PARAMETER;
     pe->AxesConfig[ax] = resp[8];
     pe->AxesSwitchConfig[ax] = resp[9];
     pe->PinHomeSwitch[ax] = resp[10];
@@ -106,6 +145,38 @@ static int PK_PEv2_AxisConfigParse(sPoKeysDevice *dev, const uint8_t *resp)
     return PK_OK;
 }
 
+/*
+ * PK_PEv2_StatusDecode - verify the request-id checksum of a GET_STATUS
+ * response and decode it into device->PEv2.*.  Exposed for callers that
+ * collect status responses themselves (e.g. device groups).
+ */
+int PK_PEv2_StatusDecode(sPoKeysDevice *dev, const uint8_t *resp)
+{
+    return PK_PEv2_StatusParse(dev, resp);
+}
+
+/*
+ * PK_PEv2_StatusRequestCreateAsync - prepare (but do not send) a GET_STATUS
+ * request with the request-id checksum the device expects.
+ * Returns the request ID, or a negative error code.
+ */
+int PK_PEv2_StatusRequestCreateAsync(sPoKeysDevice *device, pokeys_response_parser_t parser)
+{
+    if (!device) return PK_ERR_NOT_CONNECTED;
+    int req = CreateRequestAsync(device, PK_CMD_PULSE_ENGINE_V2,
+                                 (const uint8_t[]){PEV2_CMD_GET_STATUS, 0}, 2,
+                                 NULL, 0, parser);
+    if (req < 0) return req;
+    async_transaction_t *t = transaction_find(device, req);
+    if (!t) return PK_ERR_GENERIC;
+    uint8_t tstB = (0x10 + req) % 199;
+    t->request_buffer[3] = tstB;
+    uint8_t cs = 0;
+    for (int i = 0; i <= 6; i++) cs += t->request_buffer[i];
+    t->request_buffer[7] = cs;
+    return req;
+}
+
 int PK_PEv2_StatusGetAsync(sPoKeysDevice *device)
 {
     if (!device) return PK_ERR_NOT_CONNECTED;
@@ -113,7 +184,7 @@ int PK_PEv2_StatusGetAsync(sPoKeysDevice *device)
                                  (const uint8_t[]){PEV2_CMD_GET_STATUS,0}, 2,
                                  NULL, 0, PK_PEv2_StatusParse);
     if (req < 0) return req;
-    async_transaction_t *t = transaction_find(req);
+    async_transaction_t *t = transaction_find(device, req);
     if (!t) return PK_ERR_GENERIC;
     uint8_t tstB = (0x10 + req) % 199;
     t->request_buffer[3] = tstB;
@@ -183,37 +254,43 @@ int PK_PEv2_AxisConfigurationGetAsync(sPoKeysDevice *device)
     return SendRequestAsync(device, req);
 }
 
+static void PK_PEv2_AxisConfigPayload(const sPoKeysPEv2 *pe, uint8_t ax, uint8_t *payload)
+{
+    memset(payload, 0, 45);
+    payload[0] = pe->AxesConfig[ax];
+    payload[1] = pe->AxesSwitchConfig[ax];
+    payload[2] = pe->PinHomeSwitch[ax];
+    payload[3] = pe->PinLimitMSwitch[ax];
+    payload[4] = pe->PinLimitPSwitch[ax];
+    payload[5] = pe->HomingSpeed[ax];
+    payload[6] = pe->HomingReturnSpeed[ax];
+    payload[7] = pe->MPGjogEncoder[ax];
+    *(float*)(payload + 8)  = pe->MaxSpeed[ax];
+    *(float*)(payload + 12) = pe->MaxAcceleration[ax];
+    *(float*)(payload + 16) = pe->MaxDecceleration[ax];
+    *(int32_t*)(payload + 20) = pe->SoftLimitMinimum[ax];
+    *(int32_t*)(payload + 24) = pe->SoftLimitMaximum[ax];
+    *(int16_t*)(payload + 28) = (int16_t)pe->MPGjogMultiplier[ax];
+    payload[30] = pe->AxisEnableOutputPins[ax];
+    payload[31] = pe->InvertAxisEnable[ax];
+    payload[32] = pe->FilterLimitMSwitch[ax];
+    payload[33] = pe->FilterLimitPSwitch[ax];
+    payload[34] = pe->FilterHomeSwitch[ax];
+    payload[35] = pe->HomingAlgorithm[ax];
+    payload[36] = 0;
+    *(uint32_t*)(payload + 37) = pe->HomeBackOffDistance[ax];
+    *(uint16_t*)(payload + 41) = pe->MPGjogDivider[ax];
+    payload[43] = pe->AxisSignalOptions[ax];
+    payload[44] = pe->FilterProbeInput;
+}
+
 int PK_PEv2_AxisConfigurationSetAsync(sPoKeysDevice *device)
 {
     if (!device) return PK_ERR_NOT_CONNECTED;
     if (device->PEv2.param1 >= 8) return PK_ERR_PARAMETER;
     sPoKeysPEv2 *pe = &device->PEv2;
-    uint8_t payload[45] = {0};
-    payload[0] = pe->AxesConfig[pe->param1];
-    payload[1] = pe->AxesSwitchConfig[pe->param1];
-    payload[2] = pe->PinHomeSwitch[pe->param1];
-    payload[3] = pe->PinLimitMSwitch[pe->param1];
-    payload[4] = pe->PinLimitPSwitch[pe->param1];
-    payload[5] = pe->HomingSpeed[pe->param1];
-    payload[6] = pe->HomingReturnSpeed[pe->param1];
-    payload[7] = pe->MPGjogEncoder[pe->param1];
-    *(float*)(payload + 8)  = pe->MaxSpeed[pe->param1];
-    *(float*)(payload + 12) = pe->MaxAcceleration[pe->param1];
-    *(float*)(payload + 16) = pe->MaxDecceleration[pe->param1];
-    *(int32_t*)(payload + 20) = pe->SoftLimitMinimum[pe->param1];
-    *(int32_t*)(payload + 24) = pe->SoftLimitMaximum[pe->param1];
-    *(int16_t*)(payload + 28) = (int16_t)pe->MPGjogMultiplier[pe->param1];
-    payload[30] = pe->AxisEnableOutputPins[pe->param1];
-    payload[31] = pe->InvertAxisEnable[pe->param1];
-    payload[32] = pe->FilterLimitMSwitch[pe->param1];
-    payload[33] = pe->FilterLimitPSwitch[pe->param1];
-    payload[34] = pe->FilterHomeSwitch[pe->param1];
-    payload[35] = pe->HomingAlgorithm[pe->param1];
-    payload[36] = 0;
-    *(uint32_t*)(payload + 37) = pe->HomeBackOffDistance[pe->param1];
-    *(uint16_t*)(payload + 41) = pe->MPGjogDivider[pe->param1];
-    payload[43] = pe->AxisSignalOptions[pe->param1];
-    payload[44] = pe->FilterProbeInput;
+    uint8_t payload[45];
+    PK_PEv2_AxisConfigPayload(pe, pe->param1, payload);
     int req = CreateRequestAsyncWithPayload(device, PK_CMD_PULSE_ENGINE_V2,
                                             (const uint8_t[]){PEV2_CMD_SET_AXIS_CONFIGURATION, pe->param1}, 2,
                                             payload, sizeof(payload), NULL);
@@ -221,6 +298,177 @@ int PK_PEv2_AxisConfigurationSetAsync(sPoKeysDevice *device)
     return SendRequestAsync(device, req);
 }
 
+static int PK_PEv2_BacklashParse(sPoKeysDevice *dev, const uint8_t *resp)
+{
+    if (!dev || !resp) return PK_ERR_GENERIC;
+    sPoKeysPEv2 *pe = &dev->PEv2;
+    for (int i = 0; i < 8; i++) {
+        pe->BacklashWidth[i] = *(uint16_t*)(resp + 8 + i * 4);
+        pe->BacklashAcceleration[i] = resp[10 + i * 4];
+        pe->BacklashRegister[i] = *(int16_t*)(resp + 40 + i * 2);
+    }
+    pe->BacklashCompensationEnabled = resp[3];
+    pe->BacklashCompensationMaxSpeed = resp[4];
+    return PK_OK;
+}
+
+static int PK_PEv2_BacklashGetRequestCreate(sPoKeysDevice *device, pokeys_response_parser_t parser)
+{
+    return CreateRequestAsync(device, PK_CMD_PULSE_ENGINE_V2,
+                              (const uint8_t[]){PEV2_CMD_GET_BACKLASH_SETTINGS}, 1,
+                              NULL, 0, parser);
+}
+
+static int PK_PEv2_BacklashSetRequestCreate(sPoKeysDevice *device, pokeys_response_parser_t parser)
+{
+    sPoKeysPEv2 *pe = &device->PEv2;
+    uint8_t payload[32] = {0};
+    for (int i = 0; i < 8; i++) {
+        *(uint16_t*)(payload + i * 4) = pe->BacklashWidth[i];
+        payload[2 + i * 4] = pe->BacklashAcceleration[i];
+    }
+    return CreateRequestAsyncWithPayload(device, PK_CMD_PULSE_ENGINE_V2,
+                                         (const uint8_t[]){PEV2_CMD_SET_BACKLASH_SETTINGS,
+                                                           pe->BacklashCompensationEnabled,
+                                                           pe->BacklashCompensationMaxSpeed}, 3,
+                                         payload, sizeof(payload), parser);
+}
+
+int PK_PEv2_BacklashCompensationSettingsGetAsync(sPoKeysDevice *device)
+{
+    if (!device) return PK_ERR_NOT_CONNECTED;
+    int req = PK_PEv2_BacklashGetRequestCreate(device, PK_PEv2_BacklashParse);
+    if (req < 0) return req;
+    return SendRequestAsync(device, req);
+}
+
+int PK_PEv2_BacklashCompensationSettingsSetAsync(sPoKeysDevice *device)
+{
+    if (!device) return PK_ERR_NOT_CONNECTED;
+    int req = PK_PEv2_BacklashSetRequestCreate(device, NULL);
+    if (req < 0) return req;
+    return SendRequestAsync(device, req);
+}
+
+/* -----------------------------------------------------------------------
+ * Bulk configuration transfer
+ *
+ * All ten requests (8 axes, additional parameters, backlash) are created
+ * first and then sent back to back, so the transfer costs about one RTT
+ * instead of ten.  Each response is matched to its slot by request ID and
+ * clears that slot's bit in cfgPendingMask.  Slots whose request could not
+ * be created or sent, or whose response did not parse, are recorded in
+ * cfgFailedMask so the transfer is never reported complete without them.
+ * ----------------------------------------------------------------------- */
+
+static int PK_PEv2_ConfigBulkParse(sPoKeysDevice *dev, const uint8_t *resp)
+{
+    if (!dev || !resp) return PK_ERR_GENERIC;
+    sPoKeysPEv2 *pe = &dev->PEv2;
+
+    for (int slot = 0; slot < PK_PEV2_CFG_COUNT; slot++) {
+        if (!(pe->cfgPendingMask & (1u << slot)) || pe->cfgReqID[slot] != resp[6])
+            continue;
+
+        int ret = PK_OK;
+        if (!pe->cfgWrite) {
+            if (slot == PK_PEV2_CFG_ADDITIONAL)
+                ret = PK_PEv2_AdditionalParamsParse(dev, resp);
+            else if (slot == PK_PEV2_CFG_BACKLASH)
+                ret = PK_PEv2_BacklashParse(dev, resp);
+            else
+                ret = PK_PEv2_AxisConfigParse(dev, resp);
+        }
+        pe->cfgPendingMask &= (uint16_t)~(1u << slot);
+        if (ret != PK_OK)
+            pe->cfgFailedMask |= (uint16_t)(1u << slot);
+        return ret;
+    }
+    return PK_ERR_GENERIC; // Response of an earlier bulk transfer
+}
+
+static int PK_PEv2_ConfigBulkStart(sPoKeysDevice *dev, uint8_t write, uint32_t timeout_us)
+{
+    if (!dev) return PK_ERR_NOT_CONNECTED;
+    sPoKeysPEv2 *pe = &dev->PEv2;
+    if (pe->cfgPendingMask && get_current_time_us() < pe->cfgDeadline_us)
+        return PK_ERR_AGAIN; // Previous transfer still in flight
+
+    pe->cfgWrite = write;
+    pe->cfgPendingMask = 0;
+    pe->cfgFailedMask = 0;
+    memset(pe->cfgReqID, 0, sizeof(pe->cfgReqID));
+
+    for (int slot = 0; slot < PK_PEV2_CFG_COUNT; slot++) {
+        int req;
+        if (slot == PK_PEV2_CFG_ADDITIONAL) {
+            uint8_t pin = pe->EmergencyInputPin;
+            req = write
+                ? CreateRequestAsyncWithPayload(dev, PK_CMD_PULSE_ENGINE_V2,
+                                                (const uint8_t[]){PEV2_CMD_CONFIGURE_MISC, 1}, 2,
+                                                &pin, 1, PK_PEv2_ConfigBulkParse)
+                : CreateRequestAsync(dev, PK_CMD_PULSE_ENGINE_V2,
+                                     (const uint8_t[]){PEV2_CMD_CONFIGURE_MISC, 0, 0, 1}, 4,
+                                     NULL, 0, PK_PEv2_ConfigBulkParse);
+        } else if (slot == PK_PEV2_CFG_BACKLASH) {
+            req = write ? PK_PEv2_BacklashSetRequestCreate(dev, PK_PEv2_ConfigBulkParse)
+                        : PK_PEv2_BacklashGetRequestCreate(dev, PK_PEv2_ConfigBulkParse);
+        } else if (write) {
+            uint8_t payload[45];
+            PK_PEv2_AxisConfigPayload(pe, (uint8_t)slot, payload);
+            req = CreateRequestAsyncWithPayload(dev, PK_CMD_PULSE_ENGINE_V2,
+                                                (const uint8_t[]){PEV2_CMD_SET_AXIS_CONFIGURATION, (uint8_t)slot}, 2,
+                                                payload, sizeof(payload), PK_PEv2_ConfigBulkParse);
+        } else {
+            req = CreateRequestAsync(dev, PK_CMD_PULSE_ENGINE_V2,
+                                     (const uint8_t[]){PEV2_CMD_GET_AXIS_CONFIGURATION, (uint8_t)slot}, 2,
+                                     NULL, 0, PK_PEv2_ConfigBulkParse);
+        }
+        if (req < 0) {
+            rtapi_print_msg(RTAPI_MSG_ERR,
+                "PoKeys: %s:%s: no free transaction for config slot %d\n",
+                __FILE__, __FUNCTION__, slot);
+            pe->cfgFailedMask |= (uint16_t)(1u << slot);
+            continue;
+        }
+        pe->cfgReqID[slot] = (uint8_t)req;
+        pe->cfgPendingMask |= (uint16_t)(1u << slot);
+    }
+    if (pe->cfgPendingMask == 0) return PK_ERR_GENERIC;
+    int result = pe->cfgFailedMask ? PK_ERR_GENERIC : PK_OK;
+
+    pe->cfgDeadline_us = get_current_time_us() + timeout_us;
+
+    for (int slot = 0; slot < PK_PEV2_CFG_COUNT; slot++) {
+        if (!(pe->cfgPendingMask & (1u << slot))) continue;
+        if (SendRequestAsync(dev, pe->cfgReqID[slot]) != 0) {
+            pe->cfgPendingMask &= (uint16_t)~(1u << slot);
+            pe->cfgFailedMask |= (uint16_t)(1u << slot);
+            result = PK_ERR_TRANSFER;
+        }
+    }
+    return result;
+}
+
+int PK_PEv2_ConfigurationGetAllAsync(sPoKeysDevice *dev, uint32_t timeout_us)
+{
+    return PK_PEv2_ConfigBulkStart(dev, 0, timeout_us);
+}
+
+int PK_PEv2_ConfigurationSetAllAsync(sPoKeysDevice *dev, uint32_t timeout_us)
+{
+    return PK_PEv2_ConfigBulkStart(dev, 1, timeout_us);
+}
+
+int PK_PEv2_ConfigurationBulkStatus(sPoKeysDevice *dev)
+{
+    if (!dev) return PK_ERR_NOT_CONNECTED;
+    if (dev->PEv2.cfgFailedMask) return PK_ERR_TRANSFER;
+    if (dev->PEv2.cfgPendingMask == 0) return PK_OK;
+    if (get_current_time_us() >= dev->PEv2.cfgDeadline_us) return PK_ERR_TIMEOUT;
+    return PK_ERR_AGAIN;
+}
+
 int PK_PEv2_PulseEngineMovePVAsync(sPoKeysDevice *device)
 {
     if (!device) return PK_ERR_NOT_CONNECTED;
@@ -283,13 +531,49 @@ int PK_PEv2_ExternalOutputsSetAsync(sPoKeysDevice *device)
  * that byte[2] carries the number of accepted motion-buffer slots instead
  * of the status echo.  The remaining bytes [3..62] are the same engine
  * status fields decoded by PK_PEv2_DecodeStatusFromResp().
+ *
+ * The decoded status is staged for HAL and marked fresh, so the next
+ * pev2_status poll can be skipped while fills keep arriving.
  */
 static int PK_PEv2_BufferFillParse(sPoKeysDevice *dev, const uint8_t *resp)
 {
     if (!dev || !resp) return PK_ERR_GENERIC;
     dev->PEv2.motionBufferEntriesAccepted = resp[2];
     PK_PEv2_DecodeStatusFromResp(dev, resp);
-    return PK_OK;
+    dev->PEv2.statusPiggyback_us = dev->PEv2.fbSample_us;
+    return PK_SnapshotStagePEv2Status(dev);
+}
+
+/*
+ * PK_PEv2_BufferFillDecode - decode a BufferFill response (accepted count
+ * and engine status).  Exposed for callers with their own fill parser
+ * (e.g. the motion stream).
+ */
+int PK_PEv2_BufferFillDecode(sPoKeysDevice *dev, const uint8_t *resp)
+{
+    return PK_PEv2_BufferFillParse(dev, resp);
+}
+
+/*
+ * PK_PEv2_BufferFillRequestCreateAsync - prepare (but do not send) an 8-bit
+ * BufferFill request for @p count slots taken from the 56-byte @p entries.
+ * Returns the request ID, or a negative error code.
+ */
+int PK_PEv2_BufferFillRequestCreateAsync(sPoKeysDevice *device, const uint8_t *entries,
+                                         uint8_t count, pokeys_response_parser_t parser)
+{
+    if (!device) return PK_ERR_NOT_CONNECTED;
+    if (!entries) return PK_ERR_PARAMETER;
+
+    const uint8_t subcmds[4] = {
+        (uint8_t)PEV2_CMD_FILL_BUFFER_8BIT,
+        count,
+        (uint8_t)(device->PEv2.PulseEngineEnabled & 0x0F),
+        0
+    };
+
+    return CreateRequestAsyncWithPayload(device, PK_CMD_PULSE_ENGINE_V2,
+                                         subcmds, 4, entries, 56, parser);
 }
 
 /**
@@ -350,6 +634,69 @@ int PK_PEv2_BufferFill_16Async(sPoKeysDevice *device)
     return SendRequestAsync(device, req);
 }
 
+/*
+ * PK_PEv2_BufferFillLargeRequestCreateAsync - prepare (but do not send) an
+ * 8-bit multipart BufferFill for @p count slots from the 448-byte @p entries.
+ * Returns the request ID, or a negative error code.
+ */
+int PK_PEv2_BufferFillLargeRequestCreateAsync(sPoKeysDevice *device, const uint8_t *entries,
+                                              uint8_t count, pokeys_response_parser_t parser)
+{
+    if (!device) return PK_ERR_NOT_CONNECTED;
+    if (!entries) return PK_ERR_PARAMETER;
+
+    const uint8_t params[3] = {
+        (uint8_t)PEV2_CMD_FILL_BUFFER_8BIT,
+        count,
+        (uint8_t)(device->PEv2.PulseEngineEnabled & 0x0F)
+    };
+
+    return CreateRequestAsyncMultipart(device, params, 3, entries, PK_MULTIPART_DATA_SIZE, parser);
+}
+
+/**
+ * @brief Asynchronously transfer up to 448 bytes of 8-bit motion entries.
+ *
+ * Mirrors @ref PK_PEv2_BufferFillLarge.  The 512-byte multipart request is
+ * one transaction, so it is retried as a whole and its response reaches
+ * the BufferFill parser like a regular fill.
+ *
+ * @param device PoKeys device handle.
+ * @return 0 on success, negative error code on failure.
+ */
+int PK_PEv2_BufferFillLargeAsync(sPoKeysDevice *device)
+{
+    if (!device) return PK_ERR_NOT_CONNECTED;
+
+    int req = PK_PEv2_BufferFillLargeRequestCreateAsync(device, device->PEv2.MotionBuffer,
+                                                        device->PEv2.newMotionBufferEntries,
+                                                        PK_PEv2_BufferFillParse);
+    if (req < 0) return req;
+    return SendRequestAsync(device, req);
+}
+
+/**
+ * @brief 16-bit variant of @ref PK_PEv2_BufferFillLargeAsync (subcommand 0xFE).
+ *
+ * @param device PoKeys device handle.
+ * @return 0 on success, negative error code on failure.
+ */
+int PK_PEv2_BufferFillLarge_16Async(sPoKeysDevice *device)
+{
+    if (!device) return PK_ERR_NOT_CONNECTED;
+
+    const uint8_t params[3] = {
+        (uint8_t)PEV2_CMD_FILL_BUFFER_16BIT,
+        device->PEv2.newMotionBufferEntries,
+        (uint8_t)(device->PEv2.PulseEngineEnabled & 0x0F)
+    };
+
+    int req = CreateRequestAsyncMultipart(device, params, 3, device->PEv2.MotionBuffer,
+                                          PK_MULTIPART_DATA_SIZE, PK_PEv2_BufferFillParse);
+    if (req < 0) return req;
+    return SendRequestAsync(device, req);
+}
+
 /**
  * @brief Asynchronously clear the device motion buffer.
  *
@@ -713,6 +1060,87 @@ int export_pev2_pins(const char *prefix, long comp_id, sPoKeysDevice *device) {
         return r;
     }
 
+    // Feedback timing pins
+    rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: %s.PEv2.fb-age-us\n", __FILE__, __FUNCTION__, prefix);
+    r = hal_pin_u32_newf(HAL_OUT, &pev2->pin_fb_age_us, comp_id, "%s.PEv2.fb-age-us", prefix);
+    if (r != 0) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: %s.PEv2.fb-age-us failed\n", __FILE__, __FUNCTION__, prefix);
+        return r;
+    }
+    rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: %s.PEv2.fb-extrapolate-max-us\n", __FILE__, __FUNCTION__, prefix);
+    r = hal_pin_float_newf(HAL_IN, &pev2->pin_fb_extrapolate_max_us, comp_id, "%s.PEv2.fb-extrapolate-max-us", prefix);
+    if (r != 0) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: %s.PEv2.fb-extrapolate-max-us failed\n", __FILE__, __FUNCTION__, prefix);
+        return r;
+    }
+
+    rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: %s.PEv2.status-polls-skipped\n", __FILE__, __FUNCTION__, prefix);
+    r = hal_pin_u32_newf(HAL_OUT, &pev2->pin_status_polls_skipped, comp_id, "%s.PEv2.status-polls-skipped", prefix);
+    if (r != 0) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: %s.PEv2.status-polls-skipped failed\n", __FILE__, __FUNCTION__, prefix);
+        return r;
+    }
+
+    // Change-driven MovePV pins
+    for (int i = 0; i < 8; i++) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: %s.PEv2.%01d.movepv-deadband\n", __FILE__, __FUNCTION__, prefix, i);
+        r = hal_pin_float_newf(HAL_IN, &pev2->pin_movepv_deadband[i], comp_id, "%s.PEv2.%01d.movepv-deadband", prefix, i);
+        if (r != 0) {
+            rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: %s.PEv2.%01d.movepv-deadband failed\n", __FILE__, __FUNCTION__, prefix, i);
+            return r;
+        }
+    }
+    rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: %s.PEv2.movepv-keepalive-ms\n", __FILE__, __FUNCTION__, prefix);
+    r = hal_pin_u32_newf(HAL_IN, &pev2->pin_movepv_keepalive_ms, comp_id, "%s.PEv2.movepv-keepalive-ms", prefix);
+    if (r != 0) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: %s.PEv2.movepv-keepalive-ms failed\n", __FILE__, __FUNCTION__, prefix);
+        return r;
+    }
+    rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: %s.PEv2.movepv-skipped\n", __FILE__, __FUNCTION__, prefix);
+    r = hal_pin_u32_newf(HAL_OUT, &pev2->pin_movepv_skipped, comp_id, "%s.PEv2.movepv-skipped", prefix);
+    if (r != 0) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: %s.PEv2.movepv-skipped failed\n", __FILE__, __FUNCTION__, prefix);
+        return r;
+    }
+
+    // Engine state machine pins
+    rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: %s.PEv2.engine-enable\n", __FILE__, __FUNCTION__, prefix);
+    r = hal_pin_bit_newf(HAL_IN, &pev2->pin_engine_enable, comp_id, "%s.PEv2.engine-enable", prefix);
+    if (r != 0) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: %s.PEv2.engine-enable failed\n", __FILE__, __FUNCTION__, prefix);
+        return r;
+    }
+    rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: %s.PEv2.engine-reset\n", __FILE__, __FUNCTION__, prefix);
+    r = hal_pin_bit_newf(HAL_IN, &pev2->pin_engine_reset, comp_id, "%s.PEv2.engine-reset", prefix);
+    if (r != 0) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: %s.PEv2.engine-reset failed\n", __FILE__, __FUNCTION__, prefix);
+        return r;
+    }
+    rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: %s.PEv2.state-timeout-ms\n", __FILE__, __FUNCTION__, prefix);
+    r = hal_pin_u32_newf(HAL_IN, &pev2->pin_state_timeout_ms, comp_id, "%s.PEv2.state-timeout-ms", prefix);
+    if (r != 0) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: %s.PEv2.state-timeout-ms failed\n", __FILE__, __FUNCTION__, prefix);
+        return r;
+    }
+    rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: %s.PEv2.state-pending\n", __FILE__, __FUNCTION__, prefix);
+    r = hal_pin_bit_newf(HAL_OUT, &pev2->pin_state_pending, comp_id, "%s.PEv2.state-pending", prefix);
+    if (r != 0) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: %s.PEv2.state-pending failed\n", __FILE__, __FUNCTION__, prefix);
+        return r;
+    }
+    rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: %s.PEv2.state-fault\n", __FILE__, __FUNCTION__, prefix);
+    r = hal_pin_bit_newf(HAL_OUT, &pev2->pin_state_fault, comp_id, "%s.PEv2.state-fault", prefix);
+    if (r != 0) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: %s.PEv2.state-fault failed\n", __FILE__, __FUNCTION__, prefix);
+        return r;
+    }
+    rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: %s.PEv2.transition-time-us\n", __FILE__, __FUNCTION__, prefix);
+    r = hal_pin_u32_newf(HAL_OUT, &pev2->pin_transition_time_us, comp_id, "%s.PEv2.transition-time-us", prefix);
+    if (r != 0) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: %s.PEv2.transition-time-us failed\n", __FILE__, __FUNCTION__, prefix);
+        return r;
+    }
+
     // Initialize parameters with defaults
     for (int i = 0; i < 8; i++) {
         pev2->MaxSpeed[i] = 1000.0;
@@ -728,6 +1156,28 @@ int export_pev2_pins(const char *prefix, long comp_id, sPoKeysDevice *device) {
     *(pev2->pin_motion_buffer_mode) = 0;
     *(pev2->pin_motion_buffer_entries_accepted) = 0;
 
+    // Bridge one lost 100 Hz status packet by default
+    *(pev2->pin_fb_age_us) = 0;
+    *(pev2->pin_fb_extrapolate_max_us) = 20000.0;
+    *(pev2->pin_status_polls_skipped) = 0;
+
+    // MovePV: resend on any pulse change, keepalive every 100 ms
+    for (int i = 0; i < 8; i++)
+        *(pev2->pin_movepv_deadband[i]) = 0.0;
+    *(pev2->pin_movepv_keepalive_ms) = 100;
+    *(pev2->pin_movepv_skipped) = 0;
+
+    // Engine state machine: idle until engine-enable changes
+    *(pev2->pin_engine_enable) = 0;
+    *(pev2->pin_engine_reset) = 0;
+    *(pev2->pin_state_timeout_ms) = 200;
+    *(pev2->pin_state_pending) = 0;
+    *(pev2->pin_state_fault) = 0;
+    *(pev2->pin_transition_time_us) = 0;
+    pev2->smPhase = PK_PEV2_SM_IDLE;
+    pev2->smEnablePrev = 0;
+    pev2->smResetPrev = 0;
+
     // Initialize debug and performance monitoring pins
     *(pev2->pin_debug_test_enable) = 0;
     *(pev2->pin_debug_cycle_time) = 0;
@@ -757,8 +1207,8 @@ int export_pev2_pins(const char *prefix, long comp_id, sPoKeysDevice *device) {
  * Parse callback for PK_PEv2_StatusUpdateHALAsync.
  *
  * Decodes the status response into device->PEv2.* fields (same as
- * PK_PEv2_StatusParse) and then mirrors the values onto HAL output pins so
- * that LinuxCNC sees up-to-date feedback every time the device responds.
+ * PK_PEv2_StatusParse) and stages them for the next per-cycle snapshot
+ * publish, which mirrors them onto the HAL output pins.
  */
 static int PK_PEv2_StatusAndHALParse(sPoKeysDevice *dev, const uint8_t *resp)
 {
@@ -784,6 +1234,85 @@ static int PK_PEv2_StatusAndHALParse(sPoKeysDevice *dev, const uint8_t *resp)
         __FILE__, __FUNCTION__);
     PK_PEv2_DecodeStatusFromResp(dev, resp);
 
+    return PK_SnapshotStagePEv2Status(dev);
+}
+
+/*
+ * PK_PEv2_StatusCapture - copy the status fields of device->PEv2 that come
+ * from one packet into @p st, so they can be published together.
+ */
+void PK_PEv2_StatusCapture(const sPoKeysDevice *dev, sPoKeysSnapshotData *st)
+{
+    const sPoKeysPEv2 *pev2 = &dev->PEv2;
+    st->PulseEngineState     = pev2->PulseEngineState;
+    st->PulseEngineActivated = pev2->PulseEngineActivated;
+    st->ErrorInputStatus     = pev2->ErrorInputStatus;
+    st->LimitStatusP         = pev2->LimitStatusP;
+    st->LimitStatusN         = pev2->LimitStatusN;
+    st->HomeStatus           = pev2->HomeStatus;
+    for (int i = 0; i < 8; i++) {
+        st->AxesState[i]       = pev2->AxesState[i];
+        st->CurrentPosition[i] = pev2->CurrentPosition[i];
+        st->fbVelocity[i]      = pev2->fbVelocity[i];
+    }
+    st->stamp_us[PK_SNAPSHOT_PEV2_STATUS] = pev2->fbSample_us;
+}
+
+/*
+ * PK_PEv2_FeedbackExtrapolateHAL - write joint-pos-fb from the last status
+ * sample, moved forward by the estimated velocity to the current time.
+ * The horizon is capped by fb-extrapolate-max-us (0 disables it), so a lost
+ * status packet is bridged but a dead link is not.  Call once per servo
+ * cycle; the status publish path calls it as well.  Reads the snapshot
+ * front buffer when the device has one.
+ */
+static void PK_PEv2_FeedbackExtrapolateFrom(sPoKeysDevice *dev, const sPoKeysSnapshotData *st)
+{
+    sPoKeysPEv2 *pev2 = &dev->PEv2;
+    uint64_t sample_us = st->stamp_us[PK_SNAPSHOT_PEV2_STATUS];
+    if (sample_us == 0) return;
+
+    uint64_t now = get_current_time_us();
+    uint64_t age = (now > sample_us) ? now - sample_us : 0;
+    double limit = pev2->pin_fb_extrapolate_max_us ? *pev2->pin_fb_extrapolate_max_us : 0.0;
+    double horizon = (limit > 0.0) ? ((double)age < limit ? (double)age : limit) * 1e-6 : 0.0;
+
+    if (pev2->pin_fb_age_us)
+        *pev2->pin_fb_age_us = (age > 0xFFFFFFFFu) ? 0xFFFFFFFFu : (hal_u32_t)age;
+
+    for (int i = 0; i < 8; i++) {
+        if (!pev2->pin_joint_pos_fb[i] || fabsf(pev2->stepgen_STEP_SCALE[i]) <= 1e-9f)
+            continue;
+        double pulses = (double)st->CurrentPosition[i] + st->fbVelocity[i] * horizon;
+        *pev2->pin_joint_pos_fb[i] = (hal_float_t)(pulses / pev2->stepgen_STEP_SCALE[i]);
+    }
+}
+
+int PK_PEv2_FeedbackExtrapolateHAL(sPoKeysDevice *dev)
+{
+    if (!dev) return PK_ERR_GENERIC;
+
+    // Extrapolate from the published sample, so pos-fb matches the other pins
+    const sPoKeysSnapshot *snap = PK_SnapshotGet(dev);
+    if (snap) {
+        PK_PEv2_FeedbackExtrapolateFrom(dev, &snap->front);
+    } else {
+        sPoKeysSnapshotData st;
+        PK_PEv2_StatusCapture(dev, &st);
+        PK_PEv2_FeedbackExtrapolateFrom(dev, &st);
+    }
+    return PK_OK;
+}
+
+/*
+ * PK_PEv2_StatusPublishHALFrom - write a captured status set (e.g. the
+ * snapshot front buffer) to the HAL output pins, so every pin shows the
+ * same packet.
+ */
+int PK_PEv2_StatusPublishHALFrom(sPoKeysDevice *dev, const sPoKeysSnapshotData *st)
+{
+    if (!dev || !st) return PK_ERR_GENERIC;
+
     sPoKeysPEv2 *pev2 = &dev->PEv2;
 
     rtapi_print_msg(RTAPI_MSG_DBG,
@@ -793,8 +1322,8 @@ static int PK_PEv2_StatusAndHALParse(sPoKeysDevice *dev, const uint8_t *resp)
         (void*)pev2->pin_PulseEngineActivated);
 
     /* Global engine status */
-    if (pev2->pin_PulseEngineState)     *pev2->pin_PulseEngineState     = pev2->PulseEngineState;
-    if (pev2->pin_PulseEngineActivated) *pev2->pin_PulseEngineActivated = pev2->PulseEngineActivated;
+    if (pev2->pin_PulseEngineState)     *pev2->pin_PulseEngineState     = st->PulseEngineState;
+    if (pev2->pin_PulseEngineActivated) *pev2->pin_PulseEngineActivated = st->PulseEngineActivated;
     if (pev2->pin_nrOfAxes)             *pev2->pin_nrOfAxes             = pev2->info.nrOfAxes;
     if (pev2->pin_maxPulseFrequency)    *pev2->pin_maxPulseFrequency    = pev2->info.maxPulseFrequency;
     if (pev2->pin_bufferDepth)          *pev2->pin_bufferDepth          = pev2->info.bufferDepth;
@@ -804,14 +1333,25 @@ static int PK_PEv2_StatusAndHALParse(sPoKeysDevice *dev, const uint8_t *resp)
         "PoKeys: %s:%s: [D] emergency pin=%p\n",
         __FILE__, __FUNCTION__, (void*)pev2->pin_digin_Emergency_in);
 
+    /* Limit, home and e-stop bits: only pins whose bit changed are written */
+    uint64_t bankBits = (uint64_t)st->LimitStatusN << PEV2_BANK_LIMIT_N |
+                        (uint64_t)st->LimitStatusP << PEV2_BANK_LIMIT_P |
+                        (uint64_t)st->HomeStatus   << PEV2_BANK_HOME |
+                        (uint64_t)(st->ErrorInputStatus & 0x01) << PEV2_BANK_ESTOP;
+    uint64_t bankChanged = PK_BitBankUpdate(&pev2->statusInputBank, bankBits, PEV2_BANK_BITS,
+                                            st->stamp_us[PK_SNAPSHOT_PEV2_STATUS]);
+
     /* Emergency stop */
-    if (pev2->pin_digin_Emergency_in) {
-        hal_bit_t emg = (pev2->ErrorInputStatus & 0x01) ? 1 : 0;
+    if (pev2->pin_digin_Emergency_in && (bankChanged & ((uint64_t)1 << PEV2_BANK_ESTOP))) {
+        hal_bit_t emg = (st->ErrorInputStatus & 0x01) ? 1 : 0;
         *pev2->pin_digin_Emergency_in     = emg;
         if (pev2->pin_digin_Emergency_in_not)
             *pev2->pin_digin_Emergency_in_not = !emg;
     }
 
+    /* Scaled position feedback, extrapolated to the current time */
+    PK_PEv2_FeedbackExtrapolateFrom(dev, st);
+
     rtapi_print_msg(RTAPI_MSG_DBG,
         "PoKeys: %s:%s: [E] per-axis loop start\n",
         __FILE__, __FUNCTION__);
@@ -830,25 +1370,15 @@ static int PK_PEv2_StatusAndHALParse(sPoKeysDevice *dev, const uint8_t *resp)
             (void*)pev2->pin_joint_pos_cmd[i]);
 
         if (pev2->pin_AxesState[i])
-            *pev2->pin_AxesState[i] = pev2->AxesState[i];
+            *pev2->pin_AxesState[i] = st->AxesState[i];
         if (pev2->pin_CurrentPosition[i])
-            *pev2->pin_CurrentPosition[i] = pev2->CurrentPosition[i];
+            *pev2->pin_CurrentPosition[i] = st->CurrentPosition[i];
 
         /* [E%d-a] — AxesState and CurrentPosition written successfully */
         rtapi_print_msg(RTAPI_MSG_DBG,
             "PoKeys: %s:%s: [E%d-a] state/pos writes done\n",
             __FILE__, __FUNCTION__, i);
 
-        /* Scaled position feedback */
-        if (pev2->pin_joint_pos_fb[i] && fabsf(pev2->stepgen_STEP_SCALE[i]) > 1e-9f)
-            *pev2->pin_joint_pos_fb[i] = (hal_float_t)pev2->CurrentPosition[i]
-                                          / pev2->stepgen_STEP_SCALE[i];
-
-        /* [E%d-b] — pos_fb write done (or skipped if ptr/scale zero) */
-        rtapi_print_msg(RTAPI_MSG_DBG,
-            "PoKeys: %s:%s: [E%d-b] pos_fb write done\n",
-            __FILE__, __FUNCTION__, i);
-
         /* In-position: compare feedback to command */
         rtapi_print_msg(RTAPI_MSG_DBG,
             "PoKeys: %s:%s: [E%d-c] in_pos check: in_pos=%p cmd=%p fb=%p\n",
@@ -889,20 +1419,20 @@ static int PK_PEv2_StatusAndHALParse(sPoKeysDevice *dev, const uint8_t *resp)
             (void*)pev2->pin_digin_Home_in[i]);
 
         /* Limit switches (from bitmasks) */
-        if (pev2->pin_digin_LimitN_in[i]) {
-            hal_bit_t lim = (pev2->LimitStatusN & (1u << i)) ? 1 : 0;
+        if (pev2->pin_digin_LimitN_in[i] && (bankChanged & ((uint64_t)1 << (PEV2_BANK_LIMIT_N + i)))) {
+            hal_bit_t lim = (st->LimitStatusN & (1u << i)) ? 1 : 0;
             *pev2->pin_digin_LimitN_in[i] = lim;
             if (pev2->pin_digin_LimitN_in_not[i])
                 *pev2->pin_digin_LimitN_in_not[i] = !lim;
         }
-        if (pev2->pin_digin_LimitP_in[i]) {
-            hal_bit_t lim = (pev2->LimitStatusP & (1u << i)) ? 1 : 0;
+        if (pev2->pin_digin_LimitP_in[i] && (bankChanged & ((uint64_t)1 << (PEV2_BANK_LIMIT_P + i)))) {
+            hal_bit_t lim = (st->LimitStatusP & (1u << i)) ? 1 : 0;
             *pev2->pin_digin_LimitP_in[i] = lim;
             if (pev2->pin_digin_LimitP_in_not[i])
                 *pev2->pin_digin_LimitP_in_not[i] = !lim;
         }
-        if (pev2->pin_digin_Home_in[i]) {
-            hal_bit_t hm = (pev2->HomeStatus & (1u << i)) ? 1 : 0;
+        if (pev2->pin_digin_Home_in[i] && (bankChanged & ((uint64_t)1 << (PEV2_BANK_HOME + i)))) {
+            hal_bit_t hm = (st->HomeStatus & (1u << i)) ? 1 : 0;
             *pev2->pin_digin_Home_in[i] = hm;
             if (pev2->pin_digin_Home_in_not[i])
                 *pev2->pin_digin_Home_in_not[i] = !hm;
@@ -915,12 +1445,33 @@ static int PK_PEv2_StatusAndHALParse(sPoKeysDevice *dev, const uint8_t *resp)
     return PK_OK;
 }
 
+/*
+ * PK_PEv2_StatusPublishHAL - mirror the decoded device->PEv2.* status onto
+ * the HAL output pins.  Called directly by the status parsers when the
+ * device has no snapshot.
+ */
+int PK_PEv2_StatusPublishHAL(sPoKeysDevice *dev)
+{
+    if (!dev) return PK_ERR_GENERIC;
+
+    sPoKeysSnapshotData st;
+    PK_PEv2_StatusCapture(dev, &st);
+    return PK_PEv2_StatusPublishHALFrom(dev, &st);
+}
+
+static const sPoKeysRequestTemplate tpl_pev2_status_hal =
+    PK_REQUEST_TEMPLATE(PK_CMD_PULSE_ENGINE_V2, PEV2_CMD_GET_STATUS, 0, 0, 0, 0,
+                        PK_TEMPLATE_PEV2_TEST_BYTE, PK_PEv2_StatusAndHALParse);
+
 /**
  * PK_PEv2_StatusUpdateHALAsync - poll device status and update HAL pins.
  *
  * Drop-in replacement for PK_PEv2_StatusGetAsync that additionally mirrors
  * all decoded fields onto their HAL output pins inside the parse callback.
  * Registered with the async scheduler at ~100 Hz.
+ *
+ * The poll is skipped while a status-carrying response (e.g. a BufferFill
+ * answer in buffered mode) has already delivered fresher data.
  */
 int PK_PEv2_StatusUpdateHALAsync(sPoKeysDevice *device)
 {
@@ -928,26 +1479,193 @@ int PK_PEv2_StatusUpdateHALAsync(sPoKeysDevice *device)
         "PoKeys: %s:%s: entry device=%p\n",
         __FILE__, __FUNCTION__, (void*)device);
     if (!device) return PK_ERR_NOT_CONNECTED;
-    int req = CreateRequestAsync(device, PK_CMD_PULSE_ENGINE_V2,
-                                 (const uint8_t[]){PEV2_CMD_GET_STATUS, 0}, 2,
-                                 NULL, 0, PK_PEv2_StatusAndHALParse);
+    uint64_t piggyback = device->PEv2.statusPiggyback_us;
+    if (piggyback && (get_current_time_us() - piggyback) < PEV2_STATUS_FRESH_US) {
+        device->PEv2.statusPollsSkipped++;
+        if (device->PEv2.pin_status_polls_skipped)
+            *device->PEv2.pin_status_polls_skipped = device->PEv2.statusPollsSkipped;
+        return PK_OK;
+    }
+    /* The template applies the request-id test byte the device expects */
+    return PK_RequestTemplateSendAsync(device, &tpl_pev2_status_hal, NULL, 0);
+}
+
+/* -----------------------------------------------------------------------
+ * Acknowledged engine state transitions
+ *
+ * engine-enable selects RUNNING or STOPPED; a rising edge on engine-reset
+ * re-issues the current request (e.g. to leave STOP_EMERGENCY).  A
+ * transition is SET_STATE -> acknowledge -> status read-back; it only
+ * completes when the read-back shows the requested state.
+ *
+ * SET_STATE is only sent again when a read-back shows the device still in
+ * the state the transition started from; a lost acknowledge or read-back
+ * is answered with another read-back first.  Retries back off from
+ * PEV2_STATE_ATTEMPT_US, doubling up to PEV2_STATE_BACKOFF_MAX_US, until
+ * state-timeout-ms expires.  A transition away from STOPPED is aborted to
+ * FAULT while estop-request is asserted or when the device went to any
+ * other state (e.g. STOP_EMERGENCY), so a retry never re-enables the
+ * engine after an e-stop.
+ * ----------------------------------------------------------------------- */
+
+static void PK_PEv2_StatePublish(sPoKeysPEv2 *pev2)
+{
+    if (pev2->pin_state_pending)
+        *pev2->pin_state_pending = (pev2->smPhase == PK_PEV2_SM_SETTING ||
+                                    pev2->smPhase == PK_PEV2_SM_VERIFY);
+    if (pev2->pin_state_fault)
+        *pev2->pin_state_fault = (pev2->smPhase == PK_PEV2_SM_FAULT);
+}
+
+static int PK_PEv2_StateSendAttempt(sPoKeysDevice *dev);
+
+// estop-request of the device's priority lane, if it has one
+static int PK_PEv2_StateEstopAsserted(const sPoKeysDevice *dev)
+{
+    const sPoKeysPriorityLane *lane = PK_PriorityLaneGet(dev);
+    return lane && lane->pin_estop_request && *lane->pin_estop_request;
+}
+
+static void PK_PEv2_StateAbort(sPoKeysPEv2 *pev2, const char *why)
+{
+    rtapi_print_msg(RTAPI_MSG_ERR,
+        "PoKeys: %s:%s: PEv2 state %u aborted (%s, device state %u)\n",
+        __FILE__, __FUNCTION__, (unsigned)pev2->smTarget, why, (unsigned)pev2->PulseEngineState);
+    pev2->smPhase = PK_PEV2_SM_FAULT;
+    pev2->smReqID = 0;
+}
+
+static int PK_PEv2_StateVerifyParse(sPoKeysDevice *dev, const uint8_t *resp)
+{
+    if (!dev || !resp) return PK_ERR_GENERIC;
+    sPoKeysPEv2 *pev2 = &dev->PEv2;
+
+    int ret = PK_PEv2_StatusAndHALParse(dev, resp);
+    if (ret != PK_OK) return ret;
+    if (pev2->smPhase != PK_PEV2_SM_VERIFY || resp[6] != pev2->smReqID)
+        return PK_OK; // Late read-back of an earlier attempt
+
+    if (pev2->PulseEngineState == pev2->smTarget) {
+        uint64_t took = get_current_time_us() - pev2->smStart_us;
+        if (pev2->pin_transition_time_us)
+            *pev2->pin_transition_time_us = (took > 0xFFFFFFFFu) ? 0xFFFFFFFFu : (hal_u32_t)took;
+        pev2->smPhase = PK_PEV2_SM_IDLE;
+    } else if (pev2->smTarget != PK_PEState_peSTOPPED && PK_PEv2_StateEstopAsserted(dev)) {
+        PK_PEv2_StateAbort(pev2, "estop-request asserted");
+    } else if (pev2->PulseEngineState != pev2->smFrom) {
+        PK_PEv2_StateAbort(pev2, "device left the start state");
+    } else {
+        // Not applied yet; the service resends once the backoff has passed
+        pev2->smPhase = PK_PEV2_SM_SETTING;
+        pev2->smReqID = 0;
+    }
+    PK_PEv2_StatePublish(pev2);
+    return PK_OK;
+}
+
+static int PK_PEv2_StateSetParse(sPoKeysDevice *dev, const uint8_t *resp)
+{
+    if (!dev || !resp) return PK_ERR_GENERIC;
+    sPoKeysPEv2 *pev2 = &dev->PEv2;
+
+    if (pev2->smPhase != PK_PEV2_SM_SETTING || resp[6] != pev2->smReqID)
+        return PK_OK; // Acknowledge of a superseded attempt
+
+    int req = PK_PEv2_StatusRequestCreateAsync(dev, PK_PEv2_StateVerifyParse);
+    if (req < 0) return req; // Resent by the service on attempt timeout
+    pev2->smReqID = (uint8_t)req;
+    pev2->smPhase = PK_PEV2_SM_VERIFY;
+    return SendRequestAsync(dev, req);
+}
+
+// Acknowledge or read-back lost: ask the device before sending SET_STATE again
+static int PK_PEv2_StateReadBack(sPoKeysDevice *dev)
+{
+    sPoKeysPEv2 *pev2 = &dev->PEv2;
+    pev2->smAttempt_us = get_current_time_us();
+
+    int req = PK_PEv2_StatusRequestCreateAsync(dev, PK_PEv2_StateVerifyParse);
     if (req < 0) return req;
-    /* Apply the same request-id checksum that the device expects */
-    async_transaction_t *t = transaction_find(req);
-    if (t) {
-        uint8_t tstB = (0x10 + req) % 199;
-        t->request_buffer[3] = tstB;
-        uint8_t cs = 0;
-        for (int i = 0; i <= 6; i++) cs += t->request_buffer[i];
-        t->request_buffer[7] = cs;
+    pev2->smReqID = (uint8_t)req;
+    pev2->smPhase = PK_PEV2_SM_VERIFY;
+    return SendRequestAsync(dev, req);
+}
+
+static int PK_PEv2_StateSendAttempt(sPoKeysDevice *dev)
+{
+    sPoKeysPEv2 *pev2 = &dev->PEv2;
+    pev2->smAttempt_us = get_current_time_us();
+    pev2->smAttempts++;
+
+    pev2->PulseEngineStateSetup = pev2->smTarget;
+    int req = CreateRequestAsync(dev, PK_CMD_PULSE_ENGINE_V2,
+                                 (const uint8_t[]){PEV2_CMD_SET_STATE, pev2->smTarget,
+                                                   pev2->LimitOverrideSetup, pev2->AxisEnabledMask}, 4,
+                                 NULL, 0, PK_PEv2_StateSetParse);
+    if (req < 0) return req;
+    pev2->smReqID = (uint8_t)req;
+    return SendRequestAsync(dev, req);
+}
+
+int PK_PEv2_StateMachineService(sPoKeysDevice *dev)
+{
+    if (!dev) return PK_ERR_NOT_CONNECTED;
+    sPoKeysPEv2 *pev2 = &dev->PEv2;
+    if (!pev2->pin_engine_enable) return PK_OK;
+
+    uint8_t enable = *pev2->pin_engine_enable ? 1 : 0;
+    uint8_t reset  = (pev2->pin_engine_reset && *pev2->pin_engine_reset) ? 1 : 0;
+    uint8_t target = enable ? PK_PEState_peRUNNING : PK_PEState_peSTOPPED;
+    uint64_t now = get_current_time_us();
+
+    uint8_t estop = (target != PK_PEState_peSTOPPED) && PK_PEv2_StateEstopAsserted(dev);
+
+    if (enable != pev2->smEnablePrev || (reset && !pev2->smResetPrev)) {
+        pev2->smTarget = target;
+        pev2->smFrom = pev2->PulseEngineState;
+        pev2->smAttempts = 0;
+        pev2->smBackoff_us = PEV2_STATE_ATTEMPT_US;
+        pev2->smStart_us = now;
+        if (estop) {
+            PK_PEv2_StateAbort(pev2, "estop-request asserted");
+        } else {
+            pev2->smPhase = PK_PEV2_SM_SETTING;
+            PK_PEv2_StateSendAttempt(dev);
+        }
+    } else if (pev2->smPhase == PK_PEV2_SM_SETTING || pev2->smPhase == PK_PEV2_SM_VERIFY) {
+        uint32_t timeout_ms = pev2->pin_state_timeout_ms ? *pev2->pin_state_timeout_ms : 0;
+        if (timeout_ms && (now - pev2->smStart_us) >= (uint64_t)timeout_ms * 1000) {
+            rtapi_print_msg(RTAPI_MSG_ERR,
+                "PoKeys: %s:%s: PEv2 state %u not confirmed after %u attempts\n",
+                __FILE__, __FUNCTION__, (unsigned)pev2->smTarget, (unsigned)pev2->smAttempts);
+            pev2->smPhase = PK_PEV2_SM_FAULT;
+        } else if (estop) {
+            PK_PEv2_StateAbort(pev2, "estop-request asserted");
+        } else if ((now - pev2->smAttempt_us) >= pev2->smBackoff_us) {
+            pev2->smBackoff_us = (pev2->smBackoff_us >= PEV2_STATE_BACKOFF_MAX_US / 2)
+                ? PEV2_STATE_BACKOFF_MAX_US : pev2->smBackoff_us * 2;
+            if (pev2->smPhase == PK_PEV2_SM_SETTING && pev2->smReqID == 0)
+                PK_PEv2_StateSendAttempt(dev);  // Read-back showed the start state
+            else
+                PK_PEv2_StateReadBack(dev);
+        }
     }
-    return SendRequestAsync(device, req);
+
+    pev2->smEnablePrev = enable;
+    pev2->smResetPrev = reset;
+    PK_PEv2_StatePublish(pev2);
+    return PK_OK;
 }
 
 /**
  * PK_PEv2_MovePVFromHALAsync - read HAL command pins, update device struct,
  * then send a MovePV command to the device.
  *
+ * Only axes whose position moved by more than movepv-deadband (or whose
+ * velocity changed) since the last send are included in the axis mask; if
+ * none changed, nothing is sent.  All axes are resent at least every
+ * movepv-keepalive-ms so the device never sees the command stream stop.
+ *
  * Registered with the async scheduler at ~500 Hz.
  */
 int PK_PEv2_MovePVFromHALAsync(sPoKeysDevice *device)
@@ -982,11 +1700,45 @@ int PK_PEv2_MovePVFromHALAsync(sPoKeysDevice *device)
             pev2->ReferenceVelocityPV[i] = ratio;
         }
     }
-    pev2->param2 = 0xFF; /* all axes */
+
+    /* Build the mask of axes that moved beyond their deadband */
+    uint8_t mask = 0;
+    for (int i = 0; i < 8; i++) {
+        double deadband = 0.0;
+        if (pev2->pin_movepv_deadband[i])
+            deadband = fabs((double)*pev2->pin_movepv_deadband[i] * pev2->stepgen_STEP_SCALE[i]);
+        int64_t delta = (int64_t)pev2->ReferencePositionSpeed[i] - pev2->movePVSentPosition[i];
+        if (fabs((double)delta) > deadband ||
+            pev2->ReferenceVelocityPV[i] != pev2->movePVSentVelocity[i])
+            mask |= (uint8_t)(1u << i);
+    }
+
+    uint64_t now = get_current_time_us();
+    uint32_t keepalive_ms = pev2->pin_movepv_keepalive_ms ? *pev2->pin_movepv_keepalive_ms : 0;
+    if (pev2->movePVSent_us == 0 ||
+        (keepalive_ms && (now - pev2->movePVSent_us) >= (uint64_t)keepalive_ms * 1000))
+        mask = 0xFF; /* first send or keepalive: all axes */
+
+    if (mask == 0) {
+        pev2->movePVSkipped++;
+        if (pev2->pin_movepv_skipped) *pev2->pin_movepv_skipped = pev2->movePVSkipped;
+        return PK_OK;
+    }
+
+    pev2->param2 = mask;
     rtapi_print_msg(RTAPI_MSG_DBG,
-        "PoKeys: %s:%s: calling PK_PEv2_PulseEngineMovePVAsync\n",
-        __FILE__, __FUNCTION__);
-    return PK_PEv2_PulseEngineMovePVAsync(device);
+        "PoKeys: %s:%s: calling PK_PEv2_PulseEngineMovePVAsync mask=0x%02X\n",
+        __FILE__, __FUNCTION__, mask);
+    int ret = PK_PEv2_PulseEngineMovePVAsync(device);
+    if (ret != PK_OK) return ret;
+
+    for (int i = 0; i < 8; i++) {
+        if (!(mask & (1u << i))) continue;
+        pev2->movePVSentPosition[i] = pev2->ReferencePositionSpeed[i];
+        pev2->movePVSentVelocity[i] = pev2->ReferenceVelocityPV[i];
+    }
+    pev2->movePVSent_us = now;
+    return PK_OK;
 }
 
 /**
@@ -1020,6 +1772,9 @@ int PK_PEv2_ExternalOutputsFromHALAsync(sPoKeysDevice *device)
     if (pev2->pin_ExternalRelayOutputs) *pev2->pin_ExternalRelayOutputs = relay_mask;
     if (pev2->pin_ExternalOCOutputs)    *pev2->pin_ExternalOCOutputs    = oc_mask;
 
-    return PK_PEv2_ExternalOutputsSetAsync(device);
+    uint8_t payload[2] = { relay_mask, oc_mask };
+    return PK_ShadowWriteAsync(device, PK_SHADOW_PEV2_EXTOUT, PK_CMD_PULSE_ENGINE_V2,
+                               (const uint8_t[]){PEV2_CMD_SET_OUTPUTS}, 1,
+                               payload, sizeof(payload), NULL);
 }
 
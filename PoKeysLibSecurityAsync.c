@@ -9,12 +9,12 @@ typedef struct {
     uint8_t used;
 } SecurityAsyncContext;
 
-static SecurityAsyncContext sec_ctx[256];
+PK_PARSER_CTX_CHECK(SecurityAsyncContext);
 
 static int PK_SecurityStatus_Parse(sPoKeysDevice *dev, const uint8_t *resp)
 {
-    uint8_t id = resp[6];
-    SecurityAsyncContext *c = &sec_ctx[id];
+    SecurityAsyncContext *c = PK_TransactionContext(dev, resp[6]);
+    if (!c) return PK_ERR_GENERIC;
     if (c->level_ptr)
         *(c->level_ptr) = resp[8];
     if (c->seed_ptr)
@@ -25,8 +25,8 @@ static int PK_SecurityStatus_Parse(sPoKeysDevice *dev, const uint8_t *resp)
 
 static int PK_UserAuthorise_Parse(sPoKeysDevice *dev, const uint8_t *resp)
 {
-    uint8_t id = resp[6];
-    SecurityAsyncContext *c = &sec_ctx[id];
+    SecurityAsyncContext *c = PK_TransactionContext(dev, resp[6]);
+    if (!c) return PK_ERR_GENERIC;
     if (c->status_ptr)
         *(c->status_ptr) = resp[8];
     c->used = 0;
@@ -38,9 +38,11 @@ int PK_SecurityStatusGetAsync(sPoKeysDevice* device, uint8_t* level, uint8_t* se
     if (!device) return PK_ERR_NOT_CONNECTED;
     int req = CreateRequestAsync(device, PK_CMD_SECURITY_STATUS_GET, NULL, 0, NULL, 0, PK_SecurityStatus_Parse);
     if (req < 0) return req;
-    sec_ctx[req].level_ptr = level;
-    sec_ctx[req].seed_ptr = seed;
-    sec_ctx[req].used = 1;
+    SecurityAsyncContext *c = PK_TransactionContext(device, (uint8_t)req);
+    if (!c) return PK_ERR_GENERIC;
+    c->level_ptr = level;
+    c->seed_ptr = seed;
+    c->used = 1;
     return SendRequestAsync(device, req);
 }
 
@@ -50,8 +52,10 @@ int PK_UserAuthoriseAsync(sPoKeysDevice* device, uint8_t level, const uint8_t* h
     uint8_t params[1] = { level };
     int req = CreateRequestAsyncWithPayload(device, PK_CMD_USER_AUTHORISE, params, 1, hash, 20, PK_UserAuthorise_Parse);
     if (req < 0) return req;
-    sec_ctx[req].status_ptr = status;
-    sec_ctx[req].used = 1;
+    SecurityAsyncContext *c = PK_TransactionContext(device, (uint8_t)req);
+    if (!c) return PK_ERR_GENERIC;
+    c->status_ptr = status;
+    c->used = 1;
     return SendRequestAsync(device, req);
 }
 
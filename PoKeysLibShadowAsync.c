@@ -0,0 +1,186 @@
+#include "PoKeysLibHal.h"
+#include "PoKeysLibAsync.h"
+#include <string.h>
+
+extern uint64_t get_current_time_us(void);
+
+/*
+ * Output shadow registers - delta-sync for the periodic output tasks.
+ *
+ * Each output group remembers the last value the device acknowledged.  The
+ * scheduled set functions hand their fully built request to
+ * PK_ShadowWriteAsync(), which only puts it on the wire when it differs
+ * from that value, when the previous write was lost (timeout/failure), or
+ * when the slow refresh interval has passed - the latter re-applies the
+ * outputs after a device reset the host did not notice.
+ */
+
+#define PK_SHADOW_ACK_TIMEOUT_US 50000  // Unanswered write considered lost
+
+// Kept in each write's transaction, so every response finds its own parser
+typedef struct {
+    pokeys_response_parser_t parser;
+} sPoKeysShadowWriteCtx;
+
+PK_PARSER_CTX_CHECK(sPoKeysShadowWriteCtx);
+
+static sPoKeysShadow shadows[PK_SHADOW_MAX];
+static int shadow_count = 0;
+
+sPoKeysShadow *PK_ShadowGet(const sPoKeysDevice *dev)
+{
+    for (int s = 0; s < shadow_count; s++) {
+        if (shadows[s].dev == dev)
+            return &shadows[s];
+    }
+    return NULL;
+}
+
+int PK_ShadowCreate(sPoKeysDevice *dev)
+{
+    if (!dev) return PK_ERR_NOT_CONNECTED;
+    if (PK_ShadowGet(dev)) return PK_OK;
+    if (shadow_count >= PK_SHADOW_MAX) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: shadow table full (PK_SHADOW_MAX=%d)\n",
+                        __FILE__, __FUNCTION__, PK_SHADOW_MAX);
+        return PK_ERR_GENERIC;
+    }
+
+    sPoKeysShadow *sh = &shadows[shadow_count++];
+    memset(sh, 0, sizeof(*sh));
+    sh->dev = dev;
+    return PK_OK;
+}
+
+void PK_ShadowInvalidate(sPoKeysDevice *dev)
+{
+    sPoKeysShadow *sh = PK_ShadowGet(dev);
+    if (!sh) return;
+    for (int g = 0; g < PK_SHADOW_GROUPS; g++)
+        sh->group[g].ackedValid = 0;
+}
+
+static void PK_ShadowPublish(sPoKeysShadow *sh)
+{
+    if (sh->pin_writes)     *sh->pin_writes     = sh->writes;
+    if (sh->pin_suppressed) *sh->pin_suppressed = sh->suppressed;
+    if (sh->pin_resends)    *sh->pin_resends    = sh->resends;
+}
+
+/*
+ * Acknowledge callback for shadowed writes: the in-flight value becomes the
+ * acknowledged one, then the caller's own parser (if any) runs.  Responses
+ * to superseded writes are passed on but do not update the shadow.
+ */
+static int PK_ShadowAckParse(sPoKeysDevice *dev, const uint8_t *resp)
+{
+    if (!dev || !resp) return PK_ERR_GENERIC;
+    sPoKeysShadow *sh = PK_ShadowGet(dev);
+    if (!sh) return PK_ERR_GENERIC;
+
+    for (int g = 0; g < PK_SHADOW_GROUPS; g++) {
+        sPoKeysShadowGroup *grp = &sh->group[g];
+        if (grp->reqID == 0 || grp->reqID != resp[6]) continue;
+
+        memcpy(grp->acked, grp->inflight, sizeof(grp->acked));
+        grp->ackedLen = grp->inflightLen;
+        grp->ackedValid = 1;
+        grp->acked_us = get_current_time_us();
+        grp->reqID = 0;
+        break;
+    }
+
+    const sPoKeysShadowWriteCtx *c = PK_TransactionContext(dev, resp[6]);
+    return (c && c->parser) ? c->parser(dev, resp) : PK_OK;
+}
+
+int PK_ShadowWriteAsync(sPoKeysDevice *dev, ePK_ShadowGroup group, pokeys_command_t cmd,
+                        const uint8_t *params, size_t params_len,
+                        const uint8_t *payload, size_t payload_size,
+                        pokeys_response_parser_t parser)
+{
+    if (!dev) return PK_ERR_NOT_CONNECTED;
+    if (group >= PK_SHADOW_GROUPS || params_len > 4 || payload_size > 56) return PK_ERR_PARAMETER;
+
+    sPoKeysShadow *sh = PK_ShadowGet(dev);
+    if (!sh)
+        return CreateAndSendRequestAsyncWithPayload(dev, cmd, params, params_len,
+                                                    payload, payload_size, parser);
+
+    // Value as compared: command, params and payload
+    uint8_t value[PK_SHADOW_VALUE_BYTES] = {0};
+    value[0] = (uint8_t)cmd;
+    if (params_len)   memcpy(value + 1, params, params_len);
+    if (payload_size) memcpy(value + 5, payload, payload_size);
+    uint16_t len = (uint16_t)(5 + payload_size);
+
+    sPoKeysShadowGroup *grp = &sh->group[group];
+    uint64_t now = get_current_time_us();
+
+    if (grp->reqID != 0) {
+        async_transaction_t *t = transaction_find(dev, grp->reqID);
+        int lost = (now - grp->sent_us) >= PK_SHADOW_ACK_TIMEOUT_US ||
+                   !t || t->request_id != grp->reqID ||
+                   t->status == TRANSACTION_TIMEOUT || t->status == TRANSACTION_FAILED;
+        if (!lost && grp->inflightLen == len && memcmp(grp->inflight, value, len) == 0)
+            return PK_OK; // Same value already on its way
+        if (lost) sh->resends++;
+        grp->reqID = 0;
+    } else if (grp->ackedValid && grp->ackedLen == len && memcmp(grp->acked, value, len) == 0) {
+        uint32_t refresh_ms = sh->pin_refresh_ms ? *sh->pin_refresh_ms : 0;
+        if (refresh_ms == 0 || (now - grp->acked_us) < (uint64_t)refresh_ms * 1000) {
+            sh->suppressed++;
+            PK_ShadowPublish(sh);
+            return PK_OK;
+        }
+    }
+
+    int req = CreateRequestAsyncWithPayload(dev, cmd, params, params_len,
+                                            payload, payload_size, PK_ShadowAckParse);
+    if (req < 0) return req;
+
+    sPoKeysShadowWriteCtx *c = PK_TransactionContext(dev, (uint8_t)req);
+    if (c) c->parser = parser;
+
+    memcpy(grp->inflight, value, len);
+    grp->inflightLen = len;
+    grp->reqID = (uint8_t)req;
+    grp->sent_us = now;
+    sh->writes++;
+    PK_ShadowPublish(sh);
+
+    return SendRequestAsync(dev, (uint8_t)req);
+}
+
+int export_shadow_pins(const char *prefix, long comp_id, sPoKeysDevice *dev)
+{
+    int r;
+    sPoKeysShadow *sh = PK_ShadowGet(dev);
+
+    if (sh == NULL) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: no shadow for device\n", __FILE__, __FUNCTION__);
+        return -1;
+    }
+
+    r = hal_pin_u32_newf(HAL_IN, &(sh->pin_refresh_ms), comp_id, "%s.outputs.refresh-ms", prefix);
+    if (r != 0) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: %s.outputs.refresh-ms failed\n", __FILE__, __FUNCTION__, prefix);
+        return r;
+    }
+
+    r = hal_pin_u32_newf(HAL_OUT, &(sh->pin_writes), comp_id, "%s.outputs.writes", prefix);
+    if (r != 0) return r;
+
+    r = hal_pin_u32_newf(HAL_OUT, &(sh->pin_suppressed), comp_id, "%s.outputs.suppressed", prefix);
+    if (r != 0) return r;
+
+    r = hal_pin_u32_newf(HAL_OUT, &(sh->pin_resends), comp_id, "%s.outputs.resends", prefix);
+    if (r != 0) return r;
+
+    *(sh->pin_refresh_ms) = 1000;
+    *(sh->pin_writes) = 0;
+    *(sh->pin_suppressed) = 0;
+    *(sh->pin_resends) = 0;
+
+    return 0;
+}
@@ -0,0 +1,219 @@
+#include "PoKeysLibHal.h"
+#include "PoKeysLibAsync.h"
+#include "PoKeysLibCoreSocketsAsync.h"
+#include <string.h>
+
+extern uint64_t get_current_time_us(void);
+
+/*
+ * Per-cycle device snapshot.
+ *
+ * Responses are dispatched whenever they arrive (phase 1 drain, phase 3
+ * drain, retries), so writing HAL pins from the parsers mixes packets of
+ * different cycles: encoders 0..12 from this cycle next to 13..25 from the
+ * last one, or PEv2 positions from one status next to limits from another.
+ * The parsers therefore only stage into a back buffer; PK_SnapshotPublish()
+ * swaps the staged set in under a seqlock and writes HAL from it once per
+ * servo cycle.
+ */
+
+#define PK_SNAPSHOT_READ_RETRIES 100
+
+static sPoKeysSnapshot snapshots[PK_SNAPSHOT_MAX];
+static int snapshot_count = 0;
+
+sPoKeysSnapshot *PK_SnapshotGet(const sPoKeysDevice *dev)
+{
+    for (int s = 0; s < snapshot_count; s++) {
+        if (snapshots[s].dev == dev)
+            return &snapshots[s];
+    }
+    return NULL;
+}
+
+int PK_SnapshotCreate(sPoKeysDevice *dev)
+{
+    if (!dev) return PK_ERR_NOT_CONNECTED;
+    if (PK_SnapshotGet(dev)) return PK_OK;
+    if (snapshot_count >= PK_SNAPSHOT_MAX) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: snapshot table full (PK_SNAPSHOT_MAX=%d)\n",
+                        __FILE__, __FUNCTION__, PK_SNAPSHOT_MAX);
+        return PK_ERR_GENERIC;
+    }
+
+    sPoKeysSnapshot *snap = &snapshots[snapshot_count];
+    memset(snap, 0, sizeof(*snap));
+    snap->dev = dev;
+    snapshot_count++;
+    return PK_OK;
+}
+
+int PK_SnapshotStageDigitalInputs(sPoKeysDevice *dev, const uint8_t *bits)
+{
+    sPoKeysSnapshot *snap = PK_SnapshotGet(dev);
+    if (!snap || !bits) return PK_ERR_PARAMETER;
+
+    memcpy(snap->back.digitalIn, bits, sizeof(snap->back.digitalIn));
+    snap->back.stamp_us[PK_SNAPSHOT_DIGITAL_IN] = get_current_time_us();
+    snap->dirtyMask |= (1u << PK_SNAPSHOT_DIGITAL_IN);
+    return PK_OK;
+}
+
+int PK_SnapshotStageEncoders(sPoKeysDevice *dev, uint32_t first, uint32_t count, const uint8_t *raw)
+{
+    sPoKeysSnapshot *snap = PK_SnapshotGet(dev);
+    if (!snap || !raw || first + count > PK_SNAPSHOT_ENCODERS) return PK_ERR_PARAMETER;
+
+    for (uint32_t i = 0; i < count; i++) {
+        snap->back.encoder[first + i] = (int32_t)((uint32_t)raw[i * 4] |
+                                                  ((uint32_t)raw[i * 4 + 1] << 8) |
+                                                  ((uint32_t)raw[i * 4 + 2] << 16) |
+                                                  ((uint32_t)raw[i * 4 + 3] << 24));
+        snap->back.encoderValidMask |= (1u << (first + i));
+    }
+    snap->back.stamp_us[PK_SNAPSHOT_ENCODERS_SUB] = get_current_time_us();
+    snap->dirtyMask |= (1u << PK_SNAPSHOT_ENCODERS_SUB);
+    return PK_OK;
+}
+
+int PK_SnapshotStagePEv2Status(sPoKeysDevice *dev)
+{
+    if (!dev) return PK_ERR_GENERIC;
+    sPoKeysSnapshot *snap = PK_SnapshotGet(dev);
+    if (!snap) return PK_PEv2_StatusPublishHAL(dev);
+
+    PK_PEv2_StatusCapture(dev, &snap->back);
+    if (!snap->back.stamp_us[PK_SNAPSHOT_PEV2_STATUS])
+        snap->back.stamp_us[PK_SNAPSHOT_PEV2_STATUS] = get_current_time_us();
+    snap->dirtyMask |= (1u << PK_SNAPSHOT_PEV2_STATUS);
+    return PK_OK;
+}
+
+uint64_t PK_BitBankUpdate(sPoKeysBitBank *bank, uint64_t bits, uint8_t nbits, uint64_t now_us)
+{
+    if (nbits > PK_BITBANK_BITS) nbits = PK_BITBANK_BITS;
+    uint64_t valid = (nbits == 64) ? ~(uint64_t)0 : (((uint64_t)1 << nbits) - 1);
+    bits &= valid;
+
+    if (!bank->primed) {
+        bank->bits = bits;
+        bank->primed = 1;
+        return valid;
+    }
+
+    uint64_t changed = (bits ^ bank->bits) & valid;
+    for (uint64_t m = changed; m; m &= m - 1) {
+        int i = __builtin_ctzll(m);
+        bank->edges[i]++;
+        bank->edge_us[i] = now_us;
+    }
+    bank->bits = bits;
+    return changed;
+}
+
+static void PK_SnapshotApplyHAL(sPoKeysSnapshot *snap, uint8_t dirty)
+{
+    sPoKeysDevice *dev = snap->dev;
+    const sPoKeysSnapshotData *f = &snap->front;
+
+    if (dirty & (1u << PK_SNAPSHOT_DIGITAL_IN)) {
+        uint64_t bits = 0;
+        memcpy(&bits, f->digitalIn, sizeof(f->digitalIn)); // Little-endian: pin n = bit n
+        uint32_t count = dev->info.iPinCount < 56 ? dev->info.iPinCount : 56;
+        uint64_t changed = PK_BitBankUpdate(&snap->digitalInBank, bits, (uint8_t)count,
+                                            f->stamp_us[PK_SNAPSHOT_DIGITAL_IN]);
+        const sPoKeysPinBank *bank = PK_PinBankGet(dev);
+        if (bank) {
+            PK_PinBankPublishInputs(bank, bits, changed);
+        } else {
+            for (uint64_t m = changed; m; m &= m - 1) {
+                int i = __builtin_ctzll(m);
+                hal_bit_t v = (bits >> i) & 1;
+                if (dev->Pins[i].DigitalValueGet.in)     *(dev->Pins[i].DigitalValueGet.in)     = v;
+                if (dev->Pins[i].DigitalValueGet.in_not) *(dev->Pins[i].DigitalValueGet.in_not) = !v;
+            }
+        }
+    }
+
+    if ((dirty & (1u << PK_SNAPSHOT_ENCODERS_SUB)) && dev->Encoders) {
+        for (uint32_t i = 0; i < PK_SNAPSHOT_ENCODERS; i++) {
+            if ((f->encoderValidMask & (1u << i)) && dev->Encoders[i].encoderValue)
+                *(dev->Encoders[i].encoderValue) = (hal_s32_t)f->encoder[i];
+        }
+    }
+
+    if (dirty & (1u << PK_SNAPSHOT_PEV2_STATUS))
+        PK_PEv2_StatusPublishHALFrom(dev, f);
+
+    if (snap->pin_skew_us) {
+        uint64_t lo = UINT64_MAX, hi = 0;
+        for (int s = 0; s < PK_SNAPSHOT_SUBSYSTEMS; s++) {
+            if (!f->stamp_us[s]) continue;
+            if (f->stamp_us[s] < lo) lo = f->stamp_us[s];
+            if (f->stamp_us[s] > hi) hi = f->stamp_us[s];
+        }
+        *snap->pin_skew_us = (hi > lo) ? (hal_u32_t)(hi - lo) : 0;
+    }
+}
+
+int PK_SnapshotPublish(sPoKeysDevice *dev)
+{
+    sPoKeysSnapshot *snap = PK_SnapshotGet(dev);
+    if (!snap) return PK_ERR_PARAMETER;
+
+    uint8_t dirty = snap->dirtyMask;
+    if (dirty == 0) return PK_OK;
+
+    // Seqlock write side: odd while the front copy is inconsistent
+    uint32_t seq = snap->seq;
+    __atomic_store_n(&snap->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(&snap->front, &snap->back, sizeof(snap->front));
+    __atomic_store_n(&snap->seq, seq + 2, __ATOMIC_RELEASE);
+    snap->dirtyMask = 0;
+
+    PK_SnapshotApplyHAL(snap, dirty);
+    if (snap->pin_seq) *snap->pin_seq = seq + 2;
+    return PK_OK;
+}
+
+int PK_SnapshotRead(const sPoKeysDevice *dev, sPoKeysSnapshotData *out)
+{
+    sPoKeysSnapshot *snap = PK_SnapshotGet(dev);
+    if (!snap || !out) return PK_ERR_PARAMETER;
+
+    for (int attempt = 0; attempt < PK_SNAPSHOT_READ_RETRIES; attempt++) {
+        uint32_t begin = __atomic_load_n(&snap->seq, __ATOMIC_ACQUIRE);
+        if (begin & 1) continue;
+        memcpy(out, &snap->front, sizeof(*out));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&snap->seq, __ATOMIC_RELAXED) == begin)
+            return PK_OK;
+    }
+    return PK_ERR_AGAIN;
+}
+
+int export_snapshot_pins(const char *prefix, long comp_id, sPoKeysDevice *dev)
+{
+    int r;
+    sPoKeysSnapshot *snap = PK_SnapshotGet(dev);
+
+    if (snap == NULL) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: no snapshot for device\n", __FILE__, __FUNCTION__);
+        return -1;
+    }
+
+    r = hal_pin_u32_newf(HAL_OUT, &(snap->pin_seq), comp_id, "%s.snapshot.seq", prefix);
+    if (r != 0) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: %s.snapshot.seq failed\n", __FILE__, __FUNCTION__, prefix);
+        return r;
+    }
+
+    r = hal_pin_u32_newf(HAL_OUT, &(snap->pin_skew_us), comp_id, "%s.snapshot.skew-us", prefix);
+    if (r != 0) return r;
+
+    *(snap->pin_seq) = 0;
+    *(snap->pin_skew_us) = 0;
+
+    return 0;
+}
@@ -18,12 +18,12 @@ typedef struct {
     uint8_t used;
 } UARTAsyncContext;
 
-static UARTAsyncContext uart_ctx[256];
+PK_PARSER_CTX_CHECK(UARTAsyncContext);
 
 static int PK_UART_ReadParse(sPoKeysDevice *dev, const uint8_t *resp)
 {
-    uint8_t id = resp[6];
-    UARTAsyncContext *c = &uart_ctx[id];
+    UARTAsyncContext *c = PK_TransactionContext(dev, resp[6]);
+    if (!c) return PK_ERR_GENERIC;
     if (c->len_ptr)
         *(c->len_ptr) = resp[3];
     if (c->data_ptr && resp[3])
@@ -75,9 +75,11 @@ int PK_UARTReadAsync(sPoKeysDevice* device, uint8_t interfaceID,
                                  params, 2, NULL, 0,
                                  PK_UART_ReadParse);
     if (req < 0) return req;
-    uart_ctx[req].len_ptr = dataReadLen;
-    uart_ctx[req].data_ptr = dataPtr;
-    uart_ctx[req].used = 1;
+    UARTAsyncContext *c = PK_TransactionContext(device, (uint8_t)req);
+    if (!c) return PK_ERR_GENERIC;
+    c->len_ptr = dataReadLen;
+    c->data_ptr = dataPtr;
+    c->used = 1;
     return SendRequestAsync(device, (uint8_t)req);
 }
 
@@ -0,0 +1,463 @@
+#include "PoKeysLibHal.h"
+#include "PoKeysLibXDP.h"
+#include <string.h>
+
+#ifdef POKEYSLIB_USE_XDP
+
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <linux/if_ether.h>
+#include <linux/if_link.h>
+#include <linux/ip.h>
+#include <linux/udp.h>
+#include <xdp/xsk.h>
+
+#define PK_XDP_FRAME_SIZE      XSK_UMEM__DEFAULT_FRAME_SIZE
+#define PK_XDP_RX_FRAMES       (PK_XDP_FRAME_COUNT / 2)
+#define PK_XDP_TX_FRAMES       (PK_XDP_FRAME_COUNT - PK_XDP_RX_FRAMES)
+#define PK_XDP_RING_SIZE       XSK_RING_CONS__DEFAULT_NUM_DESCS
+#define PK_XDP_HDR_LEN         (sizeof(struct ethhdr) + sizeof(struct iphdr) + sizeof(struct udphdr))
+#define PK_XDP_MAX_PAYLOAD     512
+
+typedef struct {
+    struct xsk_umem      *umem;
+    struct xsk_socket    *xsk;
+    struct xsk_ring_prod  fill;
+    struct xsk_ring_cons  comp;
+    struct xsk_ring_cons  rx;
+    struct xsk_ring_prod  tx;
+    void                 *umemArea;
+    uint64_t              umemSize;
+
+    uint64_t              txFree[PK_XDP_TX_FRAMES];   // Stack of free TX frame addresses
+    uint32_t              txFreeCount;
+    uint64_t              rxRefill[PK_XDP_RX_FRAMES]; // RX frames still to go back to the fill ring
+    uint32_t              rxRefillCount;
+
+    uint32_t              localIP;
+    uint32_t              remoteIP;
+    uint8_t               localMAC[6];
+    uint8_t               remoteMAC[6];
+    uint16_t              localPort;                 // Network order
+    uint16_t              ipID;
+    uint8_t               copyMode;                  // Generic mode: every TX needs a sendto() kick
+
+    sPoKeysXDPStats       stats;
+} sPoKeysXDPContext;
+
+/* ------------------------------------------------------------------------- */
+/* Setup helpers (not RT-safe)                                               */
+/* ------------------------------------------------------------------------- */
+
+static int pk_xdp_read_interface(const char *ifname, uint8_t *mac, uint32_t *ip)
+{
+    struct ifreq ifr;
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) return -1;
+
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
+
+    if (mac) {
+        if (ioctl(fd, SIOCGIFHWADDR, &ifr) < 0) {
+            close(fd);
+            return -1;
+        }
+        memcpy(mac, ifr.ifr_hwaddr.sa_data, 6);
+    }
+    if (ip) {
+        if (ioctl(fd, SIOCGIFADDR, &ifr) < 0) {
+            close(fd);
+            return -1;
+        }
+        *ip = ((struct sockaddr_in *)&ifr.ifr_addr)->sin_addr.s_addr;
+    }
+    close(fd);
+    return 0;
+}
+
+// Looks the device up in the kernel neighbour table; the XDP program takes
+// over the queue afterwards, so kernel ARP resolution is no longer available.
+static int pk_xdp_lookup_arp(uint32_t ip, uint8_t *mac)
+{
+    char line[256];
+    char ipStr[INET_ADDRSTRLEN];
+    FILE *f = fopen("/proc/net/arp", "r");
+    if (!f) return -1;
+
+    inet_ntop(AF_INET, &ip, ipStr, sizeof(ipStr));
+    while (fgets(line, sizeof(line), f)) {
+        char addr[64], hw[64];
+        unsigned int m[6];
+        if (sscanf(line, "%63s %*s %*s %63s", addr, hw) != 2) continue;
+        if (strcmp(addr, ipStr) != 0) continue;
+        if (sscanf(hw, "%x:%x:%x:%x:%x:%x", &m[0], &m[1], &m[2], &m[3], &m[4], &m[5]) != 6) continue;
+        for (int i = 0; i < 6; i++) mac[i] = (uint8_t)m[i];
+        fclose(f);
+        return 0;
+    }
+    fclose(f);
+    return -1;
+}
+
+static int pk_xdp_mac_is_zero(const uint8_t *mac)
+{
+    return (mac[0] | mac[1] | mac[2] | mac[3] | mac[4] | mac[5]) == 0;
+}
+
+// Undoes whatever part of PK_XDP_Open() got done, including the context itself
+static void pk_xdp_release(sPoKeysXDPContext *ctx)
+{
+    if (ctx->xsk) xsk_socket__delete(ctx->xsk);
+    if (ctx->umem) xsk_umem__delete(ctx->umem);
+    if (ctx->umemArea && ctx->umemArea != MAP_FAILED) munmap(ctx->umemArea, ctx->umemSize);
+    munmap(ctx, sizeof(*ctx));
+}
+
+int32_t PK_XDP_Open(sPoKeysDevice* device, const sPoKeysXDPConfig* config)
+{
+    if (!device || !config || config->ifname[0] == 0 || config->remoteIP == 0)
+        return PK_ERR_PARAMETER;
+    if (device->xdpTransport) return PK_OK;
+
+    // Locked like the UMEM (the RT thread uses it), and released on every error path
+    sPoKeysXDPContext *ctx = mmap(NULL, sizeof(sPoKeysXDPContext), PROT_READ | PROT_WRITE,
+                                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE | MAP_LOCKED, -1, 0);
+    if (ctx == MAP_FAILED) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: context mmap failed, errno=%d\n",
+                        __FILE__, __FUNCTION__, errno);
+        return PK_ERR_GENERIC;
+    }
+
+    ctx->localIP = config->localIP;
+    ctx->remoteIP = config->remoteIP;
+    memcpy(ctx->localMAC, config->localMAC, 6);
+    memcpy(ctx->remoteMAC, config->remoteMAC, 6);
+    ctx->localPort = htons(config->localPort ? config->localPort : PK_XDP_PORT);
+    ctx->copyMode = config->nativeMode ? 0 : 1;
+
+    if (pk_xdp_read_interface(config->ifname,
+                              pk_xdp_mac_is_zero(ctx->localMAC) ? ctx->localMAC : NULL,
+                              ctx->localIP == 0 ? &ctx->localIP : NULL) < 0) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: cannot read address of %s\n",
+                        __FILE__, __FUNCTION__, config->ifname);
+        pk_xdp_release(ctx);
+        return PK_ERR_PARAMETER;
+    }
+    if (pk_xdp_mac_is_zero(ctx->remoteMAC) && pk_xdp_lookup_arp(ctx->remoteIP, ctx->remoteMAC) < 0) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: device MAC not in ARP cache - set remoteMAC\n",
+                        __FILE__, __FUNCTION__);
+        pk_xdp_release(ctx);
+        return PK_ERR_PARAMETER;
+    }
+
+    // UMEM must be page aligned and stay resident for the RT thread
+    ctx->umemSize = (uint64_t)PK_XDP_FRAME_COUNT * PK_XDP_FRAME_SIZE;
+    ctx->umemArea = mmap(NULL, ctx->umemSize, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE | MAP_LOCKED, -1, 0);
+    if (ctx->umemArea == MAP_FAILED) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: UMEM mmap failed, errno=%d\n",
+                        __FILE__, __FUNCTION__, errno);
+        pk_xdp_release(ctx);
+        return PK_ERR_GENERIC;
+    }
+
+    struct xsk_umem_config umemCfg = {
+        .fill_size = PK_XDP_RING_SIZE,
+        .comp_size = PK_XDP_RING_SIZE,
+        .frame_size = PK_XDP_FRAME_SIZE,
+        .frame_headroom = 0,
+        .flags = 0,
+    };
+    int ret = xsk_umem__create(&ctx->umem, ctx->umemArea, ctx->umemSize,
+                               &ctx->fill, &ctx->comp, &umemCfg);
+    if (ret) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: xsk_umem__create failed (%d)\n",
+                        __FILE__, __FUNCTION__, ret);
+        ctx->umem = NULL;
+        pk_xdp_release(ctx);
+        return PK_ERR_GENERIC;
+    }
+
+    struct xsk_socket_config sockCfg;
+    memset(&sockCfg, 0, sizeof(sockCfg));
+    sockCfg.rx_size = PK_XDP_RING_SIZE;
+    sockCfg.tx_size = PK_XDP_RING_SIZE;
+    sockCfg.xdp_flags = config->nativeMode ? XDP_FLAGS_DRV_MODE : XDP_FLAGS_SKB_MODE;
+    sockCfg.bind_flags = config->nativeMode ? XDP_USE_NEED_WAKEUP : XDP_COPY;
+
+    ret = xsk_socket__create(&ctx->xsk, config->ifname, config->queueID, ctx->umem,
+                             &ctx->rx, &ctx->tx, &sockCfg);
+    if (ret) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: xsk_socket__create on %s/%u failed (%d)\n",
+                        __FILE__, __FUNCTION__, config->ifname, config->queueID, ret);
+        ctx->xsk = NULL;
+        pk_xdp_release(ctx);
+        return PK_ERR_GENERIC;
+    }
+
+    // First half of the UMEM feeds the RX fill ring, second half is the TX pool
+    uint32_t idx;
+    if (xsk_ring_prod__reserve(&ctx->fill, PK_XDP_RX_FRAMES, &idx) != PK_XDP_RX_FRAMES) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: cannot populate fill ring\n", __FILE__, __FUNCTION__);
+        pk_xdp_release(ctx);
+        return PK_ERR_GENERIC;
+    }
+    for (uint32_t i = 0; i < PK_XDP_RX_FRAMES; i++)
+        *xsk_ring_prod__fill_addr(&ctx->fill, idx++) = (uint64_t)i * PK_XDP_FRAME_SIZE;
+    xsk_ring_prod__submit(&ctx->fill, PK_XDP_RX_FRAMES);
+
+    for (uint32_t i = 0; i < PK_XDP_TX_FRAMES; i++)
+        ctx->txFree[i] = (uint64_t)(PK_XDP_RX_FRAMES + i) * PK_XDP_FRAME_SIZE;
+    ctx->txFreeCount = PK_XDP_TX_FRAMES;
+
+    device->xdpTransport = ctx;
+
+    rtapi_print_msg(RTAPI_MSG_INFO, "PoKeys: %s:%s: AF_XDP transport on %s queue %u (%s mode)\n",
+                    __FILE__, __FUNCTION__, config->ifname, config->queueID,
+                    config->nativeMode ? "native" : "generic");
+    return PK_OK;
+}
+
+void PK_XDP_Close(sPoKeysDevice* device)
+{
+    if (!device || !device->xdpTransport) return;
+    sPoKeysXDPContext *ctx = (sPoKeysXDPContext *)device->xdpTransport;
+
+    device->xdpTransport = NULL;
+    pk_xdp_release(ctx);
+}
+
+/* ------------------------------------------------------------------------- */
+/* RT path                                                                   */
+/* ------------------------------------------------------------------------- */
+
+static uint16_t pk_xdp_ip_checksum(const void *hdr, size_t len)
+{
+    const uint16_t *p = (const uint16_t *)hdr;
+    uint32_t sum = 0;
+    for (size_t i = 0; i < len / 2; i++) sum += p[i];
+    while (sum >> 16) sum = (sum & 0xFFFF) + (sum >> 16);
+    return (uint16_t)~sum;
+}
+
+// Returns completed TX frames to the free stack
+static void pk_xdp_reap_tx(sPoKeysXDPContext *ctx)
+{
+    uint32_t idx;
+    uint32_t done = xsk_ring_cons__peek(&ctx->comp, PK_XDP_TX_FRAMES, &idx);
+    for (uint32_t i = 0; i < done; i++)
+        ctx->txFree[ctx->txFreeCount++] = *xsk_ring_cons__comp_addr(&ctx->comp, idx++);
+    if (done) xsk_ring_cons__release(&ctx->comp, done);
+}
+
+static int pk_xdp_transmit(sPoKeysXDPContext *ctx, uint64_t addr, uint32_t frameLen)
+{
+    uint32_t idx;
+    if (xsk_ring_prod__reserve(&ctx->tx, 1, &idx) != 1) {
+        ctx->txFree[ctx->txFreeCount++] = addr;
+        ctx->stats.txNoFrame++;
+        return PK_ERR_TRANSFER;
+    }
+    struct xdp_desc *desc = xsk_ring_prod__tx_desc(&ctx->tx, idx);
+    desc->addr = addr;
+    desc->len = frameLen;
+    xsk_ring_prod__submit(&ctx->tx, 1);
+
+    // Copy mode always needs the kick; zero-copy only when the driver asks
+    if (ctx->copyMode || xsk_ring_prod__needs_wakeup(&ctx->tx)) {
+        if (sendto(xsk_socket__fd(ctx->xsk), NULL, 0, MSG_DONTWAIT, NULL, 0) < 0 &&
+            errno != EAGAIN && errno != EBUSY && errno != ENOBUFS) {
+            return PK_ERR_TRANSFER;
+        }
+    }
+    return PK_OK;
+}
+
+int32_t PK_XDP_Send(sPoKeysDevice* device, const uint8_t* buffer, size_t len)
+{
+    if (!device || !device->xdpTransport || !buffer || len == 0 || len > PK_XDP_MAX_PAYLOAD)
+        return PK_ERR_PARAMETER;
+    sPoKeysXDPContext *ctx = (sPoKeysXDPContext *)device->xdpTransport;
+
+    pk_xdp_reap_tx(ctx);
+    if (ctx->txFreeCount == 0) {
+        ctx->stats.txNoFrame++;
+        return PK_ERR_TRANSFER;
+    }
+    uint64_t addr = ctx->txFree[--ctx->txFreeCount];
+    uint8_t *frame = xsk_umem__get_data(ctx->umemArea, addr);
+
+    struct ethhdr *eth = (struct ethhdr *)frame;
+    struct iphdr *ip = (struct iphdr *)(eth + 1);
+    struct udphdr *udp = (struct udphdr *)(ip + 1);
+
+    memcpy(eth->h_dest, ctx->remoteMAC, 6);
+    memcpy(eth->h_source, ctx->localMAC, 6);
+    eth->h_proto = htons(ETH_P_IP);
+
+    ip->version = 4;
+    ip->ihl = 5;
+    ip->tos = 0;
+    ip->tot_len = htons((uint16_t)(sizeof(struct iphdr) + sizeof(struct udphdr) + len));
+    ip->id = htons(ctx->ipID++);
+    ip->frag_off = htons(0x4000);  // DF
+    ip->ttl = 64;
+    ip->protocol = IPPROTO_UDP;
+    ip->check = 0;
+    ip->saddr = ctx->localIP;
+    ip->daddr = ctx->remoteIP;
+    ip->check = pk_xdp_ip_checksum(ip, sizeof(struct iphdr));
+
+    udp->source = ctx->localPort;
+    udp->dest = htons(PK_XDP_PORT);
+    udp->len = htons((uint16_t)(sizeof(struct udphdr) + len));
+    udp->check = 0;  // Optional for IPv4
+
+    memcpy(frame + PK_XDP_HDR_LEN, buffer, len);
+
+    int ret = pk_xdp_transmit(ctx, addr, (uint32_t)(PK_XDP_HDR_LEN + len));
+    if (ret != PK_OK) return ret;
+
+    ctx->stats.txPackets++;
+    return (int32_t)len;
+}
+
+// Answers "who-has <localIP>" so the device can keep resolving the host
+static void pk_xdp_arp_reply(sPoKeysXDPContext *ctx, const uint8_t *req)
+{
+    pk_xdp_reap_tx(ctx);
+    if (ctx->txFreeCount == 0) return;
+
+    uint64_t addr = ctx->txFree[--ctx->txFreeCount];
+    uint8_t *frame = xsk_umem__get_data(ctx->umemArea, addr);
+
+    memcpy(frame, req + 6, 6);               // dst = requester
+    memcpy(frame + 6, ctx->localMAC, 6);
+    frame[12] = 0x08; frame[13] = 0x06;
+    memcpy(frame + 14, req + 14, 6);         // htype, ptype, hlen, plen
+    frame[20] = 0x00; frame[21] = 0x02;      // op = reply
+    memcpy(frame + 22, ctx->localMAC, 6);    // sha
+    memcpy(frame + 28, &ctx->localIP, 4);    // spa
+    memcpy(frame + 32, req + 22, 10);        // tha/tpa = requester sha/spa
+
+    if (pk_xdp_transmit(ctx, addr, 42) == PK_OK)
+        ctx->stats.arpReplies++;
+}
+
+// Hands RX frames back to the kernel; frames the fill ring has no room for
+// now are kept and retried on the next call, so none is lost for good
+static void pk_xdp_refill(sPoKeysXDPContext *ctx)
+{
+    uint32_t n = ctx->rxRefillCount, fidx;
+    if (n == 0) return;
+    if (xsk_ring_prod__reserve(&ctx->fill, n, &fidx) != n) return;
+    for (uint32_t i = 0; i < n; i++)
+        *xsk_ring_prod__fill_addr(&ctx->fill, fidx++) = ctx->rxRefill[i];
+    xsk_ring_prod__submit(&ctx->fill, n);
+    ctx->rxRefillCount = 0;
+}
+
+int32_t PK_XDP_Recv(sPoKeysDevice* device, uint8_t* buffer, size_t len)
+{
+    if (!device || !device->xdpTransport || !buffer) return PK_ERR_PARAMETER;
+    sPoKeysXDPContext *ctx = (sPoKeysXDPContext *)device->xdpTransport;
+    int32_t result = 0;
+
+    pk_xdp_refill(ctx);
+
+    // Consume frames until one PoKeys datagram is found or the ring is empty
+    while (result == 0) {
+        uint32_t idx;
+        if (xsk_ring_cons__peek(&ctx->rx, 1, &idx) != 1)
+            break;
+
+        const struct xdp_desc *desc = xsk_ring_cons__rx_desc(&ctx->rx, idx);
+        uint64_t addr = xsk_umem__extract_addr(desc->addr);
+        const uint8_t *frame = xsk_umem__get_data(ctx->umemArea, xsk_umem__add_offset_to_addr(desc->addr));
+        uint32_t frameLen = desc->len;
+        const struct ethhdr *eth = (const struct ethhdr *)frame;
+
+        if (frameLen >= 42 && eth->h_proto == htons(ETH_P_ARP) &&
+            frame[21] == 0x01 && memcmp(frame + 38, &ctx->localIP, 4) == 0) {
+            pk_xdp_arp_reply(ctx, frame);
+        } else if (frameLen > PK_XDP_HDR_LEN && eth->h_proto == htons(ETH_P_IP)) {
+            const struct iphdr *ip = (const struct iphdr *)(eth + 1);
+            // IP options move the UDP header; both headers must lie inside the frame
+            size_t udpOff = sizeof(struct ethhdr) + (size_t)ip->ihl * 4;
+            const struct udphdr *udp = (const struct udphdr *)(frame + udpOff);
+            const uint8_t *payload = (const uint8_t *)(udp + 1);
+
+            if (ip->ihl >= 5 && udpOff + sizeof(struct udphdr) <= frameLen &&
+                ip->protocol == IPPROTO_UDP && ip->saddr == ctx->remoteIP &&
+                udp->source == htons(PK_XDP_PORT) && udp->dest == ctx->localPort &&
+                ntohs(udp->len) >= sizeof(struct udphdr)) {
+                size_t plen = ntohs(udp->len) - sizeof(struct udphdr);
+                if (payload + plen > frame + frameLen) plen = (size_t)(frame + frameLen - payload);
+                if (plen > len) plen = len;
+                memcpy(buffer, payload, plen);
+                ctx->stats.rxPackets++;
+                result = (int32_t)plen;
+            } else {
+                ctx->stats.rxDropped++;
+            }
+        } else {
+            ctx->stats.rxDropped++;
+        }
+
+        xsk_ring_cons__release(&ctx->rx, 1);
+
+        // Hand the frame straight back to the kernel
+        ctx->rxRefill[ctx->rxRefillCount++] = addr;
+        pk_xdp_refill(ctx);
+    }
+
+    return result;
+}
+
+const sPoKeysXDPStats* PK_XDP_GetStats(const sPoKeysDevice* device)
+{
+    if (!device || !device->xdpTransport) return NULL;
+    return &((const sPoKeysXDPContext *)device->xdpTransport)->stats;
+}
+
+#else /* !POKEYSLIB_USE_XDP */
+
+int32_t PK_XDP_Open(sPoKeysDevice* device, const sPoKeysXDPConfig* config)
+{
+    (void)device; (void)config;
+    rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: built without POKEYSLIB_USE_XDP\n", __FILE__, __FUNCTION__);
+    return PK_ERR_NOT_SUPPORTED;
+}
+
+void PK_XDP_Close(sPoKeysDevice* device)
+{
+    (void)device;
+}
+
+int32_t PK_XDP_Send(sPoKeysDevice* device, const uint8_t* buffer, size_t len)
+{
+    (void)device; (void)buffer; (void)len;
+    return PK_ERR_NOT_SUPPORTED;
+}
+
+int32_t PK_XDP_Recv(sPoKeysDevice* device, uint8_t* buffer, size_t len)
+{
+    (void)device; (void)buffer; (void)len;
+    return PK_ERR_NOT_SUPPORTED;
+}
+
+const sPoKeysXDPStats* PK_XDP_GetStats(const sPoKeysDevice* device)
+{
+    (void)device;
+    return NULL;
+}
+
+#endif /* POKEYSLIB_USE_XDP */
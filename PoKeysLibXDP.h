@@ -0,0 +1,88 @@
+#ifndef POKEYSLIBXDP_H
+#define POKEYSLIBXDP_H
+#include "PoKeysLibHal.h"
+
+/*
+ * Optional AF_XDP transport for PoKeys UDP traffic.
+ *
+ * When enabled (build with -DPOKEYSLIB_USE_XDP and link -lxdp -lbpf), the
+ * async engine sends and receives PoKeys datagrams through an AF_XDP socket
+ * instead of the kernel UDP stack.  Ethernet/IPv4/UDP headers for port 20055
+ * are built and parsed here, and the UMEM rings are polled without blocking
+ * from the caller's (RT) thread.
+ *
+ * The socket is bound in generic (SKB) copy mode by default so the path can
+ * be exercised on a veth pair against the device simulator.  The interface
+ * queue is owned by the transport: ARP requests for the local address are
+ * answered here, every other non-PoKeys frame on the queue is dropped.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    #define PK_XDP_PORT            20055
+    #define PK_XDP_FRAME_COUNT     256     // UMEM frames (half RX, half TX)
+
+    typedef struct {
+        char     ifname[16];               // Interface bound to the PoKeys network (e.g. "veth1")
+        uint32_t queueID;                  // NIC queue to attach to
+        uint32_t localIP;                  // Host IPv4 address (network order), 0 = read from interface
+        uint32_t remoteIP;                 // Device IPv4 address (network order)
+        uint8_t  localMAC[6];              // Host MAC, all zero = read from interface
+        uint8_t  remoteMAC[6];             // Device MAC, all zero = look up in ARP cache
+        uint16_t localPort;                // Host UDP port, 0 = PK_XDP_PORT
+        uint8_t  nativeMode;               // 0 = generic (SKB) copy mode, 1 = native driver mode
+        uint8_t  reserved;
+    } sPoKeysXDPConfig;
+
+    typedef struct {
+        uint32_t txPackets;
+        uint32_t rxPackets;
+        uint32_t rxDropped;                // Frames on the queue that were not PoKeys responses
+        uint32_t txNoFrame;                // Sends rejected because no TX frame/ring slot was free
+        uint32_t arpReplies;
+    } sPoKeysXDPStats;
+
+    /**
+     * @brief Creates the AF_XDP socket and UMEM and attaches it to the device.
+     *
+     * Not RT-safe (allocates, loads the XDP program); call during setup.
+     * Once attached, SendRequestAsync/PK_ReceiveAndDispatch and the retry
+     * path in PK_TimeoutAndRetryCheck use this transport for the device.
+     *
+     * @return PK_OK on success, PK_ERR_GENERIC/PK_ERR_PARAMETER on failure.
+     */
+    int32_t PK_XDP_Open(sPoKeysDevice* device, const sPoKeysXDPConfig* config);
+
+    /**
+     * @brief Detaches and releases the AF_XDP transport of a device.
+     */
+    void PK_XDP_Close(sPoKeysDevice* device);
+
+    /**
+     * @brief Queues one PoKeys datagram (up to 512 bytes) for transmission.
+     *
+     * @return Number of payload bytes queued, or negative error code.
+     */
+    int32_t PK_XDP_Send(sPoKeysDevice* device, const uint8_t* buffer, size_t len);
+
+    /**
+     * @brief Polls the RX ring for the next PoKeys datagram from the device.
+     *
+     * Non-blocking.  Non-matching frames are consumed and counted.
+     *
+     * @return Number of payload bytes copied, 0 if none pending, negative on error.
+     */
+    int32_t PK_XDP_Recv(sPoKeysDevice* device, uint8_t* buffer, size_t len);
+
+    /**
+     * @brief Returns the transport counters, or NULL if no transport is attached.
+     */
+    const sPoKeysXDPStats* PK_XDP_GetStats(const sPoKeysDevice* device);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // POKEYSLIBXDP_H
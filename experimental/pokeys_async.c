@@ -10,6 +10,7 @@
 #include "rtapi_math64.h"
 #include "PoKeysLibHal.h"
 #include "PoKeysLibAsync.h"
+#include "hal_priv.h"
 
 // Include math.h for fabs() function
 #include <math.h>
@@ -61,15 +62,31 @@ struct __comp_state {
     hal_bit_t *alive;
 
     sPoKeysDevice *dev;
+
+    // Pin groups actually exported (ePK_DemandClass bits) and what it cost
+    uint32_t export_groups;
+    hal_u32_t *export_groups_pin;
+    hal_u32_t *export_time_us;
+    hal_u32_t *export_shmem_bytes;
     
     // Motion buffer mode state (per-instance)
-    float mb_last_pos[8];       // last commanded position per axis (for delta calculation)
-    float mb_pulses_leftover[8]; // fractional pulse accumulator per axis
+    bool mb_active;             // motion stream was running in the previous cycle
 };
 
 #include <stdlib.h>
 struct __comp_state *__comp_first_inst=0, *__comp_last_inst=0;
 static int extra_setup(struct __comp_state *__comp_inst, char *prefix, long extra_arg);
+static int export_cmd_queue_pins(const char *prefix, long comp_id);
+static int export_groups_select(const sPoKeysDevice *dev, uint32_t *mask_out);
+
+// Pin groups selectable with groups=, as ePK_DemandClass bits
+#define PK_EXPORT_IO      ((1u << PK_DEMAND_DIGIN) | (1u << PK_DEMAND_DIGOUT) | \
+                           (1u << PK_DEMAND_ADCIN) | (1u << PK_DEMAND_ADCOUT))
+#define PK_EXPORT_ENCODER (1u << PK_DEMAND_ENCODER)
+#define PK_EXPORT_PONET   (1u << PK_DEMAND_PONET)
+#define PK_EXPORT_PEV2    (1u << PK_DEMAND_PEV2)
+#define PK_EXPORT_RTC     (1u << PK_DEMAND_RTC)
+extern char *groups;
 uint32_t device_id = 0;
 
 static void _(struct __comp_state *__comp_inst, long period);
@@ -97,40 +114,126 @@ static int export(char *prefix, long extra_arg) {
         rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: extra_setup failed\n", __FILE__, __FUNCTION__);
         return r;
     }
-    rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: exporting component - export_rtc_pins %s\n", __FILE__, __FUNCTION__, prefix);
-    r = export_rtc_pins(prefix, comp_id, inst->dev); // Export RTC pins
+    r = export_groups_select(inst->dev, &inst->export_groups);
+    if(r != 0){
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: invalid groups= '%s'\n", __FILE__, __FUNCTION__, groups);
+        return r;
+    };
+    long shmem_before = hal_data->shmem_avail;
+    int64_t export_start = rtapi_get_time();
+
+    if (inst->export_groups & PK_EXPORT_RTC) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: exporting component - export_rtc_pins %s\n", __FILE__, __FUNCTION__, prefix);
+        r = export_rtc_pins(prefix, comp_id, inst->dev); // Export RTC pins
+        if(r != 0){
+            rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: export_rtc_pins faile %d \n", __FILE__, __FUNCTION__, prefix, r);
+            return r;
+        };
+    }
+    if (inst->export_groups & PK_EXPORT_ENCODER) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: exporting component - export_encoder_pins %s\n", __FILE__, __FUNCTION__, prefix);
+        r=export_encoder_pins(prefix, comp_id, inst->dev); // Export encoder pins
+        if(r != 0){
+            rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: export_encoder_pins failed %d \n", __FILE__, __FUNCTION__, prefix, r);
+            return r;
+        };
+    }
+    if (inst->export_groups & PK_EXPORT_IO) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: exporting component - export_IO_pins %s\n", __FILE__, __FUNCTION__, prefix);
+        r=export_IO_pins(prefix, comp_id, inst->dev); // Export IO pins
+        if(r != 0){
+            rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: export_IO_pins failed %d \n", __FILE__, __FUNCTION__, prefix, r);
+            return r;
+        };
+    }
+    
+    // Export PoNET HAL pins - NEW
+    if (inst->export_groups & PK_EXPORT_PONET) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: exporting component - export_ponet_pins %s\n", __FILE__, __FUNCTION__, prefix);
+        r = export_ponet_pins(prefix, comp_id, inst->dev);
+        if(r != 0){
+            rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: export_ponet_pins failed %d \n", __FILE__, __FUNCTION__, r);
+            return r;
+        };
+    }
+    
+    // Export PEv2 HAL pins - NEW
+    // Motion stream and priority lane work on PEv2 pins and come with them
+    if (inst->export_groups & PK_EXPORT_PEV2) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: exporting component - export_pev2_pins %s\n", __FILE__, __FUNCTION__, prefix);
+        r = export_pev2_pins(prefix, comp_id, inst->dev);
+        if(r != 0){
+            rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: export_pev2_pins failed %d \n", __FILE__, __FUNCTION__, r);
+            return r;
+        };
+
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: exporting component - export_motion_stream_pins %s\n", __FILE__, __FUNCTION__, prefix);
+        r = PK_MotionStreamCreate(inst->dev);
+        if(r == 0) r = export_motion_stream_pins(prefix, comp_id, inst->dev);
+        if(r != 0){
+            rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: export_motion_stream_pins failed %d \n", __FILE__, __FUNCTION__, r);
+            return r;
+        };
+
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: exporting component - export_priority_lane_pins %s\n", __FILE__, __FUNCTION__, prefix);
+        r = PK_PriorityLaneCreate(inst->dev);
+        if(r == 0) r = export_priority_lane_pins(prefix, comp_id, inst->dev);
+        if(r != 0){
+            rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: export_priority_lane_pins failed %d \n", __FILE__, __FUNCTION__, r);
+            return r;
+        };
+    }
+
+    rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: exporting component - export_snapshot_pins %s\n", __FILE__, __FUNCTION__, prefix);
+    r = PK_SnapshotCreate(inst->dev);
+    if(r == 0) r = export_snapshot_pins(prefix, comp_id, inst->dev);
     if(r != 0){
-        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: export_rtc_pins faile %d \n", __FILE__, __FUNCTION__, prefix, r);
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: export_snapshot_pins failed %d \n", __FILE__, __FUNCTION__, r);
         return r;
     };
-    rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: exporting component - export_encoder_pins %s\n", __FILE__, __FUNCTION__, prefix);
-    r=export_encoder_pins(prefix, comp_id, inst->dev); // Export encoder pins
+
+    rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: exporting component - export_shadow_pins %s\n", __FILE__, __FUNCTION__, prefix);
+    r = PK_ShadowCreate(inst->dev);
+    if(r == 0) r = export_shadow_pins(prefix, comp_id, inst->dev);
     if(r != 0){
-        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: export_encoder_pins failed %d \n", __FILE__, __FUNCTION__, prefix, r);
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: export_shadow_pins failed %d \n", __FILE__, __FUNCTION__, r);
         return r;
     };
-    rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: exporting component - export_IO_pins %s\n", __FILE__, __FUNCTION__, prefix);
-    r=export_IO_pins(prefix, comp_id, inst->dev); // Export IO pins
+
+    rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: exporting component - export_demand_pins %s\n", __FILE__, __FUNCTION__, prefix);
+    r = PK_DemandCreate(inst->dev, comp_id, prefix, inst->export_groups);
+    if(r == 0) r = export_demand_pins(prefix, comp_id, inst->dev);
     if(r != 0){
-        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: export_IO_pins failed %d \n", __FILE__, __FUNCTION__, prefix, r);
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: export_demand_pins failed %d \n", __FILE__, __FUNCTION__, r);
         return r;
     };
-    
-    // Export PoNET HAL pins - NEW
-    rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: exporting component - export_ponet_pins %s\n", __FILE__, __FUNCTION__, prefix);
-    r = export_ponet_pins(prefix, comp_id, inst->dev);
+
+    rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: exporting component - export_arena_pins %s\n", __FILE__, __FUNCTION__, prefix);
+    r = export_arena_pins(prefix, comp_id, inst->dev);
     if(r != 0){
-        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: export_ponet_pins failed %d \n", __FILE__, __FUNCTION__, r);
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: export_arena_pins failed %d \n", __FILE__, __FUNCTION__, r);
         return r;
     };
-    
-    // Export PEv2 HAL pins - NEW
-    rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: exporting component - export_pev2_pins %s\n", __FILE__, __FUNCTION__, prefix);
-    r = export_pev2_pins(prefix, comp_id, inst->dev);
+
+    r = export_cmd_queue_pins(prefix, comp_id);
+    if(r != 0){
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: export_cmd_queue_pins failed %d \n", __FILE__, __FUNCTION__, r);
+        return r;
+    };
+
+    r = hal_pin_u32_newf(HAL_OUT, &(inst->export_groups_pin), comp_id, "%s.export.groups", prefix);
+    if(r == 0) r = hal_pin_u32_newf(HAL_OUT, &(inst->export_time_us), comp_id, "%s.export.time-us", prefix);
+    if(r == 0) r = hal_pin_u32_newf(HAL_OUT, &(inst->export_shmem_bytes), comp_id, "%s.export.shmem-bytes", prefix);
     if(r != 0){
-        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: export_pev2_pins failed %d \n", __FILE__, __FUNCTION__, r);
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: export pins failed %d \n", __FILE__, __FUNCTION__, r);
         return r;
     };
+    *(inst->export_groups_pin) = inst->export_groups;
+    *(inst->export_time_us) = (hal_u32_t)((rtapi_get_time() - export_start) / 1000);
+    *(inst->export_shmem_bytes) = (hal_u32_t)(shmem_before - hal_data->shmem_avail);
+    rtapi_print_msg(RTAPI_MSG_INFO, "PoKeys: %s: exported groups 0x%02x in %u us using %u bytes of HAL shared memory\n",
+                    prefix, (unsigned)inst->export_groups, (unsigned)*(inst->export_time_us),
+                    (unsigned)*(inst->export_shmem_bytes));
 
 #ifdef RTAPI
     rtapi_snprintf(buf, sizeof(buf), "%s", prefix);
@@ -150,6 +253,10 @@ RTAPI_MP_STRING(names, "names of pokeys_async");
 #else
 char *names[16] = {0,};
 #endif
+char *groups = ""; // comma separated pin groups, empty = all the device supports
+#ifdef RTAPI
+RTAPI_MP_STRING(groups, "pin groups to export: io,encoder,pev2,ponet,rtc");
+#endif
 int rtapi_app_main(void) {
     int r = 0;
     int i;
@@ -207,6 +314,7 @@ int rtapi_app_main(void) {
     if(r) {
         hal_exit(comp_id);
     } else {
+        PK_ArenaSealAll(); // Device memory is complete, count anything later
         hal_ready(comp_id);
     }
     return r;
@@ -262,12 +370,29 @@ int __comp_parse_names(int *argc, char **argv) {
     return 0;
 }
 
+int __comp_parse_groups(int *argc, char **argv) {
+    int i;
+    for (i = 0; i < *argc; i ++) {
+        if (strncmp(argv[i], "groups=", 7) == 0) {
+            groups = &argv[i][7];
+            for (; i+1 < *argc; i ++) {
+                argv[i] = argv[i+1];
+            }
+            argv[i] = NULL;
+            (*argc)--;
+            return 1;
+        }
+    }
+    return 0;
+}
+
 int argc=0; char **argv=0;
 int main(int argc_, char **argv_) {
     argc = argc_; argv = argv_;
     int found_count, found_names;
     found_count = __comp_parse_count(&argc, argv);
     found_names = __comp_parse_names(&argc, argv);
+    __comp_parse_groups(&argc, argv);
     if (found_count && found_names) {
         rtapi_print_msg(RTAPI_MSG_ERR, "count= and names= are mutually exclusive\n");
         return 1;
@@ -304,52 +429,160 @@ int main(int argc_, char **argv_) {
 // Global data structures
 static rt_motion_data_t motion_data;
 static async_command_queue_t cmd_queue = {0};
+static struct {
+    hal_u32_t *level;       // HAL_OUT commands waiting in the ring
+    hal_u32_t *high_water;  // HAL_OUT highest level seen
+    hal_u32_t *drops;       // HAL_OUT commands rejected because the ring was full
+    hal_bit_t *full;        // HAL_OUT back-pressure: ring is 3/4 full or dropped since last cycle
+} cmd_queue_pins;
 static device_status_cache_t device_cache = {0};
 
 // Thread control
 static bool async_processing_enabled = false;
 
-// Async command queue functions
-static bool enqueue_async_command(const async_command_t *cmd) {
-    if (cmd_queue.count >= MAX_ASYNC_COMMANDS) {
+// Async command queue functions - the ring itself is in PoKeysLibCmdQueue.h
+static void cmd_queue_init(void) {
+    async_cmd_queue_init(&cmd_queue);
+}
+
+static async_command_t *cmd_queue_reserve(uint32_t *pos_out) {
+    async_command_t *cmd = async_cmd_queue_reserve(&cmd_queue, pos_out);
+    if (!cmd)
         rtapi_print_msg(RTAPI_MSG_WARN, "PoKeys: Async command queue full\n");
-        return false;
+    return cmd;
+}
+
+static void cmd_queue_commit(uint32_t pos) {
+    async_cmd_queue_commit(&cmd_queue, pos);
+}
+
+static async_command_t *cmd_queue_peek(void) {
+    return async_cmd_queue_peek(&cmd_queue);
+}
+
+static void cmd_queue_release(void) {
+    async_cmd_queue_release(&cmd_queue);
+}
+
+static void cmd_queue_publish_hal(void) {
+    uint32_t level = __atomic_load_n(&cmd_queue.enqueue_pos, __ATOMIC_RELAXED) - cmd_queue.dequeue_pos;
+    uint32_t drops = __atomic_load_n(&cmd_queue.drops, __ATOMIC_RELAXED);
+    static uint32_t last_drops = 0;
+
+    if (level > MAX_ASYNC_COMMANDS) level = MAX_ASYNC_COMMANDS; // Producer mid-claim
+    if (level > cmd_queue.high_water) cmd_queue.high_water = level;
+
+    if (cmd_queue_pins.level)      *cmd_queue_pins.level      = level;
+    if (cmd_queue_pins.high_water) *cmd_queue_pins.high_water = cmd_queue.high_water;
+    if (cmd_queue_pins.drops)      *cmd_queue_pins.drops      = drops;
+    if (cmd_queue_pins.full)       *cmd_queue_pins.full       = (level >= (MAX_ASYNC_COMMANDS * 3) / 4) ||
+                                                                (drops != last_drops);
+    last_drops = drops;
+}
+
+static const struct {
+    const char *name;
+    uint32_t    classes;
+} export_group_names[] = {
+    { "io",      PK_EXPORT_IO },
+    { "encoder", PK_EXPORT_ENCODER },
+    { "pev2",    PK_EXPORT_PEV2 },
+    { "ponet",   PK_EXPORT_PONET },
+    { "rtc",     PK_EXPORT_RTC },
+};
+
+/*
+ * Pin groups to export: the groups= list (empty: all), restricted to what the
+ * device reports.  Device info is read on connect, before export() runs, so
+ * e.g. the 8 PEv2 axes or 16 PoNET modules are only exported when present.
+ */
+static int export_groups_select(const sPoKeysDevice *dev, uint32_t *mask_out) {
+    uint32_t mask = 0;
+    const char *p = groups ? groups : "";
+
+    if (*p == '\0') {
+        mask = ~0u;
+    } else {
+        while (*p) {
+            size_t len = 0;
+            while (p[len] && p[len] != ',') len++;
+            size_t g;
+            for (g = 0; g < sizeof(export_group_names) / sizeof(export_group_names[0]); g++) {
+                if (strlen(export_group_names[g].name) == len &&
+                    strncmp(p, export_group_names[g].name, len) == 0)
+                    break;
+            }
+            if (g == sizeof(export_group_names) / sizeof(export_group_names[0]))
+                return -EINVAL;
+            mask |= export_group_names[g].classes;
+            p += len;
+            if (*p == ',') p++;
+        }
     }
-    
-    cmd_queue.commands[cmd_queue.head] = *cmd;
-    cmd_queue.commands[cmd_queue.head].processed = false;
-    cmd_queue.head = (cmd_queue.head + 1) % MAX_ASYNC_COMMANDS;
-    __atomic_fetch_add(&cmd_queue.count, 1, __ATOMIC_SEQ_CST);
-    return true;
+
+    if (dev->info.iPinCount == 0)         mask &= ~PK_EXPORT_IO;
+    if (dev->info.iBasicEncoderCount == 0) mask &= ~PK_EXPORT_ENCODER;
+    if (!dev->info.iPoNET)                mask &= ~PK_EXPORT_PONET;
+    if (!dev->info.iPulseEnginev2)        mask &= ~PK_EXPORT_PEV2;
+
+    *mask_out = mask & (PK_EXPORT_IO | PK_EXPORT_ENCODER | PK_EXPORT_PONET |
+                        PK_EXPORT_PEV2 | PK_EXPORT_RTC);
+    return 0;
 }
 
-static bool dequeue_async_command(async_command_t *cmd) {
-    if (cmd_queue.count <= 0) return false;
-    
-    *cmd = cmd_queue.commands[cmd_queue.tail];
-    cmd_queue.tail = (cmd_queue.tail + 1) % MAX_ASYNC_COMMANDS;
-    __atomic_fetch_sub(&cmd_queue.count, 1, __ATOMIC_SEQ_CST);
-    return true;
+static int export_cmd_queue_pins(const char *prefix, long comp_id) {
+    int r;
+
+    r = hal_pin_u32_newf(HAL_OUT, &(cmd_queue_pins.level), comp_id, "%s.cmd-queue-level", prefix);
+    if (r != 0) {
+        rtapi_print_msg(RTAPI_MSG_ERR, "PoKeys: %s:%s: %s.cmd-queue-level failed\n", __FILE__, __FUNCTION__, prefix);
+        return r;
+    }
+
+    r = hal_pin_u32_newf(HAL_OUT, &(cmd_queue_pins.high_water), comp_id, "%s.cmd-queue-high-water", prefix);
+    if (r != 0) return r;
+
+    r = hal_pin_u32_newf(HAL_OUT, &(cmd_queue_pins.drops), comp_id, "%s.cmd-queue-drops", prefix);
+    if (r != 0) return r;
+
+    r = hal_pin_bit_newf(HAL_OUT, &(cmd_queue_pins.full), comp_id, "%s.cmd-queue-full", prefix);
+    if (r != 0) return r;
+
+    *(cmd_queue_pins.level) = 0;
+    *(cmd_queue_pins.high_water) = 0;
+    *(cmd_queue_pins.drops) = 0;
+    *(cmd_queue_pins.full) = 0;
+    return 0;
 }
 
 static bool queue_move_pv_command(uint8_t axis_mask, const float *positions, const float *velocities) {
-    async_command_t cmd = {
-        .type = CMD_MOVE_PV,
-        .axis_mask = axis_mask
-    };
+    uint32_t pos;
+    async_command_t *cmd = cmd_queue_reserve(&pos);
+    if (!cmd) return false;
+
+    cmd->type = CMD_MOVE_PV;
+    cmd->axis_mask = axis_mask;
+    cmd->misc_data = 0;
+    cmd->processed = false;
     for (int i = 0; i < 8; i++) {
-        cmd.pos_values[i] = positions[i];
-        cmd.vel_values[i] = velocities[i];
+        cmd->pos_values[i] = positions[i];
+        cmd->vel_values[i] = velocities[i];
     }
-    return enqueue_async_command(&cmd);
+    cmd_queue_commit(pos);
+    return true;
 }
 
 static bool queue_homing_start_command(uint8_t axis_mask) {
-    async_command_t cmd = {
-        .type = CMD_HOME_START,
-        .axis_mask = axis_mask
-    };
-    return enqueue_async_command(&cmd);
+    uint32_t pos;
+    async_command_t *cmd = cmd_queue_reserve(&pos);
+    if (!cmd) return false;
+
+    cmd->type = CMD_HOME_START;
+    cmd->axis_mask = axis_mask;
+    cmd->misc_data = 0;
+    cmd->processed = false;
+    cmd_queue_commit(pos);
+    return true;
 }
 
 // Forward declarations for RT processing functions
@@ -812,12 +1045,15 @@ static void rt_update_external_outputs(struct __comp_state *inst) {
         inst->dev->PEv2.ExternalOCOutputs = oc_mask;
         
         // Queue async command
-        async_command_t cmd = {
-            .type = CMD_EXTERNAL_OUTPUT_SET,
-            .axis_mask = 0,
-            .misc_data = (relay_mask << 8) | oc_mask
-        };
-        enqueue_async_command(&cmd);
+        uint32_t pos;
+        async_command_t *cmd = cmd_queue_reserve(&pos);
+        if (cmd) {
+            cmd->type = CMD_EXTERNAL_OUTPUT_SET;
+            cmd->axis_mask = 0;
+            cmd->misc_data = (relay_mask << 8) | oc_mask;
+            cmd->processed = false;
+            cmd_queue_commit(pos);
+        }
     }
     
     // Update feedback pins
@@ -896,99 +1132,68 @@ static void rt_handle_test_mode(struct __comp_state *inst) {
 /*
  * rt_motion_buffer_fill - called each servo cycle in motion buffer mode.
  *
- * Computes the position delta for each enabled axis, converts it to the
- * 8-bit buffer entry format used by the PoKeys device, and appends one
- * time-slot entry to device->PEv2.MotionBuffer.
+ * Encodes this cycle's commanded positions into one 8-bit slot with the
+ * stream's fixed-point encoder and pushes it into the host ring.
  *
  * Buffer entry format (per axis per slot):
  *   bits [6:0] = step count (0-127)
  *   bit  [7]   = direction flag (1 = negative direction)
+ *
+ * Steps beyond 127 per slot are carried into the next slots and counted in
+ * PEv2.N.motion-buf-saturations.
  */
 static void rt_motion_buffer_fill(struct __comp_state *inst) {
-    if (!inst->dev) return;
-    if (!*(inst->dev->PEv2.pin_motion_buffer_mode)) return;
+    if (!inst->dev || !inst->dev->PEv2.pin_motion_buffer_mode) return;
+    if (!*(inst->dev->PEv2.pin_motion_buffer_mode)) {
+        if (inst->mb_active) {
+            PK_MotionStreamReset(inst->dev);
+            inst->mb_active = false;
+        }
+        return;
+    }
     if (!device_cache.communication_ok || device_cache.emergency_stop_active) return;
 
-    int numberOfAxes = inst->dev->PEv2.PulseEngineEnabled & 0x0F;
-    if (numberOfAxes == 0) numberOfAxes = 1;
-
-    /* Maximum slots that fit in the 56-byte buffer payload */
-    int maxEntries = 56 / numberOfAxes;
-
-    int pendingEntries = inst->dev->PEv2.newMotionBufferEntries;
-    if (pendingEntries >= maxEntries) return; /* buffer full, wait for send */
-
-    /* Compute motion entry for each axis */
-    for (int i = 0; i < numberOfAxes; i++) {
-        float pos_cmd   = *(inst->dev->PEv2.pin_joint_pos_cmd[i]);
-        float step_scale = inst->dev->PEv2.stepgen_STEP_SCALE[i];
-        float step_width = inst->dev->PEv2.step_width[i];
-
-        float differenceInPosition = pos_cmd - inst->mb_last_pos[i];
-        uint8_t motion = 0;
-
-        if (fabsf(differenceInPosition) >= step_width) {
-            inst->mb_last_pos[i] = pos_cmd;
+    sPoKeysMotionStream *st = PK_MotionStreamGet(inst->dev);
+    if (!st) return;
 
-            float pulsesDifference = differenceInPosition * step_scale;
-            int32_t pulses = (int32_t)floorf(pulsesDifference);
-
-            inst->mb_pulses_leftover[i] += (pulsesDifference - (float)pulses);
-
-            if (inst->mb_pulses_leftover[i] >= 1.0f) {
-                pulses++;
-                inst->mb_pulses_leftover[i] -= 1.0f;
-            } else if (inst->mb_pulses_leftover[i] <= -1.0f) {
-                pulses--;
-                inst->mb_pulses_leftover[i] += 1.0f;
-            }
-
-            /* Clamp to the 7-bit hardware range */
-            if (pulses > 127)  pulses = 127;
-            if (pulses < -127) pulses = -127;
-
-            motion = (uint8_t)((pulses < 0 ? -pulses : pulses) & 127);
-            if (pulses < 0) {
-                motion |= (1 << 7);
-            }
-        }
+    double pos[8];
+    double scale[8];
+    for (int i = 0; i < 8; i++) {
+        pos[i]   = *(inst->dev->PEv2.pin_joint_pos_cmd[i]);
+        scale[i] = inst->dev->PEv2.stepgen_STEP_SCALE[i];
+    }
+    PK_MotionEncoderConfigure(&st->encoder, inst->dev->PEv2.PulseEngineEnabled & 0x0F, 0, scale);
 
-        inst->dev->PEv2.MotionBuffer[pendingEntries * numberOfAxes + i] = motion;
+    if (!inst->mb_active) {
+        /* Start from the current command instead of replaying it from zero */
+        PK_MotionEncoderReset(&st->encoder, pos);
+        inst->mb_active = true;
     }
 
-    inst->dev->PEv2.newMotionBufferEntries = pendingEntries + 1;
+    uint8_t entries[8] = {0};
+    PK_MotionEncodeBlock(&st->encoder, pos, 1, entries);
+
+    /* A full host ring is counted as overrun by the stream */
+    PK_MotionStreamPush(inst->dev, entries);
 }
 
 /*
- * rt_motion_buffer_send - transmits the accumulated motion buffer to the device.
+ * rt_motion_buffer_send - moves queued slots to the device.
  *
- * Queues PK_PEv2_BufferFillAsync() and immediately calls PK_ReceiveAndDispatch()
- * to collect any pending response (including the one just sent, if the device
- * replies within the same cycle).  The parse callback populates
- * motionBufferEntriesAccepted; unaccepted entries are then shifted to the
- * front of the buffer so they are retransmitted on the next cycle.
+ * PK_MotionStreamService() sends the next fill when the previous one has
+ * been answered and the device has credit; acceptance is handled in the
+ * fill's parse callback, so nothing is read back here in the same cycle.
  */
 static void rt_motion_buffer_send(struct __comp_state *inst) {
     if (!inst->dev) return;
-    if (!*(inst->dev->PEv2.pin_motion_buffer_mode)) return;
+    if (!inst->mb_active) return;
     if (!device_cache.communication_ok || device_cache.emergency_stop_active) return;
 
-    if (inst->dev->PEv2.newMotionBufferEntries == 0) return;
-
-    int numberOfAxes = inst->dev->PEv2.PulseEngineEnabled & 0x0F;
-    if (numberOfAxes == 0) numberOfAxes = 1;
-
-    /* Queue async buffer fill; response callback sets motionBufferEntriesAccepted */
-    PK_PEv2_BufferFillAsync(inst->dev);
-
-    /* Attempt to collect the response within this cycle */
-    PK_ReceiveAndDispatch(inst->dev);
-
-    int accepted = inst->dev->PEv2.motionBufferEntriesAccepted;
-    int total    = inst->dev->PEv2.newMotionBufferEntries;
+    PK_MotionStreamService(inst->dev);
 
     /* Update diagnostic output pin */
-    *(inst->dev->PEv2.pin_motion_buffer_entries_accepted) = accepted;
+    sPoKeysMotionStream *st = PK_MotionStreamGet(inst->dev);
+    if (st) *(inst->dev->PEv2.pin_motion_buffer_entries_accepted) = st->lastAccepted;
 
     /* Also refresh device status cache from the combined status response */
     device_cache.pulse_engine_state = inst->dev->PEv2.PulseEngineState;
@@ -999,16 +1204,6 @@ static void rt_motion_buffer_send(struct __comp_state *inst) {
     device_cache.limit_status_p = inst->dev->PEv2.LimitStatusP;
     device_cache.limit_status_n = inst->dev->PEv2.LimitStatusN;
     device_cache.home_status    = inst->dev->PEv2.HomeStatus;
-
-    /* Shift remaining (unaccepted) entries to the front of the buffer */
-    if (accepted > 0 && accepted < total) {
-        memmove(&inst->dev->PEv2.MotionBuffer[0],
-                &inst->dev->PEv2.MotionBuffer[accepted * numberOfAxes],
-                (size_t)((total - accepted) * numberOfAxes));
-    }
-
-    inst->dev->PEv2.newMotionBufferEntries  = total - accepted;
-    inst->dev->PEv2.motionBufferEntriesAccepted = 0;
 }
 
 FUNCTION(_) {
@@ -1016,6 +1211,10 @@ FUNCTION(_) {
 
     int64_t start_time = rtapi_get_time();
 
+    // Priority lane: e-stop and external output edges go out before anything
+    // else this cycle, through reserved transaction slots.
+    PK_PriorityLaneService(__comp_inst->dev, (uint64_t)start_time / 1000);
+
     // Phase 1: Drain ALL pending responses that arrived since the last cycle.
     rtapi_print_msg(RTAPI_MSG_DBG,
         "PoKeys: FUNCTION(_): Phase1-drain start, dev=%p\n",
@@ -1024,6 +1223,13 @@ FUNCTION(_) {
     PK_TimeoutAndRetryCheck(__comp_inst->dev, 1000);
     rtapi_print_msg(RTAPI_MSG_DBG, "PoKeys: FUNCTION(_): Phase1-drain done\n");
 
+    // Motion buffer mode: queue this cycle's slot and stream it out
+    rt_motion_buffer_fill(__comp_inst);
+    rt_motion_buffer_send(__comp_inst);
+
+    // Engine enable/reset: acknowledged, retried state transitions
+    PK_PEv2_StateMachineService(__comp_inst->dev);
+
     // Phase 2: Dispatch scheduler-managed async sends within the time budget.
     rtapi_print_msg(RTAPI_MSG_DBG, "PoKeys: FUNCTION(_): Phase2-dispatch start\n");
     {
@@ -1039,6 +1245,9 @@ FUNCTION(_) {
             dispatched);
     }
 
+    // Redundant priority copies that came due during Phase 2
+    PK_PriorityLaneService(__comp_inst->dev, (uint64_t)start_time / 1000);
+
     // Phase 3: Drain any additional responses that arrived during Phase 2.
     rtapi_print_msg(RTAPI_MSG_DBG, "PoKeys: FUNCTION(_): Phase3-drain start\n");
     {
@@ -1054,9 +1263,17 @@ FUNCTION(_) {
             drained);
     }
 
+    // Publish everything staged by this cycle's responses to HAL in one step
+    PK_SnapshotPublish(__comp_inst->dev);
+
+    // Extrapolate PEv2 position feedback to this servo cycle, so pos_fb
+    // keeps moving between (and across a lost) 100 Hz status samples.
+    PK_PEv2_FeedbackExtrapolateHAL(__comp_inst->dev);
+
     // Update PoNET HAL output pins from latest received data.
     rtapi_print_msg(RTAPI_MSG_DBG, "PoKeys: FUNCTION(_): update_ponet_hal_pins\n");
     update_ponet_hal_pins(__comp_inst->dev);
+    cmd_queue_publish_hal();
 
     int64_t end_time = rtapi_get_time();
     rtapi_print_msg(RTAPI_MSG_DBG,
@@ -1090,7 +1307,7 @@ static int pk_load_monitor_task(sPoKeysDevice *dev)
     if (!dev) return 0;
     /* Feed the last completed response into the scheduler's load variable */
     if (dev->info.iLoadStatus)
-        scheduler_update_system_load(dev->deviceLoadStatus.CPUload);
+        scheduler_update_system_load(dev, dev->deviceLoadStatus.CPUload);
     /* Request a fresh load-status packet from the device */
     return PK_DeviceLoadStatusAsync(dev);
 }
@@ -1149,7 +1366,7 @@ EXTRA_SETUP() {
 
 // Async processing function (called from RT thread periodically)
 static void process_async_commands(struct __comp_state *inst) {
-    async_command_t cmd;
+    async_command_t *cmd;
     int commands_processed = 0;
     const int MAX_COMMANDS_PER_CYCLE = 3; // Limit to prevent RT overrun
     
@@ -1159,22 +1376,22 @@ static void process_async_commands(struct __comp_state *inst) {
     }
     
     // Process queued commands (limited per cycle)
-    while (commands_processed < MAX_COMMANDS_PER_CYCLE && dequeue_async_command(&cmd)) {
+    while (commands_processed < MAX_COMMANDS_PER_CYCLE && (cmd = cmd_queue_peek()) != NULL) {
         commands_processed++;
         device_cache.total_commands_sent++;
         
         int result = PK_ERR_GENERIC;
         
-        switch (cmd.type) {
+        switch (cmd->type) {
             case CMD_MOVE_PV: {
                 // Update device structure with new position/velocity commands
                 for (int i = 0; i < 8; i++) {
-                    if (cmd.axis_mask & (1 << i)) {
-                        inst->dev->PEv2.ReferencePositionSpeed[i] = (int32_t)cmd.pos_values[i];
-                        inst->dev->PEv2.ReferenceVelocityPV[i] = cmd.vel_values[i];
+                    if (cmd->axis_mask & (1 << i)) {
+                        inst->dev->PEv2.ReferencePositionSpeed[i] = (int32_t)cmd->pos_values[i];
+                        inst->dev->PEv2.ReferenceVelocityPV[i] = cmd->vel_values[i];
                     }
                 }
-                inst->dev->PEv2.param2 = cmd.axis_mask;
+                inst->dev->PEv2.param2 = cmd->axis_mask;
                 
                 // Send MovePV command with error checking
                 result = PK_PEv2_PulseEngineMovePVAsync(inst->dev);
@@ -1186,7 +1403,7 @@ static void process_async_commands(struct __comp_state *inst) {
             }
             
             case CMD_HOME_START: {
-                inst->dev->PEv2.param2 = cmd.axis_mask;
+                inst->dev->PEv2.param2 = cmd->axis_mask;
                 result = PK_PEv2_HomingStartAsync(inst->dev);
                 if (result != PK_OK) {
                     device_cache.failed_commands++;
@@ -1196,8 +1413,8 @@ static void process_async_commands(struct __comp_state *inst) {
             }
             
             case CMD_EXTERNAL_OUTPUT_SET: {
-                inst->dev->PEv2.ExternalRelayOutputs = (cmd.misc_data >> 8) & 0xFF;
-                inst->dev->PEv2.ExternalOCOutputs = cmd.misc_data & 0xFF;
+                inst->dev->PEv2.ExternalRelayOutputs = (cmd->misc_data >> 8) & 0xFF;
+                inst->dev->PEv2.ExternalOCOutputs = cmd->misc_data & 0xFF;
                 result = PK_PEv2_ExternalOutputsSetAsync(inst->dev);
                 if (result != PK_OK) {
                     device_cache.failed_commands++;
@@ -1206,6 +1423,7 @@ static void process_async_commands(struct __comp_state *inst) {
                 break;
             }
         }
+        cmd_queue_release();
         
         // Track communication errors
         if (result != PK_OK) {
@@ -1240,6 +1458,7 @@ static void update_device_cache(struct __comp_state *inst) {
             rtapi_print_msg(RTAPI_MSG_INFO, "PoKeys: Attempting to restore communication\n");
             device_cache.communication_ok = true;
             device_cache.error_count = 0; // Reset error count on reconnect
+            PK_ShadowInvalidate(inst->dev); // Device may have reset its outputs
         }
     }
     
@@ -1316,6 +1535,7 @@ static int start_async_processing(struct __comp_state *inst) {
     device_cache.failed_commands = 0;
     device_cache.device_connected = (inst->dev != NULL);
     device_cache.emergency_stop_active = false;
+    cmd_queue_init();
 
     // Register each subsystem send function with the async scheduler at its
     // natural update rate.  async_dispatcher() will fire each task when it is
@@ -1328,8 +1548,13 @@ static int start_async_processing(struct __comp_state *inst) {
     //   NORMAL   — secondary sensor polling (analog, PWM)
     //   LOW      — PoNET and RTC (non-critical; suppressed when machine is on)
     //
-    // We are registering 14 tasks (13 subsystem + 1 load monitor);
-    // MAX_ASYNC_TASKS must be >= 14.
+    // We are registering 15 tasks (13 subsystem + load monitor + demand
+    // scan) per device; MAX_ASYNC_TASKS must be >= 15 x devices.  The demand scan disables the
+    // input tasks whose pins are not linked; keep the order of the
+    // first 13 in sync with demand_tasks[] (bits of demand.task-mask).
+    // It is NORMAL rather than LOW so re-links are seen while machine is on,
+    // and walks a bounded batch of pins per call, so a full pass takes a
+    // few calls at 10 Hz.
     if (register_async_task(PK_RTCGetAsync,                     inst->dev,   1.0, "rtc",             SCHED_PRIORITY_LOW)      < 0 ||
         register_async_task(PK_EncoderValuesGetAsync,           inst->dev, 500.0, "encoders",         SCHED_PRIORITY_HIGH)     < 0 ||
         register_async_task(PK_DigitalIOGetAsync,               inst->dev, 200.0, "digio_get",        SCHED_PRIORITY_HIGH)     < 0 ||
@@ -1343,7 +1568,8 @@ static int start_async_processing(struct __comp_state *inst) {
         register_async_task(PK_PEv2_StatusUpdateHALAsync,       inst->dev, 100.0, "pev2_status",      SCHED_PRIORITY_CRITICAL) < 0 ||
         register_async_task(PK_PEv2_MovePVFromHALAsync,         inst->dev, 500.0, "pev2_movepv",      SCHED_PRIORITY_CRITICAL) < 0 ||
         register_async_task(PK_PEv2_ExternalOutputsFromHALAsync,inst->dev, 100.0, "pev2_extout",      SCHED_PRIORITY_HIGH)     < 0 ||
-        register_async_task(pk_load_monitor_task,               inst->dev,   5.0, "load_monitor",     SCHED_PRIORITY_LOW)      < 0) {
+        register_async_task(pk_load_monitor_task,               inst->dev,   5.0, "load_monitor",     SCHED_PRIORITY_LOW)      < 0 ||
+        register_async_task(PK_DemandScanAsync,                 inst->dev,  10.0, "demand_scan",      SCHED_PRIORITY_NORMAL)   < 0) {
         rtapi_print_msg(RTAPI_MSG_ERR,
             "PoKeys: register_async_task failed (MAX_ASYNC_TASKS=%d too small?)\n",
             MAX_ASYNC_TASKS);